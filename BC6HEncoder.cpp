@@ -0,0 +1,596 @@
+#include "BC6HEncoder.h"
+#include "LightmapFormat.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// 头部字段: 端点w, x, y, z各三个通道, 最后是分区索引
+// w, x为区域0的两个端点, y, z为区域1的两个端点, 变换模式下x, y, z存储相对w的差值
+enum BC6HField {
+    FIELD_D = 12,
+    FIELD_COUNT,
+};
+
+struct BC6HFieldBit {
+    uint8_t field;
+    uint8_t bit;
+};
+
+struct BC6HMode {
+    uint32_t mode;
+    uint32_t mode_bits;
+    uint32_t regions;
+    bool transformed;
+    int endpoint_bits;
+    int delta_bits[3];
+    // 与D3D文档相同的写法, x[a:b]在码流中从第b位依次写到第a位
+    const char* layout;
+    std::vector<BC6HFieldBit> bits;
+};
+
+static BC6HMode BC6H_MODES[] = {
+    {0x00, 2, 2, true, 10, {5, 5, 5}, "gy[4], by[4], bz[4], rw[9:0], gw[9:0], bw[9:0], rx[4:0], gz[4], gy[3:0], gx[4:0], bz[0], gz[3:0], bx[4:0], bz[1], by[3:0], ry[4:0], bz[2], rz[4:0], bz[3], d[4:0]", {}},
+    {0x01, 2, 2, true, 7, {6, 6, 6}, "gy[5], gz[4], gz[5], rw[6:0], bz[0], bz[1], by[4], gw[6:0], by[5], bz[2], gy[4], bw[6:0], bz[3], bz[5], bz[4], rx[5:0], gy[3:0], gx[5:0], gz[3:0], bx[5:0], by[3:0], ry[5:0], rz[5:0], d[4:0]", {}},
+    {0x02, 5, 2, true, 11, {5, 4, 4}, "rw[9:0], gw[9:0], bw[9:0], rx[4:0], rw[10], gy[3:0], gx[3:0], gw[10], bz[0], gz[3:0], bx[3:0], bw[10], bz[1], by[3:0], ry[4:0], bz[2], rz[4:0], bz[3], d[4:0]", {}},
+    {0x06, 5, 2, true, 11, {4, 5, 4}, "rw[9:0], gw[9:0], bw[9:0], rx[3:0], rw[10], gz[4], gy[3:0], gx[4:0], gw[10], gz[3:0], bx[3:0], bw[10], bz[1], by[3:0], ry[3:0], bz[0], bz[2], rz[3:0], gy[4], bz[3], d[4:0]", {}},
+    {0x0a, 5, 2, true, 11, {4, 4, 5}, "rw[9:0], gw[9:0], bw[9:0], rx[3:0], rw[10], by[4], gy[3:0], gx[3:0], gw[10], bz[0], gz[3:0], bx[4:0], bw[10], by[3:0], ry[3:0], bz[1], bz[2], rz[3:0], bz[4], bz[3], d[4:0]", {}},
+    {0x0e, 5, 2, true, 9, {5, 5, 5}, "rw[8:0], by[4], gw[8:0], gy[4], bw[8:0], bz[4], rx[4:0], gz[4], gy[3:0], gx[4:0], bz[0], gz[3:0], bx[4:0], bz[1], by[3:0], ry[4:0], bz[2], rz[4:0], bz[3], d[4:0]", {}},
+    {0x12, 5, 2, true, 8, {6, 5, 5}, "rw[7:0], gz[4], by[4], gw[7:0], bz[2], gy[4], bw[7:0], bz[3], bz[4], rx[5:0], gy[3:0], gx[4:0], bz[0], gz[3:0], bx[4:0], bz[1], by[3:0], ry[5:0], rz[5:0], d[4:0]", {}},
+    {0x16, 5, 2, true, 8, {5, 6, 5}, "rw[7:0], bz[0], by[4], gw[7:0], gy[5], gy[4], bw[7:0], gz[5], bz[4], rx[4:0], gz[4], gy[3:0], gx[5:0], gz[3:0], bx[4:0], bz[1], by[3:0], ry[4:0], bz[2], rz[4:0], bz[3], d[4:0]", {}},
+    {0x1a, 5, 2, true, 8, {5, 5, 6}, "rw[7:0], bz[1], by[4], gw[7:0], by[5], gy[4], bw[7:0], bz[5], bz[4], rx[4:0], gz[4], gy[3:0], gx[4:0], bz[0], gz[3:0], bx[5:0], by[3:0], ry[4:0], bz[2], rz[4:0], bz[3], d[4:0]", {}},
+    {0x1e, 5, 2, false, 6, {6, 6, 6}, "rw[5:0], gz[4], bz[0], bz[1], by[4], gw[5:0], gy[5], by[5], bz[2], gy[4], bw[5:0], gz[5], bz[3], bz[5], bz[4], rx[5:0], gy[3:0], gx[5:0], gz[3:0], bx[5:0], by[3:0], ry[5:0], rz[5:0], d[4:0]", {}},
+    {0x03, 5, 1, false, 10, {10, 10, 10}, "rw[9:0], gw[9:0], bw[9:0], rx[9:0], gx[9:0], bx[9:0]", {}},
+    {0x07, 5, 1, true, 11, {9, 9, 9}, "rw[9:0], gw[9:0], bw[9:0], rx[8:0], rw[10], gx[8:0], gw[10], bx[8:0], bw[10]", {}},
+    {0x0b, 5, 1, true, 12, {8, 8, 8}, "rw[9:0], gw[9:0], bw[9:0], rx[7:0], rw[10:11], gx[7:0], gw[10:11], bx[7:0], bw[10:11]", {}},
+    {0x0f, 5, 1, true, 16, {4, 4, 4}, "rw[9:0], gw[9:0], bw[9:0], rx[3:0], rw[10:15], gx[3:0], gw[10:15], bx[3:0], bw[10:15]", {}},
+};
+
+static const uint32_t BC6H_MODE_COUNT = sizeof(BC6H_MODES) / sizeof(BC6H_MODES[0]);
+static const uint32_t BC6H_FIRST_ONE_REGION_MODE = 10;
+
+// 与BC7双区域的前32种分区相同, 第i位为1表示第i个像素属于区域1
+static const uint16_t BC6H_PARTITIONS[32] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+};
+
+// 区域1的锚点像素, 其索引省略最高位
+static const uint8_t BC6H_ANCHORS[32] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+};
+
+static const int BC6H_WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const int BC6H_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static void ParseModeLayouts() {
+    static const char* FIELD_NAMES[FIELD_COUNT] = {"rw", "gw", "bw", "rx", "gx", "bx", "ry", "gy", "by", "rz", "gz", "bz", "d"};
+    for (uint32_t m = 0; m < BC6H_MODE_COUNT; ++m) {
+        BC6HMode& mode = BC6H_MODES[m];
+        const char* p = mode.layout;
+        while (*p) {
+            while (*p == ',' || *p == ' ') {
+                p++;
+            }
+            uint32_t field = 0;
+            while (field < FIELD_COUNT && strncmp(p, FIELD_NAMES[field], strlen(FIELD_NAMES[field])) != 0) {
+                field++;
+            }
+            p += strlen(FIELD_NAMES[field]) + 1;
+            int a = (int)strtol(p, (char**)&p, 10);
+            int b = a;
+            if (*p == ':') {
+                b = (int)strtol(p + 1, (char**)&p, 10);
+            }
+            p++;
+            int step = a >= b ? 1 : -1;
+            for (int bit = b;; bit += step) {
+                mode.bits.push_back({(uint8_t)field, (uint8_t)bit});
+                if (bit == a) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void InitModes() {
+    static bool initialized = [] { ParseModeLayouts(); return true; }();
+    (void)initialized;
+}
+
+static int UnquantizeEndpoint(int value, int bits, bool is_signed) {
+    if (is_signed) {
+        // 有符号格式按绝对值反量化到15位
+        int magnitude = std::abs(value);
+        int result;
+        if (bits >= 16 || magnitude == 0) {
+            result = magnitude;
+        } else if (magnitude >= (1 << (bits - 1)) - 1) {
+            result = 0x7fff;
+        } else {
+            result = ((magnitude << 15) + 0x4000) >> (bits - 1);
+        }
+        return value < 0 ? -result : result;
+    }
+    if (bits >= 15) {
+        return value;
+    }
+    if (value == 0) {
+        return 0;
+    }
+    if (value == (1 << bits) - 1) {
+        return 0xffff;
+    }
+    return ((value << 16) + 0x8000) >> bits;
+}
+
+static int QuantizeEndpoint(float value, int bits, bool is_signed) {
+    if (is_signed) {
+        int max_value = (1 << (bits - 1)) - 1;
+        float magnitude = std::fabs(value);
+        int q = bits >= 16 ? int(magnitude + 0.5f) : int(magnitude * float(1 << (bits - 1)) / 32768.0f);
+        q = std::min(q, max_value);
+        return value < 0.0f ? -q : q;
+    }
+    int max_value = (1 << bits) - 1;
+    int q = bits >= 15 ? int(value + 0.5f) : int(value * float(1 << bits) / 65536.0f);
+    return glm::clamp(q, 0, max_value);
+}
+
+static int SignExtend(int value, int bits) {
+    return (value & (1 << (bits - 1))) ? value - (1 << bits) : value;
+}
+
+// 由量化后的端点计算调色板中每一项解码出的half值, 按通道分开存放便于编译器向量化
+// 有符号格式的half值以带符号的整数表示, 即去掉符号位后的绝对值乘以符号
+static void BuildPalette(const int* endpoint0, const int* endpoint1, int bits, uint32_t index_count, bool is_signed, int palette[3][16]) {
+    const int* weights = index_count == 8 ? BC6H_WEIGHTS3 : BC6H_WEIGHTS4;
+    for (int c = 0; c < 3; ++c) {
+        int e0 = UnquantizeEndpoint(endpoint0[c], bits, is_signed);
+        int e1 = UnquantizeEndpoint(endpoint1[c], bits, is_signed);
+        for (uint32_t i = 0; i < index_count; ++i) {
+            int value = (e0 * (64 - weights[i]) + e1 * weights[i] + 32) >> 6;
+            if (is_signed) {
+                palette[c][i] = value < 0 ? -((-value * 31) >> 5) : (value * 31) >> 5;
+            } else {
+                palette[c][i] = (value * 31) >> 6;
+            }
+        }
+    }
+}
+
+struct BitStream {
+    uint8_t* data;
+    uint32_t position = 0;
+
+    void Write(uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i, ++position) {
+            data[position >> 3] |= ((value >> i) & 1) << (position & 7);
+        }
+    }
+
+    uint32_t Read(uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; ++i, ++position) {
+            value |= ((data[position >> 3] >> (position & 7)) & 1u) << i;
+        }
+        return value;
+    }
+};
+
+static bool IsAnchor(uint32_t regions, uint32_t partition, uint32_t pixel) {
+    return pixel == 0 || (regions == 2 && pixel == BC6H_ANCHORS[partition]);
+}
+
+static uint32_t GetRegion(uint32_t regions, uint32_t partition, uint32_t pixel) {
+    return regions == 2 ? (BC6H_PARTITIONS[partition] >> pixel) & 1 : 0;
+}
+
+static void DecodeBlock(const uint8_t* block, bool is_signed, uint16_t output[16][3]) {
+    BitStream stream = {(uint8_t*)block};
+    uint32_t mode_value = stream.Read(2);
+    if (mode_value >= 2) {
+        mode_value |= stream.Read(3) << 2;
+    }
+
+    const BC6HMode* mode = nullptr;
+    for (uint32_t m = 0; m < BC6H_MODE_COUNT; ++m) {
+        if (BC6H_MODES[m].mode == mode_value) {
+            mode = &BC6H_MODES[m];
+        }
+    }
+    // 保留的模式解码为0
+    if (!mode) {
+        memset(output, 0, sizeof(uint16_t) * 16 * 3);
+        return;
+    }
+
+    int fields[FIELD_COUNT] = {};
+    for (const BC6HFieldBit& field_bit : mode->bits) {
+        fields[field_bit.field] |= stream.Read(1) << field_bit.bit;
+    }
+
+    int endpoints[4][3];
+    uint32_t endpoint_count = mode->regions * 2;
+    int mask = (1 << mode->endpoint_bits) - 1;
+    for (uint32_t k = 0; k < endpoint_count; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            endpoints[k][c] = fields[k * 3 + c];
+            if (mode->transformed && k > 0) {
+                endpoints[k][c] = (endpoints[0][c] + SignExtend(endpoints[k][c], mode->delta_bits[c])) & mask;
+            }
+        }
+    }
+    // 有符号格式的端点是endpoint_bits位的补码, 与差值求和之后再扩展符号
+    if (is_signed) {
+        for (uint32_t k = 0; k < endpoint_count; ++k) {
+            for (int c = 0; c < 3; ++c) {
+                endpoints[k][c] = SignExtend(endpoints[k][c], mode->endpoint_bits);
+            }
+        }
+    }
+
+    uint32_t partition = fields[FIELD_D];
+    uint32_t index_bits = mode->regions == 2 ? 3 : 4;
+    int palettes[2][3][16];
+    for (uint32_t r = 0; r < mode->regions; ++r) {
+        BuildPalette(endpoints[r * 2], endpoints[r * 2 + 1], mode->endpoint_bits, 1u << index_bits, is_signed, palettes[r]);
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t index = stream.Read(IsAnchor(mode->regions, partition, i) ? index_bits - 1 : index_bits);
+        const int (*palette)[16] = palettes[GetRegion(mode->regions, partition, i)];
+        for (int c = 0; c < 3; ++c) {
+            int value = palette[c][index];
+            output[i][c] = value < 0 ? uint16_t(0x8000 | -value) : (uint16_t)value;
+        }
+    }
+}
+
+// 一个块的编码结果, 端点为量化后的绝对值
+struct BC6HEncoding {
+    const BC6HMode* mode = nullptr;
+    uint32_t partition = 0;
+    int endpoints[4][3] = {};
+    uint8_t indices[16] = {};
+    int64_t error = INT64_MAX;
+};
+
+static void PackBlock(const BC6HEncoding& encoding, uint8_t* block) {
+    const BC6HMode* mode = encoding.mode;
+    memset(block, 0, BC6H_BLOCK_SIZE);
+    int fields[FIELD_COUNT] = {};
+    for (uint32_t k = 0; k < mode->regions * 2; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            int value = encoding.endpoints[k][c];
+            if (mode->transformed && k > 0) {
+                value = (value - encoding.endpoints[0][c]) & ((1 << mode->delta_bits[c]) - 1);
+            }
+            fields[k * 3 + c] = value;
+        }
+    }
+    fields[FIELD_D] = encoding.partition;
+
+    BitStream stream = {block};
+    stream.Write(mode->mode, mode->mode_bits);
+    for (const BC6HFieldBit& field_bit : mode->bits) {
+        stream.Write(fields[field_bit.field] >> field_bit.bit, 1);
+    }
+    uint32_t index_bits = mode->regions == 2 ? 3 : 4;
+    for (uint32_t i = 0; i < 16; ++i) {
+        stream.Write(encoding.indices[i], IsAnchor(mode->regions, encoding.partition, i) ? index_bits - 1 : index_bits);
+    }
+}
+
+// 编码用的块数据, half为目标half值, value为解码插值时使用的16位线性域中的值
+// 有符号格式的half和value都带符号, value的范围是[-32767, 32767]
+struct BC6HBlock {
+    int half[16][3];
+    float value[16][3];
+    bool is_signed;
+};
+
+static float GetMinEndpointValue(const BC6HBlock& block) {
+    return block.is_signed ? -32767.0f : 0.0f;
+}
+
+static float GetMaxEndpointValue(const BC6HBlock& block) {
+    return block.is_signed ? 32767.0f : 65535.0f;
+}
+
+// 区域内的像素用主轴拟合出两个端点, 返回垂直于主轴的残差平方和
+static float FitEndpoints(const BC6HBlock& block, uint16_t pixel_mask, glm::vec3& endpoint0, glm::vec3& endpoint1) {
+    glm::vec3 mean(0.0f);
+    float count = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i) {
+        if (pixel_mask & (1 << i)) {
+            mean += glm::vec3(block.value[i][0], block.value[i][1], block.value[i][2]);
+            count += 1.0f;
+        }
+    }
+    mean /= std::max(count, 1.0f);
+
+    float cov[6] = {};
+    glm::vec3 min_value(FLT_MAX), max_value(-FLT_MAX);
+    for (uint32_t i = 0; i < 16; ++i) {
+        if (pixel_mask & (1 << i)) {
+            glm::vec3 v = glm::vec3(block.value[i][0], block.value[i][1], block.value[i][2]);
+            glm::vec3 d = v - mean;
+            cov[0] += d.x * d.x;
+            cov[1] += d.x * d.y;
+            cov[2] += d.x * d.z;
+            cov[3] += d.y * d.y;
+            cov[4] += d.y * d.z;
+            cov[5] += d.z * d.z;
+            min_value = glm::min(min_value, v);
+            max_value = glm::max(max_value, v);
+        }
+    }
+
+    // 幂迭代求协方差矩阵的主特征向量
+    glm::vec3 axis = max_value - min_value;
+    if (glm::dot(axis, axis) < 1e-6f) {
+        endpoint0 = endpoint1 = mean;
+        return 0.0f;
+    }
+    for (int iter = 0; iter < 4; ++iter) {
+        glm::vec3 next(cov[0] * axis.x + cov[1] * axis.y + cov[2] * axis.z,
+                       cov[1] * axis.x + cov[3] * axis.y + cov[4] * axis.z,
+                       cov[2] * axis.x + cov[4] * axis.y + cov[5] * axis.z);
+        float length = glm::length(next);
+        if (length < 1e-12f) {
+            break;
+        }
+        axis = next / length;
+    }
+    axis = glm::normalize(axis);
+
+    float t_min = FLT_MAX, t_max = -FLT_MAX, residual = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i) {
+        if (pixel_mask & (1 << i)) {
+            glm::vec3 d = glm::vec3(block.value[i][0], block.value[i][1], block.value[i][2]) - mean;
+            float t = glm::dot(d, axis);
+            t_min = std::min(t_min, t);
+            t_max = std::max(t_max, t);
+            residual += glm::dot(d, d) - t * t;
+        }
+    }
+    endpoint0 = glm::clamp(mean + axis * t_min, GetMinEndpointValue(block), GetMaxEndpointValue(block));
+    endpoint1 = glm::clamp(mean + axis * t_max, GetMinEndpointValue(block), GetMaxEndpointValue(block));
+    return residual;
+}
+
+// 使锚点像素更靠近端点0, 这样锚点索引省略的最高位总是0
+static void OrientEndpoints(const BC6HBlock& block, uint32_t anchor, glm::vec3& endpoint0, glm::vec3& endpoint1) {
+    glm::vec3 axis = endpoint1 - endpoint0;
+    glm::vec3 v = glm::vec3(block.value[anchor][0], block.value[anchor][1], block.value[anchor][2]);
+    if (glm::dot(v - endpoint0, axis) > 0.5f * glm::dot(axis, axis)) {
+        std::swap(endpoint0, endpoint1);
+    }
+}
+
+// 量化端点并为每个像素选择最近的索引, 返回half值的误差平方和
+static int64_t EvaluateEncoding(const BC6HBlock& block, const BC6HMode* mode, uint32_t partition, glm::vec3 endpoints[4], BC6HEncoding& encoding) {
+    uint32_t endpoint_count = mode->regions * 2;
+    for (uint32_t r = 0; r < mode->regions; ++r) {
+        OrientEndpoints(block, r == 0 ? 0 : BC6H_ANCHORS[partition], endpoints[r * 2], endpoints[r * 2 + 1]);
+    }
+
+    encoding.mode = mode;
+    encoding.partition = partition;
+    for (uint32_t k = 0; k < endpoint_count; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            int q = QuantizeEndpoint(endpoints[k][c], mode->endpoint_bits, block.is_signed);
+            // 变换模式下差值超出范围时把端点拉向w
+            if (mode->transformed && k > 0) {
+                int limit = 1 << (mode->delta_bits[c] - 1);
+                q = glm::clamp(q, encoding.endpoints[0][c] - limit, encoding.endpoints[0][c] + limit - 1);
+            }
+            encoding.endpoints[k][c] = q;
+        }
+    }
+
+    uint32_t index_count = mode->regions == 2 ? 8 : 16;
+    int palettes[2][3][16];
+    for (uint32_t r = 0; r < mode->regions; ++r) {
+        BuildPalette(encoding.endpoints[r * 2], encoding.endpoints[r * 2 + 1], mode->endpoint_bits, index_count, block.is_signed, palettes[r]);
+    }
+
+    int64_t total_error = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        const int (*palette)[16] = palettes[GetRegion(mode->regions, partition, i)];
+        // 固定按16项计算, 调色板只有8项或锚点只能使用前一半索引时把多余项的误差设为最大
+        uint32_t search_count = IsAnchor(mode->regions, partition, i) ? index_count / 2 : index_count;
+        // 有符号时每个分量的差值可达2*31743, 平方和超出int范围, 用float计算, 与int同样可以8路向量化
+        float errors[16];
+        for (uint32_t j = 0; j < 16; ++j) {
+            float dr = float(palette[0][j] - block.half[i][0]);
+            float dg = float(palette[1][j] - block.half[i][1]);
+            float db = float(palette[2][j] - block.half[i][2]);
+            errors[j] = j < search_count ? dr * dr + dg * dg + db * db : FLT_MAX;
+        }
+        uint32_t best = 0;
+        for (uint32_t j = 1; j < 16; ++j) {
+            best = errors[j] < errors[best] ? j : best;
+        }
+        encoding.indices[i] = (uint8_t)best;
+        total_error += int64_t(errors[best]);
+    }
+    encoding.error = total_error;
+    return total_error;
+}
+
+// 固定索引后用最小二乘重新求解每个区域的端点
+static void RefineEndpoints(const BC6HBlock& block, const BC6HEncoding& encoding, glm::vec3 endpoints[4]) {
+    const BC6HMode* mode = encoding.mode;
+    const int* weights = mode->regions == 2 ? BC6H_WEIGHTS3 : BC6H_WEIGHTS4;
+    for (uint32_t r = 0; r < mode->regions; ++r) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        glm::vec3 ax(0.0f), bx(0.0f);
+        for (uint32_t i = 0; i < 16; ++i) {
+            if (GetRegion(mode->regions, encoding.partition, i) != r) {
+                continue;
+            }
+            float t = float(weights[encoding.indices[i]]) / 64.0f;
+            glm::vec3 v = glm::vec3(block.value[i][0], block.value[i][1], block.value[i][2]);
+            aa += (1.0f - t) * (1.0f - t);
+            ab += (1.0f - t) * t;
+            bb += t * t;
+            ax += (1.0f - t) * v;
+            bx += t * v;
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f) {
+            continue;
+        }
+        endpoints[r * 2] = glm::clamp((ax * bb - bx * ab) / det, GetMinEndpointValue(block), GetMaxEndpointValue(block));
+        endpoints[r * 2 + 1] = glm::clamp((bx * aa - ax * ab) / det, GetMinEndpointValue(block), GetMaxEndpointValue(block));
+    }
+}
+
+// 变换模式下端点相对w的差值远超出可表示范围时, 截断后的误差必然很大, 跳过该模式
+static bool DeltasFit(const BC6HMode* mode, const glm::vec3 endpoints[4]) {
+    if (!mode->transformed) {
+        return true;
+    }
+    float scale = float(1 << mode->endpoint_bits) / 65536.0f;
+    for (uint32_t k = 1; k < mode->regions * 2; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            float delta = std::fabs(endpoints[k][c] - endpoints[0][c]) * scale;
+            if (delta > float(2 << mode->delta_bits[c])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void TryMode(const BC6HBlock& block, const BC6HMode* mode, uint32_t partition, const glm::vec3 fitted[4], uint32_t refine_iterations, BC6HEncoding& best) {
+    if (best.mode && !DeltasFit(mode, fitted)) {
+        return;
+    }
+    glm::vec3 endpoints[4] = {fitted[0], fitted[1], fitted[2], fitted[3]};
+    BC6HEncoding encoding;
+    EvaluateEncoding(block, mode, partition, endpoints, encoding);
+    if (encoding.error < best.error) {
+        best = encoding;
+    }
+    for (uint32_t iter = 0; iter < refine_iterations && encoding.error > 0; ++iter) {
+        RefineEndpoints(block, encoding, endpoints);
+        int64_t previous_error = encoding.error;
+        EvaluateEncoding(block, mode, partition, endpoints, encoding);
+        if (encoding.error < best.error) {
+            best = encoding;
+        }
+        if (encoding.error >= previous_error) {
+            break;
+        }
+    }
+}
+
+static void EncodeBlock(const BC6HBlock& block, BC6HQuality quality, uint8_t* output) {
+    uint32_t refine_iterations = quality == BC6H_QUALITY_HIGH ? 2 : (quality == BC6H_QUALITY_NORMAL ? 1 : 0);
+    BC6HEncoding best;
+
+    glm::vec3 fitted[4];
+    FitEndpoints(block, 0xffff, fitted[0], fitted[1]);
+    for (uint32_t m = BC6H_FIRST_ONE_REGION_MODE; m < BC6H_MODE_COUNT; ++m) {
+        TryMode(block, &BC6H_MODES[m], 0, fitted, refine_iterations, best);
+    }
+
+    // 单区域的误差已经在每个分量1个half单位以内时不再尝试双区域
+    if (quality != BC6H_QUALITY_FAST && best.error > 48) {
+        uint32_t partition_count = quality == BC6H_QUALITY_HIGH ? 8 : 2;
+        std::pair<float, uint32_t> scores[32];
+        glm::vec3 partition_endpoints[32][4];
+        for (uint32_t p = 0; p < 32; ++p) {
+            uint16_t mask = BC6H_PARTITIONS[p];
+            float residual = FitEndpoints(block, (uint16_t)~mask, partition_endpoints[p][0], partition_endpoints[p][1]);
+            residual += FitEndpoints(block, mask, partition_endpoints[p][2], partition_endpoints[p][3]);
+            scores[p] = std::make_pair(residual, p);
+        }
+        std::partial_sort(scores, scores + partition_count, scores + 32);
+
+        for (uint32_t k = 0; k < partition_count; ++k) {
+            uint32_t p = scores[k].second;
+            for (uint32_t m = 0; m < BC6H_FIRST_ONE_REGION_MODE; ++m) {
+                TryMode(block, &BC6H_MODES[m], p, partition_endpoints[p], refine_iterations, best);
+            }
+        }
+    }
+
+    PackBlock(best, output);
+}
+
+bool ParseBC6HQuality(const std::string& name, BC6HQuality& quality) {
+    if (name == "fast") {
+        quality = BC6H_QUALITY_FAST;
+    } else if (name == "normal") {
+        quality = BC6H_QUALITY_NORMAL;
+    } else if (name == "high") {
+        quality = BC6H_QUALITY_HIGH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void EncodeBC6H(const glm::vec4* texels, uint32_t width, uint32_t height, BC6HQuality quality, bool is_signed, std::vector<uint8_t>& blocks) {
+    InitModes();
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t block_count = GetBC6HBlockCount(width, height);
+    blocks.assign(size_t(block_count) * BC6H_BLOCK_SIZE, 0);
+    ParallelFor(block_count, 64, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t b = begin; b < end; ++b) {
+            uint32_t bx = (b % blocks_x) * 4;
+            uint32_t by = (b / blocks_x) * 4;
+            BC6HBlock block;
+            block.is_signed = is_signed;
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = std::min(bx + (i & 3), width - 1);
+                uint32_t y = std::min(by + (i >> 2), height - 1);
+                const glm::vec4& texel = texels[y * width + x];
+                for (int c = 0; c < 3; ++c) {
+                    if (is_signed) {
+                        // NaN截断为0, 绝对值截断到65504
+                        float magnitude = std::fabs(texel[c]);
+                        int half = magnitude > 0.0f ? FloatToHalf(std::min(magnitude, 65504.0f)) : 0;
+                        block.half[i][c] = texel[c] < 0.0f ? -half : half;
+                        block.value[i][c] = float(block.half[i][c]) * 32.0f / 31.0f;
+                    } else {
+                        // 负数和NaN截断为0
+                        block.half[i][c] = texel[c] > 0.0f ? FloatToHalf(std::min(texel[c], 65504.0f)) : 0;
+                        block.value[i][c] = float(block.half[i][c]) * 64.0f / 31.0f;
+                    }
+                }
+            }
+            EncodeBlock(block, quality, blocks.data() + size_t(b) * BC6H_BLOCK_SIZE);
+        }
+    });
+}
+
+void DecodeBC6H(const uint8_t* blocks, uint32_t width, uint32_t height, bool is_signed, std::vector<glm::vec4>& texels) {
+    InitModes();
+    uint32_t blocks_x = (width + 3) / 4;
+    texels.resize(size_t(width) * height);
+    ParallelFor(GetBC6HBlockCount(width, height), 256, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t b = begin; b < end; ++b) {
+            uint16_t decoded[16][3];
+            DecodeBlock(blocks + size_t(b) * BC6H_BLOCK_SIZE, is_signed, decoded);
+            uint32_t bx = (b % blocks_x) * 4;
+            uint32_t by = (b / blocks_x) * 4;
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = bx + (i & 3);
+                uint32_t y = by + (i >> 2);
+                if (x < width && y < height) {
+                    texels[y * width + x] = glm::vec4(HalfToFloat(decoded[i][0]), HalfToFloat(decoded[i][1]), HalfToFloat(decoded[i][2]), 1.0f);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// BC6H_UF16和BC6H_SF16压缩, 每个4x4块16字节, UF16的负数截断为0, 超出half范围的值截断到±65504
+enum BC6HQuality {
+    // 只尝试单区域的4种模式
+    BC6H_QUALITY_FAST,
+    // 再按主轴残差挑出最好的2种分区尝试双区域模式, 端点做一次最小二乘优化
+    BC6H_QUALITY_NORMAL,
+    // 尝试8种分区, 端点做两次最小二乘优化
+    BC6H_QUALITY_HIGH,
+};
+
+const uint32_t BC6H_BLOCK_SIZE = 16;
+
+// 按名称解析质量档位: fast, normal, high
+bool ParseBC6HQuality(const std::string& name, BC6HQuality& quality);
+
+inline uint32_t GetBC6HBlockCount(uint32_t width, uint32_t height) {
+    return ((width + 3) / 4) * ((height + 3) / 4);
+}
+
+// 多线程按块编码, 宽高不是4的倍数时边缘块重复最后一行/列的纹素
+// is_signed为true时编码为BC6H_SF16, 用于有负数的数据, 精度比UF16少1位
+void EncodeBC6H(const glm::vec4* texels, uint32_t width, uint32_t height, BC6HQuality quality, bool is_signed, std::vector<uint8_t>& blocks);
+
+void DecodeBC6H(const uint8_t* blocks, uint32_t width, uint32_t height, bool is_signed, std::vector<glm::vec4>& texels);
@@ -0,0 +1,229 @@
+#include "BakeCache.h"
+#include "Builder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+static const uint32_t BAKE_CACHE_MAGIC = 0x4B41424C;
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t GetTexelMesh(const AccelerationStructures* as, const glm::vec4& normal) {
+    uint32_t triangle = uint32_t(normal.w);
+    return uint32_t(std::upper_bound(as->mesh_triangle_offsets.begin(), as->mesh_triangle_offsets.end(), triangle) - as->mesh_triangle_offsets.begin()) - 1;
+}
+
+static bool IsTexelValid(const glm::vec4& normal) {
+    return glm::length(glm::vec3(normal)) >= 0.5f;
+}
+
+void CaptureBakeScene(const AccelerationStructures* as, const std::vector<Light>& lights, const std::vector<glm::vec4>& normal_data, BakeCache& cache) {
+    uint32_t mesh_count = as->mesh_triangle_offsets.size() - 1;
+    cache.mesh_hashes.assign(mesh_count, 14695981039346656037ull);
+    cache.mesh_bounds.assign(mesh_count, AABB());
+    cache.mesh_emissive.assign(mesh_count, 0);
+    for (uint32_t m = 0; m < mesh_count; ++m) {
+        uint64_t& hash = cache.mesh_hashes[m];
+        AABB& bounds = cache.mesh_bounds[m];
+        for (uint32_t t = as->mesh_triangle_offsets[m]; t < as->mesh_triangle_offsets[m + 1]; ++t) {
+            const Triangle& triangle = as->triangles[t];
+            for (uint32_t j = 0; j < 3; ++j) {
+                // position和normal的w分量没有初始化, 只计入有效分量
+                const Vertex& vertex = as->vertices[triangle.indices[j]];
+                glm::vec3 position = vertex.position;
+                glm::vec3 normal = vertex.normal;
+                hash = HashBytes(&position, sizeof(glm::vec3), hash);
+                hash = HashBytes(&normal, sizeof(glm::vec3), hash);
+                hash = HashBytes(&vertex.uv0, sizeof(glm::vec2), hash);
+                hash = HashBytes(&vertex.uv1, sizeof(glm::vec2), hash);
+                bounds.Expand(position);
+            }
+            const TriangleMaterial& material = as->triangle_materials[t];
+            hash = HashBytes(&material, sizeof(TriangleMaterial), hash);
+            if (glm::vec3(material.emissive) != glm::vec3(0.0f)) {
+                cache.mesh_emissive[m] = 1;
+            }
+        }
+    }
+
+    // 反照率贴图变化时几何不变, 按纹素所属的模型把覆盖纹素的反照率计入hash
+    for (uint32_t i = 0; i < normal_data.size(); ++i) {
+        if (!IsTexelValid(normal_data[i])) {
+            continue;
+        }
+        uint64_t& hash = cache.mesh_hashes[GetTexelMesh(as, normal_data[i])];
+        hash = HashBytes(&as->albedo_atlas[i], sizeof(glm::vec4), hash);
+    }
+
+    cache.lights = lights;
+}
+
+bool LoadBakeCache(const std::string& file_path, BakeCache& cache) {
+    FILE* file = fopen(file_path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    uint32_t header[5] = {};
+    bool valid = fread(header, sizeof(header), 1, file) == 1 && header[0] == BAKE_CACHE_MAGIC && header[1] == BAKE_CACHE_VERSION;
+    if (valid) {
+        cache.width = header[2];
+        cache.height = header[3];
+        cache.bounce_light.resize(header[4]);
+        valid = fread(&cache.settings_hash, sizeof(cache.settings_hash), 1, file) == 1 &&
+                ReadVector(file, cache.mesh_hashes) && ReadVector(file, cache.mesh_bounds) &&
+                ReadVector(file, cache.mesh_emissive) && ReadVector(file, cache.lights) &&
+                ReadVector(file, cache.direct_light);
+        for (uint32_t i = 0; valid && i < cache.bounce_light.size(); ++i) {
+            valid = ReadVector(file, cache.bounce_light[i]);
+        }
+        valid = valid && ReadVector(file, cache.sh_light_map) && ReadVector(file, cache.light_variance);
+        // 模型的数组按序号对应, 长度不一致的缓存无法比较
+        valid = valid && cache.mesh_bounds.size() == cache.mesh_hashes.size() && cache.mesh_emissive.size() == cache.mesh_hashes.size();
+    }
+    fclose(file);
+
+    if (!valid) {
+        printf("ignore invalid bake cache %s\n", file_path.c_str());
+    }
+    return valid;
+}
+
+bool SaveBakeCache(const std::string& file_path, const BakeCache& cache) {
+    FILE* file = fopen(file_path.c_str(), "wb");
+    if (file == nullptr) {
+        printf("cannot write bake cache %s\n", file_path.c_str());
+        return false;
+    }
+
+    uint32_t header[5] = {BAKE_CACHE_MAGIC, BAKE_CACHE_VERSION, cache.width, cache.height, (uint32_t)cache.bounce_light.size()};
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(&cache.settings_hash, sizeof(cache.settings_hash), 1, file);
+    WriteVector(file, cache.mesh_hashes);
+    WriteVector(file, cache.mesh_bounds);
+    WriteVector(file, cache.mesh_emissive);
+    WriteVector(file, cache.lights);
+    WriteVector(file, cache.direct_light);
+    for (const std::vector<glm::vec4>& bounce : cache.bounce_light) {
+        WriteVector(file, bounce);
+    }
+    WriteVector(file, cache.sh_light_map);
+    WriteVector(file, cache.light_variance);
+
+    bool written = ferror(file) == 0;
+    if (fclose(file) != 0 || !written) {
+        printf("cannot write bake cache %s\n", file_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool GetAffectedTexels(const AccelerationStructures* as, const BakeCache& previous, const BakeCache& current, float influence_radius,
+                       const std::vector<TexelData>& texels, const std::vector<glm::vec4>& normal_data, std::vector<uint8_t>& affected) {
+    if (previous.settings_hash != current.settings_hash || previous.width != current.width || previous.height != current.height ||
+        previous.mesh_hashes.size() != current.mesh_hashes.size()) {
+        return false;
+    }
+
+    std::vector<uint8_t> changed_meshes(current.mesh_hashes.size(), 0);
+    std::vector<AABB> changed_bounds;
+    for (uint32_t m = 0; m < current.mesh_hashes.size(); ++m) {
+        if (previous.mesh_hashes[m] == current.mesh_hashes[m]) {
+            continue;
+        }
+        if (previous.mesh_emissive[m] || current.mesh_emissive[m]) {
+            return false;
+        }
+        changed_meshes[m] = 1;
+        changed_bounds.push_back(previous.mesh_bounds[m]);
+        changed_bounds.push_back(current.mesh_bounds[m]);
+    }
+    // 扩展前的包围盒用于判断哪些灯光的阴影会被变化的模型改变
+    std::vector<AABB> occluder_bounds = changed_bounds;
+    for (AABB& bounds : changed_bounds) {
+        bounds.Grow(influence_radius);
+    }
+
+    // 灯光按参数hash匹配, 只在一边出现的灯光视为变化, 灯光顺序变化不会触发重新烘焙
+    std::unordered_map<uint64_t, int> light_counts;
+    for (const Light& light : previous.lights) {
+        light_counts[HashBytes(&light, sizeof(Light))]++;
+    }
+    for (const Light& light : current.lights) {
+        light_counts[HashBytes(&light, sizeof(Light))]--;
+    }
+    std::vector<uint8_t> changed_cells(LIGHT_GRID_SIZE * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE, 0);
+    auto mark_light = [&](const Light& light) {
+        glm::ivec3 min_cell, max_cell;
+        if (!GetLightGridCells(as, light, influence_radius, min_cell, max_cell)) {
+            return;
+        }
+        for (int z = min_cell.z; z <= max_cell.z; z++) {
+            for (int y = min_cell.y; y <= max_cell.y; y++) {
+                for (int x = min_cell.x; x <= max_cell.x; x++) {
+                    changed_cells[x + (y * LIGHT_GRID_SIZE) + (z * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE)] = 1;
+                }
+            }
+        }
+    };
+    for (const std::vector<Light>* lights : {&previous.lights, &current.lights}) {
+        for (const Light& light : *lights) {
+            if (light_counts[HashBytes(&light, sizeof(Light))] == 0) {
+                continue;
+            }
+            if (light.type == LIGHT_TYPE_DIRECTIONAL) {
+                return false;
+            }
+            mark_light(light);
+        }
+    }
+
+    // 未变化的灯光范围内有模型移动时, 阴影的变化可以到达灯光范围内的任意位置
+    // 方向光没有范围, 它的阴影变化只按influence_radius处理, 否则任何模型变化都会全量烘焙
+    for (const Light& light : current.lights) {
+        if (light.type == LIGHT_TYPE_DIRECTIONAL) {
+            continue;
+        }
+        for (const AABB& bounds : occluder_bounds) {
+            glm::vec3 closest = glm::clamp(light.position, bounds.min, bounds.max);
+            if (glm::distance(closest, light.position) <= light.range) {
+                mark_light(light);
+                break;
+            }
+        }
+    }
+
+    glm::vec3 cell_size = as->bounds.GetSize() / float(LIGHT_GRID_SIZE);
+    affected.assign(texels.size(), 0);
+    for (uint32_t t = 0; t < texels.size(); ++t) {
+        const TexelData& texel = texels[t];
+        uint32_t idx = texel.atlas_y * current.width + texel.atlas_x;
+        if (changed_meshes[GetTexelMesh(as, normal_data[idx])]) {
+            affected[t] = 1;
+            continue;
+        }
+
+        glm::ivec3 light_cell = glm::ivec3(glm::floor((texel.position - as->bounds.min) / cell_size));
+        light_cell = glm::clamp(light_cell, glm::ivec3(0), glm::ivec3(LIGHT_GRID_SIZE - 1));
+        if (changed_cells[light_cell.x + (light_cell.y * LIGHT_GRID_SIZE) + (light_cell.z * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE)]) {
+            affected[t] = 1;
+            continue;
+        }
+
+        for (const AABB& bounds : changed_bounds) {
+            if (glm::all(glm::greaterThanEqual(texel.position, bounds.min)) && glm::all(glm::lessThanEqual(texel.position, bounds.max))) {
+                affected[t] = 1;
+                break;
+            }
+        }
+    }
+    return true;
+}
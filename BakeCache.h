@@ -0,0 +1,69 @@
+#pragma once
+
+#include "LightMapperDefine.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct AccelerationStructures;
+
+// 缓存格式变化时修改, 旧的缓存会被视为无效并全量烘焙
+const uint32_t BAKE_CACHE_VERSION = 1;
+
+// 上一次CPU烘焙的结果和场景快照, 用于增量烘焙时只重新追踪受影响的纹素
+// 光照数据都以RGBA32F保存, 在降噪和扩展之前写入, 因此可以直接作为下一次烘焙的初始值
+struct BakeCache {
+    // 烘焙参数, atlas布局和环境光的hash, 任何一项变化都需要全量烘焙
+    uint64_t settings_hash = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // 每个模型的几何, 材质和覆盖纹素反照率的hash
+    std::vector<uint64_t> mesh_hashes;
+    std::vector<AABB> mesh_bounds;
+    std::vector<uint32_t> mesh_emissive;
+    std::vector<Light> lights;
+    // 直接光照和每次弹射的结果, 对应CpuBaker中的source_light和dest_light
+    std::vector<glm::vec4> direct_light;
+    std::vector<std::vector<glm::vec4>> bounce_light;
+    // 4层SH按层依次存放
+    std::vector<glm::vec4> sh_light_map;
+    std::vector<float> light_variance;
+};
+
+// 二进制文件中的数组先写入元素个数, 再写入数据, 与分片烘焙的中间文件共用
+template <typename T>
+inline void WriteVector(FILE* file, const std::vector<T>& data) {
+    uint64_t size = data.size();
+    fwrite(&size, sizeof(size), 1, file);
+    if (size > 0) {
+        fwrite(data.data(), sizeof(T), size, file);
+    }
+}
+
+template <typename T>
+inline bool ReadVector(FILE* file, std::vector<T>& data) {
+    uint64_t size = 0;
+    if (fread(&size, sizeof(size), 1, file) != 1) {
+        return false;
+    }
+    data.resize(size);
+    return size == 0 || fread(data.data(), sizeof(T), size, file) == size;
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+// 填写缓存中的场景快照, normal_data.w为纹素所在的三角形, 用于统计每个模型覆盖纹素的反照率
+void CaptureBakeScene(const AccelerationStructures* as, const std::vector<Light>& lights, const std::vector<glm::vec4>& normal_data, BakeCache& cache);
+
+bool LoadBakeCache(const std::string& file_path, BakeCache& cache);
+
+bool SaveBakeCache(const std::string& file_path, const BakeCache& cache);
+
+// 对比新旧快照, 标记需要重新追踪的纹素, 返回false表示需要全量烘焙
+// 变化模型覆盖的纹素, 变化模型新旧包围盒向外扩展influence_radius内的纹素,
+// 变化灯光新旧范围扩展influence_radius后所覆盖的灯光网格cell中的纹素,
+// 以及范围与变化模型新旧包围盒相交的灯光所覆盖的cell中的纹素都需要重新追踪
+// 方向光或自发光模型的变化会影响整个场景, 直接全量烘焙
+bool GetAffectedTexels(const AccelerationStructures* as, const BakeCache& previous, const BakeCache& current, float influence_radius,
+                       const std::vector<TexelData>& texels, const std::vector<glm::vec4>& normal_data, std::vector<uint8_t>& affected);
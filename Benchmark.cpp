@@ -0,0 +1,253 @@
+#include "LightMapperDefine.h"
+#include "Importer.h"
+#include "Model.h"
+#include "Builder.h"
+#include "Tracer.h"
+#include "Parallel.h"
+#include "Stats.h"
+#include "SceneGenerator.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// 基准测试: 对自带场景及其复制放大的版本, 以及程序化生成的大场景测量导入, atlas, 加速结构和CPU光线遍历的性能
+// 用法: LightmapperBenchmark [report.json] [rays]
+// 生成场景: LightmapperBenchmark --generate-scene <clutter|stadium|city> <output.gltf> [objects] [detail] [seed]
+
+static std::string ProjectDir(PROJECT_DIR);
+
+static double ElapsedMs(const std::chrono::high_resolution_clock::time_point& start) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return elapsed.count();
+}
+
+template <typename T>
+static uint8_t* CopyArray(const uint8_t* data, uint32_t count) {
+    uint8_t* copy = new uint8_t[count * sizeof(T)];
+    memcpy(copy, data, count * sizeof(T));
+    return copy;
+}
+
+// 按网格平移复制场景, 只复制几何和材质参数, 纹理不参与遍历测试
+static std::vector<Model*> InstanceScene(std::vector<Model*>& models, uint32_t copies) {
+    AABB bounds;
+    for (Model* model : models) {
+        const glm::vec3* positions = (const glm::vec3*)model->GetPositionData();
+        for (uint32_t i = 0; i < model->GetVertexCount(); ++i) {
+            bounds.Expand(positions[i]);
+        }
+    }
+
+    uint32_t row = (uint32_t)glm::ceil(glm::sqrt(float(copies)));
+    glm::vec3 spacing = bounds.GetSize() * 1.25f;
+    std::vector<Model*> instances;
+    for (uint32_t c = 0; c < copies; ++c) {
+        glm::vec3 offset = glm::vec3(float(c % row) * spacing.x, 0.0f, float(c / row) * spacing.z);
+        for (Model* model : models) {
+            uint32_t vertex_count = model->GetVertexCount();
+            Model* instance = new Model();
+            instance->SetModelMatriax(model->GetModelMatriax());
+            instance->SetVertexCount(vertex_count);
+            instance->SetIndexCount(model->GetIndexCount());
+            instance->SetIndexType(model->GetIndexType());
+            instance->SetEmissiveFactor(model->GetEmissiveFactor());
+            instance->SetBaseColorFactor(model->GetBaseColorFactor());
+
+            uint8_t* position_data = CopyArray<glm::vec3>(model->GetPositionData(), vertex_count);
+            glm::vec3* positions = (glm::vec3*)position_data;
+            for (uint32_t i = 0; i < vertex_count; ++i) {
+                positions[i] += offset;
+            }
+            instance->SetPositionData(position_data);
+            instance->SetNormalData(CopyArray<glm::vec3>(model->GetNormalData(), vertex_count));
+            instance->SetUV0Data(CopyArray<glm::vec2>(model->GetUV0Data(), vertex_count));
+            instance->SetUV1Data(CopyArray<glm::vec2>(model->GetUV1Data(), vertex_count));
+            if (model->GetIndexType() == blast::INDEX_TYPE_UINT16) {
+                instance->SetIndexData(CopyArray<uint16_t>(model->GetIndexData(), model->GetIndexCount()));
+            } else {
+                instance->SetIndexData(CopyArray<uint32_t>(model->GetIndexData(), model->GetIndexCount()));
+            }
+            instances.push_back(instance);
+        }
+    }
+    return instances;
+}
+
+static uint32_t PcgHash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static float RandomFloat(uint32_t& seed) {
+    seed = PcgHash(seed);
+    return float(seed) / float(0xffffffffu);
+}
+
+// coherent: 从包围盒一侧平面发出的平行光线, 按扫描线顺序排列
+// incoherent: 包围盒内随机起点和随机方向
+static void GenerateRays(const AABB& bounds, uint32_t ray_count, bool coherent, std::vector<glm::vec3>& from, std::vector<glm::vec3>& to) {
+    glm::vec3 size = bounds.GetSize();
+    float length = glm::length(size);
+    from.resize(ray_count);
+    to.resize(ray_count);
+
+    uint32_t seed = 1u;
+    if (coherent) {
+        uint32_t side = (uint32_t)glm::ceil(glm::sqrt(float(ray_count)));
+        glm::vec3 dir = glm::normalize(glm::vec3(0.1f, -0.2f, -1.0f));
+        for (uint32_t i = 0; i < ray_count; ++i) {
+            float u = (float(i % side) + 0.5f) / float(side);
+            float v = (float(i / side) + 0.5f) / float(side);
+            from[i] = glm::vec3(bounds.min.x + u * size.x, bounds.min.y + v * size.y, bounds.max.z) - dir * (length * 0.01f);
+            to[i] = from[i] + dir * length;
+        }
+    } else {
+        for (uint32_t i = 0; i < ray_count; ++i) {
+            glm::vec3 p = glm::vec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed));
+            float z = RandomFloat(seed) * 2.0f - 1.0f;
+            float phi = RandomFloat(seed) * 2.0f * 3.14159265f;
+            float r = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+            glm::vec3 dir = glm::vec3(r * glm::cos(phi), r * glm::sin(phi), z);
+            from[i] = bounds.min + p * size;
+            to[i] = from[i] + dir * length;
+        }
+    }
+}
+
+static void BenchmarkRays(Tracer& tracer, const std::vector<glm::vec3>& from, const std::vector<glm::vec3>& to, bool any_hit, const std::string& name, BakeStats& stats) {
+    tracer.SetStatsEnabled(true);
+    tracer.ResetCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    ParallelFor(from.size(), 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            if (any_hit) {
+                tracer.TraceShadowRay(from[i], to[i]);
+            } else {
+                Interaction isect;
+                tracer.TraceRay(from[i], to[i], isect);
+            }
+        }
+    });
+    double ms = ElapsedMs(start);
+    tracer.SetStatsEnabled(false);
+
+    TraceCounters counters = tracer.GetCounters();
+    double mrays = counters.rays / (ms * 1000.0);
+    stats.AddTiming(name, ms);
+    stats.AddValue(name + ".mrays_per_second", mrays);
+    stats.AddValue(name + ".cells_per_ray", counters.cells_visited / std::max(1.0, double(counters.rays)));
+    stats.AddValue(name + ".triangle_tests_per_ray", counters.triangle_tests / std::max(1.0, double(counters.rays)));
+    stats.AddValue(name + ".hit_ratio", counters.hits / std::max(1.0, double(counters.rays)));
+    printf("%s: %.3f Mrays/s\n", name.c_str(), mrays);
+}
+
+// 测量atlas和加速结构的构建以及四种光线的遍历, 结束后释放models
+static void BenchmarkScene(const std::string& name, std::vector<Model*>& models, uint32_t ray_count, BakeStats& stats) {
+    // resolution固定, 由xatlas按场景大小决定texels_per_unit
+    auto start = std::chrono::high_resolution_clock::now();
+    glm::uvec2 atlas_size = GenerateLightmapUV(models, 1024, 0.0f, 2);
+    if (atlas_size.x == 0 || atlas_size.y == 0) {
+        printf("%s: generate lightmap uv failed\n", name.c_str());
+        for (Model* model : models) {
+            SAFE_DELETE(model);
+        }
+        return;
+    }
+    stats.AddTiming(name + ".atlas", ElapsedMs(start));
+
+    start = std::chrono::high_resolution_clock::now();
+    AccelerationStructures* as = BuildAccelerationStructures(models);
+    stats.AddTiming(name + ".acceleration_structures", ElapsedMs(start));
+    stats.AddCounter(name + ".triangles", as->triangles.size());
+    stats.AddCounter(name + ".atlas_texels", uint64_t(atlas_size.x) * atlas_size.y);
+
+    Tracer tracer(as, 0.02f);
+    std::vector<glm::vec3> from;
+    std::vector<glm::vec3> to;
+    GenerateRays(as->bounds, ray_count, true, from, to);
+    BenchmarkRays(tracer, from, to, false, name + ".coherent_closest_hit", stats);
+    BenchmarkRays(tracer, from, to, true, name + ".coherent_any_hit", stats);
+    GenerateRays(as->bounds, ray_count, false, from, to);
+    BenchmarkRays(tracer, from, to, false, name + ".incoherent_closest_hit", stats);
+    BenchmarkRays(tracer, from, to, true, name + ".incoherent_any_hit", stats);
+
+    SAFE_DELETE(as);
+    for (Model* model : models) {
+        SAFE_DELETE(model);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 3 && strcmp(argv[1], "--generate-scene") == 0) {
+        SceneGeneratorDesc desc;
+        if (!ParseSceneLayout(argv[2], desc.layout)) {
+            printf("unknown scene layout %s\n", argv[2]);
+            return 1;
+        }
+        desc.object_count = argc > 4 ? (uint32_t)atoi(argv[4]) : desc.object_count;
+        desc.detail = argc > 5 ? (uint32_t)atoi(argv[5]) : desc.detail;
+        desc.seed = argc > 6 ? (uint32_t)atoi(argv[6]) : desc.seed;
+        return GenerateScene(desc, argv[3]) ? 0 : 1;
+    }
+
+    std::string report_path = argc > 1 ? argv[1] : "benchmark.json";
+    uint32_t ray_count = argc > 2 ? (uint32_t)atoi(argv[2]) : 262144;
+
+    const char* scenes[] = {"CornellBox", "builtin", "test"};
+    const uint32_t scales[] = {1, 10, 100};
+
+    BakeStats stats;
+    stats.AddCounter("rays", ray_count);
+    stats.AddCounter("threads", GetWorkerCount());
+    for (const char* scene : scenes) {
+        for (uint32_t scale : scales) {
+            std::string name = std::string(scene) + "_" + std::to_string(scale) + "x";
+
+            auto start = std::chrono::high_resolution_clock::now();
+            std::vector<Model*> imported = ImportScene(ProjectDir + "/Resources/Scenes/" + scene + ".gltf");
+            stats.AddTiming(name + ".import", ElapsedMs(start));
+
+            std::vector<Model*> models = InstanceScene(imported, scale);
+            for (Model* model : imported) {
+                SAFE_DELETE(model);
+            }
+            BenchmarkScene(name, models, ray_count, stats);
+        }
+    }
+
+    // 程序化场景, 每个约十万个三角形
+    struct GeneratedScene {
+        const char* name;
+        SceneLayout layout;
+        uint32_t object_count;
+        uint32_t detail;
+    };
+    const GeneratedScene generated_scenes[] = {
+        {"clutter", SCENE_LAYOUT_UNIFORM_CLUTTER, 500, 16},
+        {"stadium", SCENE_LAYOUT_TEAPOT_IN_STADIUM, 512, 256},
+        {"city", SCENE_LAYOUT_CITY_BLOCKS, 400, 16},
+    };
+    for (const GeneratedScene& scene : generated_scenes) {
+        SceneGeneratorDesc desc;
+        desc.layout = scene.layout;
+        desc.object_count = scene.object_count;
+        desc.detail = scene.detail;
+        std::string file_path = ProjectDir + "/Resources/Scenes/Generated/" + scene.name + ".gltf";
+        if (!GenerateScene(desc, file_path)) {
+            continue;
+        }
+
+        std::string name = std::string("generated_") + scene.name;
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<Model*> models = ImportScene(file_path);
+        stats.AddTiming(name + ".import", ElapsedMs(start));
+        BenchmarkScene(name, models, ray_count, stats);
+    }
+
+    return stats.WriteJson(report_path) ? 0 : 1;
+}
@@ -1,8 +1,11 @@
 #include "Builder.h"
+#include "Rasterizer.h"
 
 #include <Blast/Gfx/GfxDefine.h>
+#include <xatlas.h>
 
 #include <algorithm>
+#include <cfloat>
 #include <unordered_map>
 #include <functional>
 
@@ -250,6 +253,127 @@ void PlotTriangleIntoTriangleIndexList(int grid_size, const glm::ivec3& grid_off
     }
 }
 
+// 收集自发光三角形, 按功率构建alias表
+static void BuildEmissiveLights(AccelerationStructures* as) {
+    as->emissive_lights.clear();
+    std::vector<float> powers;
+    float total_power = 0.0f;
+    for (uint32_t i = 0; i < as->triangles.size(); i++) {
+        glm::vec3 radiance = as->triangle_materials[i].emissive;
+        float luminance = glm::dot(radiance, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        if (luminance <= 0.0f) {
+            continue;
+        }
+
+        const Triangle& t = as->triangles[i];
+        glm::vec3 p0 = as->vertices[t.indices[0]].position;
+        glm::vec3 p1 = as->vertices[t.indices[1]].position;
+        glm::vec3 p2 = as->vertices[t.indices[2]].position;
+        glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(cross) * 0.5f;
+        if (area <= 0.0f) {
+            continue;
+        }
+
+        // 发光面朝向与顶点法线一致
+        glm::vec3 normal = glm::normalize(cross);
+        glm::vec3 vertex_normal = as->vertices[t.indices[0]].normal + as->vertices[t.indices[1]].normal + as->vertices[t.indices[2]].normal;
+        if (glm::dot(normal, vertex_normal) < 0.0f) {
+            normal = -normal;
+        }
+
+        EmissiveLight light;
+        light.radiance = radiance;
+        light.triangle_index = i;
+        light.normal = normal;
+        light.area = area;
+        as->emissive_lights.push_back(light);
+        powers.push_back(luminance * area);
+        total_power += luminance * area;
+    }
+
+    // Vose alias method
+    uint32_t count = as->emissive_lights.size();
+    std::vector<float> scaled(count);
+    std::vector<uint32_t> small, large;
+    for (uint32_t i = 0; i < count; i++) {
+        as->emissive_lights[i].pdf = powers[i] / total_power;
+        scaled[i] = as->emissive_lights[i].pdf * count;
+        if (scaled[i] < 1.0f) {
+            small.push_back(i);
+        } else {
+            large.push_back(i);
+        }
+    }
+
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back();
+        small.pop_back();
+        uint32_t l = large.back();
+        large.pop_back();
+
+        as->emissive_lights[s].alias_prob = scaled[s];
+        as->emissive_lights[s].alias = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0f;
+        if (scaled[l] < 1.0f) {
+            small.push_back(l);
+        } else {
+            large.push_back(l);
+        }
+    }
+
+    // 剩余的项由于浮点误差概率都视为1
+    for (uint32_t i : large) {
+        as->emissive_lights[i].alias_prob = 1.0f;
+        as->emissive_lights[i].alias = i;
+    }
+    for (uint32_t i : small) {
+        as->emissive_lights[i].alias_prob = 1.0f;
+        as->emissive_lights[i].alias = i;
+    }
+
+    printf("emissive lights: %d triangles, total power %f\n", count, total_power);
+}
+
+static uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+// xatlas会在chart边界拆分顶点, 共享顶点的三角形属于同一个chart
+// chart索引写入三角形索引的第4位, 从0开始连续编号
+static void BuildTriangleCharts(AccelerationStructures* as) {
+    std::vector<uint32_t> parents(as->vertices.size());
+    for (uint32_t i = 0; i < parents.size(); i++) {
+        parents[i] = i;
+    }
+
+    for (const Triangle& t : as->triangles) {
+        uint32_t root = FindRoot(parents, t.indices[0]);
+        for (int k = 1; k < 3; k++) {
+            uint32_t other = FindRoot(parents, t.indices[k]);
+            if (other != root) {
+                parents[other] = root;
+            }
+        }
+    }
+
+    std::unordered_map<uint32_t, uint32_t> chart_indices;
+    for (Triangle& t : as->triangles) {
+        uint32_t root = FindRoot(parents, t.indices[0]);
+        auto iter = chart_indices.find(root);
+        if (iter == chart_indices.end()) {
+            iter = chart_indices.emplace(root, uint32_t(chart_indices.size())).first;
+        }
+        t.indices[3] = iter->second;
+    }
+
+    printf("lightmap charts: %zu\n", chart_indices.size());
+}
+
 AccelerationStructures* BuildAccelerationStructures(std::vector<Model*>& models) {
     AccelerationStructures* as = new AccelerationStructures();
 
@@ -279,6 +403,7 @@ AccelerationStructures* BuildAccelerationStructures(std::vector<Model*>& models)
 
     int vertex_offset = 0;
     for (int i = 0; i < models.size(); i++) {
+        as->mesh_triangle_offsets.push_back(as->triangles.size());
         std::unordered_map<Edge, EdgeUV, MurmurHash<Edge>, EdgeEq> edges;
         uint16_t* index16_data = (uint16_t*)models[i]->GetIndexData();
         uint32_t* index32_data = (uint32_t*)models[i]->GetIndexData();
@@ -350,10 +475,35 @@ AccelerationStructures* BuildAccelerationStructures(std::vector<Model*>& models)
             t.max_bounds[1] = taabb.max.y;
             t.max_bounds[2] = taabb.max.z;
             as->triangles.push_back(t);
+
+            // 自发光取三角形上几个点的平均值
+            // 每个采样点代表约四分之一的三角形, mip层按这部分覆盖的纹理像素数选取, 避免大三角形上的走样
+            TriangleMaterial material;
+            material.emissive = glm::vec4(models[i]->GetEmissiveFactor(), 0.0f);
+            const TextureData* emissive_texture = models[i]->GetEmissiveTexture();
+            if (emissive_texture && material.emissive != glm::vec4(0.0f)) {
+                glm::vec2 texture_size = glm::vec2(emissive_texture->width, emissive_texture->height);
+                glm::vec2 e1 = (uvs[1] - uvs[0]) * texture_size;
+                glm::vec2 e2 = (uvs[2] - uvs[0]) * texture_size;
+                float texel_area = glm::abs(e1.x * e2.y - e1.y * e2.x) * 0.5f;
+                float lod = glm::log2(glm::max(glm::sqrt(texel_area * 0.25f), 1.0f));
+
+                glm::vec4 texture_emissive = emissive_texture->SampleLevel((uvs[0] + uvs[1] + uvs[2]) / 3.0f, lod);
+                for (int k = 0; k < 3; k++) {
+                    texture_emissive += emissive_texture->SampleLevel((uvs[k] * 4.0f + uvs[(k + 1) % 3] + uvs[(k + 2) % 3]) / 6.0f, lod);
+                }
+                material.emissive *= glm::vec4(glm::vec3(texture_emissive) * 0.25f, 1.0f);
+            }
+            as->triangle_materials.push_back(material);
         }
 
         vertex_offset += models[i]->GetVertexCount();
     }
+    as->mesh_triangle_offsets.push_back(as->triangles.size());
+
+    BuildEmissiveLights(as);
+
+    BuildTriangleCharts(as);
 
     // 为了避免数值错误稍微扩充下包围盒
     as->bounds.Grow(0.1f);
@@ -405,4 +555,299 @@ AccelerationStructures* BuildAccelerationStructures(std::vector<Model*>& models)
     }
 
     return as;
-}
\ No newline at end of file
+}
+
+bool GetLightGridCells(const AccelerationStructures* as, const Light& light, float extent, glm::ivec3& min_cell, glm::ivec3& max_cell) {
+    min_cell = glm::ivec3(0);
+    max_cell = glm::ivec3(LIGHT_GRID_SIZE - 1);
+    if (light.type == LIGHT_TYPE_DIRECTIONAL) {
+        return true;
+    }
+
+    // 按灯光范围剔除
+    glm::vec3 cell_size = as->bounds.GetSize() / float(LIGHT_GRID_SIZE);
+    float range = light.range + extent;
+    min_cell = glm::ivec3(glm::floor((light.position - range - as->bounds.min) / cell_size));
+    max_cell = glm::ivec3(glm::floor((light.position + range - as->bounds.min) / cell_size));
+    if (glm::any(glm::greaterThan(min_cell, glm::ivec3(LIGHT_GRID_SIZE - 1))) || glm::any(glm::lessThan(max_cell, glm::ivec3(0)))) {
+        return false;
+    }
+    min_cell = glm::clamp(min_cell, glm::ivec3(0), glm::ivec3(LIGHT_GRID_SIZE - 1));
+    max_cell = glm::clamp(max_cell, glm::ivec3(0), glm::ivec3(LIGHT_GRID_SIZE - 1));
+    return true;
+}
+
+void BuildLightGrid(AccelerationStructures* as, const std::vector<Light>& lights) {
+    glm::vec3 cell_size = as->bounds.GetSize() / float(LIGHT_GRID_SIZE);
+    uint32_t cell_count = LIGHT_GRID_SIZE * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE;
+    std::vector<std::vector<uint32_t>> cell_lights(cell_count);
+
+    for (uint32_t i = 0; i < lights.size(); i++) {
+        const Light& light = lights[i];
+        glm::ivec3 min_cell, max_cell;
+        if (!GetLightGridCells(as, light, 0.0f, min_cell, max_cell)) {
+            continue;
+        }
+
+        for (int z = min_cell.z; z <= max_cell.z; z++) {
+            for (int y = min_cell.y; y <= max_cell.y; y++) {
+                for (int x = min_cell.x; x <= max_cell.x; x++) {
+                    if (light.type != LIGHT_TYPE_DIRECTIONAL) {
+                        glm::vec3 cell_min = as->bounds.min + glm::vec3(x, y, z) * cell_size;
+                        glm::vec3 closest = glm::clamp(light.position, cell_min, cell_min + cell_size);
+                        if (glm::distance(closest, light.position) > light.range) {
+                            continue;
+                        }
+                    }
+                    cell_lights[x + (y * LIGHT_GRID_SIZE) + (z * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE)].push_back(i);
+                }
+            }
+        }
+    }
+
+    as->light_indices.clear();
+    as->light_grid.resize(cell_count * 2);
+    uint32_t max_cell_lights = 0;
+    for (uint32_t cell = 0; cell < cell_count; cell++) {
+        as->light_grid[cell * 2] = cell_lights[cell].size();
+        as->light_grid[cell * 2 + 1] = as->light_indices.size();
+        as->light_indices.insert(as->light_indices.end(), cell_lights[cell].begin(), cell_lights[cell].end());
+        max_cell_lights = glm::max(max_cell_lights, (uint32_t)cell_lights[cell].size());
+    }
+
+    // 空列表时保证buffer不为空
+    if (as->light_indices.empty()) {
+        as->light_indices.push_back(0);
+    }
+
+    printf("light grid: %d lights, max %d lights per cell\n", (uint32_t)lights.size(), max_cell_lights);
+}
+
+// 在lightmap空间按G-buffer相同的保守光栅化覆盖三角形, 按纹素覆盖的纹理面积选取mip层采样基础色
+// 每个纹素与G-buffer选取相同的三角形和最近点, G-buffer覆盖的纹素都有反照率
+void BuildAlbedoAtlas(AccelerationStructures* as, std::vector<Model*>& models, uint32_t width, uint32_t height) {
+    as->albedo_width = width;
+    as->albedo_height = height;
+    as->albedo_atlas.assign(width * height, glm::vec4(0.0f));
+    std::vector<float> albedo_distance(width * height, FLT_MAX);
+
+    glm::vec2 atlas_size = glm::vec2(width, height);
+    uint32_t triangle_offset = 0;
+    for (int i = 0; i < models.size(); i++) {
+        glm::vec4 factor = models[i]->GetBaseColorFactor();
+        TextureData* texture = models[i]->GetBaseColorTexture();
+        if (texture && texture->mips.empty()) {
+            texture = nullptr;
+        }
+
+        uint32_t triangle_count = models[i]->GetIndexCount() / 3;
+        for (uint32_t t = triangle_offset; t < triangle_offset + triangle_count; t++) {
+            const Triangle& triangle = as->triangles[t];
+            glm::vec2 uv[3];
+            glm::vec2 tex_uv[3];
+            for (int k = 0; k < 3; k++) {
+                uv[k] = as->vertices[triangle.indices[k]].uv1 * atlas_size;
+                tex_uv[k] = as->vertices[triangle.indices[k]].uv0;
+            }
+
+            glm::mat2 uv_edges = glm::mat2(uv[1] - uv[0], uv[2] - uv[0]);
+            if (glm::abs(glm::determinant(uv_edges)) < 1e-8f) {
+                continue;
+            }
+            glm::mat2 inv_uv_edges = glm::inverse(uv_edges);
+
+            // 一个lightmap纹素覆盖的纹理像素数决定mip层
+            float lod = 0.0f;
+            if (texture) {
+                glm::vec2 texture_size = glm::vec2(texture->width, texture->height);
+                glm::vec2 duvdx = ((tex_uv[1] - tex_uv[0]) * inv_uv_edges[0][0] + (tex_uv[2] - tex_uv[0]) * inv_uv_edges[0][1]) * texture_size;
+                glm::vec2 duvdy = ((tex_uv[1] - tex_uv[0]) * inv_uv_edges[1][0] + (tex_uv[2] - tex_uv[0]) * inv_uv_edges[1][1]) * texture_size;
+                float footprint = glm::max(glm::length(duvdx), glm::length(duvdy));
+                lod = glm::log2(glm::max(footprint, 1.0f));
+            }
+
+            glm::vec2 uv_min = glm::min(uv[0], glm::min(uv[1], uv[2])) - GBUFFER_DILATION - 0.5f;
+            glm::vec2 uv_max = glm::max(uv[0], glm::max(uv[1], uv[2])) + GBUFFER_DILATION - 0.5f;
+            int x0 = glm::max(0, int(glm::ceil(uv_min.x)));
+            int y0 = glm::max(0, int(glm::ceil(uv_min.y)));
+            int x1 = glm::min(int(width) - 1, int(glm::floor(uv_max.x)));
+            int y1 = glm::min(int(height) - 1, int(glm::floor(uv_max.y)));
+
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    // 距离相同时后面的三角形覆盖之前的, 与RasterizeGBuffer一致
+                    glm::vec2 closest;
+                    float distance;
+                    if (!GetTexelCoverage(uv, glm::vec2(x + 0.5f, y + 0.5f), GBUFFER_DILATION, closest, distance) ||
+                        distance > albedo_distance[y * width + x]) {
+                        continue;
+                    }
+                    albedo_distance[y * width + x] = distance;
+
+                    glm::vec2 b12 = glm::clamp(inv_uv_edges * (closest - uv[0]), 0.0f, 1.0f);
+                    glm::vec3 barycentric = glm::vec3(glm::max(1.0f - b12.x - b12.y, 0.0f), b12.x, b12.y);
+                    barycentric /= barycentric.x + barycentric.y + barycentric.z;
+
+                    glm::vec3 albedo = factor;
+                    if (texture) {
+                        glm::vec2 sample_uv = tex_uv[0] * barycentric.x + tex_uv[1] * barycentric.y + tex_uv[2] * barycentric.z;
+                        albedo *= glm::vec3(texture->SampleLevel(sample_uv, lod));
+                    }
+                    as->albedo_atlas[y * width + x] = glm::vec4(albedo, 1.0f);
+                }
+            }
+        }
+        triangle_offset += triangle_count;
+    }
+
+    // 覆盖范围与G-buffer一致, 再向外扩展两圈, 命中点在chart边缘双线性采样时不会混入未覆盖的纹素
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<glm::vec4> dilated = as->albedo_atlas;
+        for (int y = 0; y < int(height); y++) {
+            for (int x = 0; x < int(width); x++) {
+                if (as->albedo_atlas[y * width + x].w > 0.0f) {
+                    continue;
+                }
+
+                glm::vec4 sum = glm::vec4(0.0f);
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        int ny = y + dy;
+                        if (nx >= 0 && ny >= 0 && nx < int(width) && ny < int(height)) {
+                            sum += as->albedo_atlas[ny * width + nx];
+                        }
+                    }
+                }
+                if (sum.w > 0.0f) {
+                    dilated[y * width + x] = glm::vec4(glm::vec3(sum) / sum.w, 1.0f);
+                }
+            }
+        }
+        as->albedo_atlas = dilated;
+    }
+}
+
+// 按亮度乘sin(theta)构建二维CDF, 先按边缘分布选行再按条件分布选列
+void BuildEnvironmentMap(AccelerationStructures* as, const std::vector<glm::vec4>& pixels, uint32_t width, uint32_t height) {
+    as->environment_info = {};
+    as->environment_map.clear();
+    as->environment_cdf.clear();
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    std::vector<float> marginal(height + 1, 0.0f);
+    std::vector<float> conditional(height * (width + 1), 0.0f);
+    for (uint32_t y = 0; y < height; y++) {
+        float sin_theta = glm::sin(glm::pi<float>() * (y + 0.5f) / float(height));
+        float* row = conditional.data() + y * (width + 1);
+        for (uint32_t x = 0; x < width; x++) {
+            glm::vec3 color = pixels[y * width + x];
+            row[x + 1] = row[x] + glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f)) * sin_theta;
+        }
+
+        float row_sum = row[width];
+        for (uint32_t x = 1; x <= width; x++) {
+            row[x] = row_sum > 0.0f ? row[x] / row_sum : float(x) / float(width);
+        }
+        marginal[y + 1] = marginal[y] + row_sum;
+    }
+
+    float total = marginal[height];
+    if (total <= 0.0f) {
+        return;
+    }
+    for (uint32_t y = 1; y <= height; y++) {
+        marginal[y] /= total;
+    }
+
+    as->environment_info.width = width;
+    as->environment_info.height = height;
+    as->environment_info.integral = total / float(width * height);
+    as->environment_map = pixels;
+    as->environment_cdf = marginal;
+    as->environment_cdf.insert(as->environment_cdf.end(), conditional.begin(), conditional.end());
+
+    printf("environment map: %d x %d, integral %f\n", width, height, as->environment_info.integral);
+}
+
+// 用xatlas为模型生成lightmap uv并按atlas重建顶点和索引数据, 返回atlas尺寸
+glm::uvec2 GenerateLightmapUV(std::vector<Model*>& models, uint32_t resolution, float texels_per_unit, uint32_t padding) {
+    xatlas::Atlas* atlas = xatlas::Create();
+    for (uint32_t i = 0; i < models.size(); ++i) {
+        xatlas::MeshDecl mesh_decl;
+        mesh_decl.vertexCount = models[i]->GetVertexCount();
+        mesh_decl.vertexPositionData = models[i]->GetPositionData();
+        mesh_decl.vertexPositionStride = sizeof(glm::vec3);
+        mesh_decl.vertexNormalData = models[i]->GetNormalData();
+        mesh_decl.vertexNormalStride = sizeof(glm::vec3);
+        mesh_decl.vertexUvData = models[i]->GetUV0Data();
+        mesh_decl.vertexUvStride = sizeof(glm::vec2);
+        mesh_decl.indexData = models[i]->GetIndexData();
+        mesh_decl.indexCount = models[i]->GetIndexCount();
+        mesh_decl.indexFormat = models[i]->GetIndexType() == blast::INDEX_TYPE_UINT16 ? xatlas::IndexFormat::UInt16 : xatlas::IndexFormat::UInt32;
+        // 跳过失败的模型会让atlas中的网格与models的下标错开, 直接返回失败
+        xatlas::AddMeshError ret = xatlas::AddMesh(atlas, mesh_decl);
+        if (ret != xatlas::AddMeshError::Success) {
+            printf("xatlas add mesh %u failed: %s\n", i, xatlas::StringForEnum(ret));
+            xatlas::Destroy(atlas);
+            return glm::uvec2(0);
+        }
+    }
+    xatlas::ChartOptions chartOptions;
+    xatlas::PackOptions packOptions;
+    packOptions.bilinear = true;
+    packOptions.padding = padding;
+    packOptions.texelsPerUnit = texels_per_unit;
+    packOptions.resolution = resolution;
+    xatlas::Generate(atlas, chartOptions, packOptions);
+
+    // Recreate VertexData IndexData
+    for (uint32_t i = 0; i < atlas->meshCount; ++i) {
+        xatlas::Mesh& atlas_mesh = atlas->meshes[i];
+        glm::vec3* old_position_data = (glm::vec3*)models[i]->GetPositionData();
+        glm::vec3* old_normal_data = (glm::vec3*)models[i]->GetNormalData();
+        glm::vec2* old_uv0_data = (glm::vec2*)models[i]->GetUV0Data();
+
+        float* position_data = new float[3 * atlas_mesh.vertexCount];
+        float* normal_data = new float[3 * atlas_mesh.vertexCount];
+        float* uv0_data = new float[2 * atlas_mesh.vertexCount];
+        float* uv1_data = new float[2 * atlas_mesh.vertexCount];
+        for (uint32_t j = 0; j < atlas_mesh.vertexCount; ++j) {
+            uint32_t xref = atlas_mesh.vertexArray[j].xref;
+
+            position_data[j * 3] = old_position_data[xref].x;
+            position_data[j * 3 + 1] = old_position_data[xref].y;
+            position_data[j * 3 + 2] = old_position_data[xref].z;
+
+            normal_data[j * 3] = old_normal_data[xref].x;
+            normal_data[j * 3 + 1] = old_normal_data[xref].y;
+            normal_data[j * 3 + 2] = old_normal_data[xref].z;
+
+            uv0_data[j * 2] = old_uv0_data[xref].x;
+            uv0_data[j * 2 + 1] = old_uv0_data[xref].y;
+
+            uv1_data[j * 2] = atlas_mesh.vertexArray[j].uv[0] / atlas->width;
+            uv1_data[j * 2 + 1] = atlas_mesh.vertexArray[j].uv[1] / atlas->height;
+        }
+
+        uint32_t* index_data = new uint32_t [atlas_mesh.indexCount];
+        for (uint32_t j = 0; j < atlas_mesh.indexCount; ++j) {
+            index_data[j] = atlas_mesh.indexArray[j];
+        }
+
+        models[i]->SetVertexCount(atlas_mesh.vertexCount);
+        models[i]->ResetPositionData((uint8_t*)position_data);
+        models[i]->ResetNormalData((uint8_t*)normal_data);
+        models[i]->ResetUV0Data((uint8_t*)uv0_data);
+        models[i]->ResetUV1Data((uint8_t*)uv1_data);
+        models[i]->ResetIndexData((uint8_t*)index_data);
+        models[i]->SetIndexCount(atlas_mesh.indexCount);
+        models[i]->SetIndexType(blast::INDEX_TYPE_UINT32);
+    }
+
+    glm::uvec2 atlas_size = glm::uvec2(atlas->width, atlas->height);
+    xatlas::Destroy(atlas);
+    return atlas_size;
+}
@@ -7,9 +7,39 @@ struct AccelerationStructures {
     AABB bounds;
     std::vector<Vertex> vertices;
     std::vector<Triangle> triangles;
+    // 每个模型第一个三角形的索引, 最后一项为三角形总数
+    std::vector<uint32_t> mesh_triangle_offsets;
     std::vector<Seam> seams;
     std::vector<uint32_t> triangle_indices;
     std::vector<uint32_t> grid_indices;
+    // 与grid_indices布局相同, 每个cell记录灯光数量和在light_indices中的偏移
+    std::vector<uint32_t> light_indices;
+    std::vector<uint32_t> light_grid;
+    std::vector<TriangleMaterial> triangle_materials;
+    std::vector<EmissiveLight> emissive_lights;
+    // lightmap空间的反照率, 与lightmap同尺寸
+    uint32_t albedo_width = 0;
+    uint32_t albedo_height = 0;
+    std::vector<glm::vec4> albedo_atlas;
+    // equirect环境贴图, 宽度为0表示没有环境光
+    EnvironmentInfo environment_info = {};
+    std::vector<glm::vec4> environment_map;
+    // 前height + 1项为按行的边缘CDF, 之后每行width + 1项为条件CDF
+    std::vector<float> environment_cdf;
 };
 
-AccelerationStructures* BuildAccelerationStructures(std::vector<Model*>& models);
\ No newline at end of file
+// resolution为0时由xatlas按texels_per_unit决定atlas尺寸
+// padding为chart之间的纹素间隔, 烘焙结束后由jump flood扩展填满, 不需要为双线性过滤预留很宽的间隔
+// 有模型无法加入atlas时返回0, 此时模型数据不变
+glm::uvec2 GenerateLightmapUV(std::vector<Model*>& models, uint32_t resolution, float texels_per_unit, uint32_t padding);
+
+AccelerationStructures* BuildAccelerationStructures(std::vector<Model*>& models);
+
+void BuildLightGrid(AccelerationStructures* as, const std::vector<Light>& lights);
+
+// 灯光范围向外扩展extent后覆盖的灯光网格cell范围, 方向光覆盖整个网格, 返回false表示与网格不相交
+bool GetLightGridCells(const AccelerationStructures* as, const Light& light, float extent, glm::ivec3& min_cell, glm::ivec3& max_cell);
+
+void BuildAlbedoAtlas(AccelerationStructures* as, std::vector<Model*>& models, uint32_t width, uint32_t height);
+
+void BuildEnvironmentMap(AccelerationStructures* as, const std::vector<glm::vec4>& pixels, uint32_t width, uint32_t height);
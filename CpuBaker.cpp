@@ -0,0 +1,1147 @@
+#include "CpuBaker.h"
+#include "Builder.h"
+#include "Parallel.h"
+#include "Rasterizer.h"
+#include "ShardBake.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+static const float PI = 3.14159265f;
+
+static float GetOmniAttenuation(float distance, float inv_range, float decay) {
+    float nd = distance * inv_range;
+    nd *= nd;
+    nd *= nd;
+    nd = glm::max(1.0f - nd, 0.0f);
+    nd *= nd;
+    return nd * glm::pow(glm::max(distance, 0.0001f), -decay);
+}
+
+static uint32_t ReverseBits(uint32_t bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return bits;
+}
+
+// Sobol序列的第二维, 与VdC组成(0,2)序列, 返回32位定点数
+static uint32_t Sobol2(uint32_t i) {
+    uint32_t r = 0;
+    for (uint32_t v = 1u << 31; i != 0; i >>= 1, v ^= v >> 1) {
+        if (i & 1u) {
+            r ^= v;
+        }
+    }
+    return r;
+}
+
+// 基于hash的Laine-Karras置换, 低位只影响更高的位, 作用在反转后的位上即为Owen置乱
+static uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed) {
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16u) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+    return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+static uint32_t PcgHash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// 收集光线, 环境光采样和路径延续各自使用不同的维度
+static const uint32_t SAMPLE_DIMENSION_GATHER = 0;
+static const uint32_t SAMPLE_DIMENSION_ENVIRONMENT = 1;
+// 路径延续的第depth个顶点使用PATH + 2 * (depth - 1)做RR, 下一维采样方向
+static const uint32_t SAMPLE_DIMENSION_PATH = 2;
+
+// 与bounce_light.comp一致, 无状态的Owen置乱Sobol(0,2)序列, 结果只取决于纹素, 样本序号和维度,
+// 与tile划分, 迭代次数, 线程数和分片无关. 每个纹素和维度使用不同的置乱和样本顺序, 相邻纹素的误差不相关,
+// 打乱顺序的置乱只在2的幂对齐的块内交换样本, 提前停止的自适应采样仍然是分层的
+static glm::vec2 GetSample(uint32_t texel_index, uint32_t sample_index, uint32_t dimension) {
+    uint32_t seed = PcgHash(PcgHash(texel_index) ^ (dimension * 0x9e3779b9u));
+    uint32_t index = NestedUniformScramble(sample_index, seed);
+    uint32_t x = NestedUniformScramble(ReverseBits(index), PcgHash(seed ^ 0xa511e9b3u));
+    uint32_t y = NestedUniformScramble(Sobol2(index), PcgHash(seed ^ 0x63d83595u));
+    // 只取高24位, 保证结果小于1
+    return glm::vec2(float(x >> 8u), float(y >> 8u)) * (1.0f / 16777216.0f);
+}
+
+static glm::vec3 GenerateHemisphereDirection(const glm::vec2& xi) {
+    float noise1 = xi.x;
+    float noise2 = xi.y * 2.0f * PI;
+    return glm::vec3(glm::sqrt(noise1) * glm::cos(noise2), glm::sqrt(noise1) * glm::sin(noise2), glm::sqrt(1.0f - noise1));
+}
+
+// pcg4d, 只用于阴影光线基准测试生成随机目标点
+static void Pcg4d(glm::uvec4& v) {
+    v = v * 1664525u + 1013904223u;
+    v.x += v.y * v.w; v.y += v.z * v.x; v.z += v.x * v.y; v.w += v.y * v.z;
+    v = v ^ (v >> 16u);
+    v.x += v.y * v.w; v.y += v.z * v.x; v.z += v.x * v.y; v.w += v.y * v.z;
+}
+
+static float Rand(glm::uvec4& seed) {
+    Pcg4d(seed);
+    return float(seed.x) / float(0xffffffffu);
+}
+
+static glm::vec3 CosineSampleHemisphere(float u1, float u2) {
+    float r = glm::sqrt(u1);
+    float phi = 2.0f * PI * u2;
+    float x = r * glm::cos(phi);
+    float y = r * glm::sin(phi);
+    float z = glm::sqrt(glm::max(0.0f, 1.0f - x * x - y * y));
+    return glm::vec3(x, y, z);
+}
+
+static float Luminance(const glm::vec3& color) {
+    return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// 与direct_light.comp中的EvaluateLight一致, 计算不考虑遮挡时的光照
+static bool EvaluateLight(const Light& light, const glm::vec3& position, const glm::vec3& normal, float bound_length, glm::vec3& light_pos, glm::vec3& light_dir, glm::vec3& radiance) {
+    float attenuation;
+    if (light.type == LIGHT_TYPE_DIRECTIONAL) {
+        light_pos = position - glm::vec3(light.direction_energy) * bound_length;
+        attenuation = 1.0f;
+    } else {
+        light_pos = light.position;
+        float d = glm::distance(position, light_pos);
+        if (d > light.range) {
+            return false;
+        }
+
+        attenuation = GetOmniAttenuation(d, 1.0f / light.range, light.attenuation);
+
+        if (light.type == LIGHT_TYPE_SPOT) {
+            glm::vec3 rel = glm::normalize(position - light_pos);
+            float cos_angle = glm::dot(rel, glm::vec3(light.direction_energy));
+            if (cos_angle < light.cos_spot_angle) {
+                return false;
+            }
+
+            float scos = glm::max(cos_angle, light.cos_spot_angle);
+            float spot_rim = glm::max(0.0001f, (1.0f - scos) / (1.0f - light.cos_spot_angle));
+            attenuation *= 1.0f - glm::pow(spot_rim, light.inv_spot_attenuation);
+        }
+    }
+
+    light_dir = glm::normalize(light_pos - position);
+    attenuation *= glm::max(0.0f, glm::dot(normal, light_dir));
+
+    if (attenuation <= 0.0001f) {
+        return false;
+    }
+
+    radiance = glm::vec3(light.color) * light.direction_energy.w * attenuation;
+    return true;
+}
+
+// 与bounce_light.comp中的环境光采样一致
+static glm::vec2 DirectionToEquirect(const glm::vec3& dir) {
+    float u = glm::atan(dir.z, dir.x) * (0.5f / PI) + 0.5f;
+    float v = glm::acos(glm::clamp(dir.y, -1.0f, 1.0f)) / PI;
+    return glm::vec2(u, v);
+}
+
+static glm::vec3 EquirectToDirection(const glm::vec2& uv) {
+    float phi = (uv.x - 0.5f) * 2.0f * PI;
+    float theta = uv.y * PI;
+    return glm::vec3(glm::sin(theta) * glm::cos(phi), glm::cos(theta), glm::sin(theta) * glm::sin(phi));
+}
+
+static uint32_t GetEnvironmentTexel(const EnvironmentInfo& info, const glm::vec2& uv) {
+    uint32_t x = glm::min(uint32_t(uv.x * float(info.width)), info.width - 1);
+    uint32_t y = glm::min(uint32_t(uv.y * float(info.height)), info.height - 1);
+    return y * info.width + x;
+}
+
+static glm::vec3 EnvironmentRadiance(const AccelerationStructures* as, const glm::vec3& dir) {
+    if (as->environment_info.width == 0) {
+        return glm::vec3(0.0f);
+    }
+    return as->environment_map[GetEnvironmentTexel(as->environment_info, DirectionToEquirect(dir))];
+}
+
+static float EnvironmentPdf(const AccelerationStructures* as, const glm::vec3& dir) {
+    const EnvironmentInfo& info = as->environment_info;
+    glm::vec2 uv = DirectionToEquirect(dir);
+    float sin_theta = glm::sin(uv.y * PI);
+    if (sin_theta <= 0.0f) {
+        return 0.0f;
+    }
+
+    uint32_t texel = GetEnvironmentTexel(info, uv);
+    float row = float(texel / info.width);
+    float f = Luminance(as->environment_map[texel]) * glm::sin(PI * (row + 0.5f) / float(info.height));
+    return f / (info.integral * 2.0f * PI * PI * sin_theta);
+}
+
+static uint32_t FindInterval(const float* cdf, uint32_t count, float u) {
+    return uint32_t(std::upper_bound(cdf + 1, cdf + count, u) - cdf) - 1;
+}
+
+static glm::vec3 SampleEnvironment(const AccelerationStructures* as, glm::vec2 u, float& pdf) {
+    uint32_t width = as->environment_info.width;
+    uint32_t height = as->environment_info.height;
+    const float* marginal = as->environment_cdf.data();
+    u = glm::min(u, glm::vec2(0.99999994f));
+
+    uint32_t y = FindInterval(marginal, height, u.y);
+    float dv = (u.y - marginal[y]) / glm::max(marginal[y + 1] - marginal[y], 1e-8f);
+
+    const float* conditional = marginal + height + 1 + y * (width + 1);
+    uint32_t x = FindInterval(conditional, width, u.x);
+    float du = (u.x - conditional[x]) / glm::max(conditional[x + 1] - conditional[x], 1e-8f);
+
+    glm::vec3 dir = EquirectToDirection(glm::vec2((float(x) + du) / float(width), (float(y) + dv) / float(height)));
+    pdf = EnvironmentPdf(as, dir);
+    return dir;
+}
+
+// 与linear_sampler一致的双线性采样, fetch按纹素索引读取颜色
+template<typename Fetch>
+static glm::vec3 SampleBilinear(uint32_t width, uint32_t height, const glm::vec2& uv, const Fetch& fetch) {
+    glm::vec2 p = uv * glm::vec2(width, height) - 0.5f;
+    glm::vec2 f = p - glm::floor(p);
+    int x0 = glm::clamp(int(glm::floor(p.x)), 0, int(width) - 1);
+    int y0 = glm::clamp(int(glm::floor(p.y)), 0, int(height) - 1);
+    int x1 = glm::min(x0 + 1, int(width) - 1);
+    int y1 = glm::min(y0 + 1, int(height) - 1);
+    glm::vec3 c00 = fetch(y0 * width + x0);
+    glm::vec3 c10 = fetch(y0 * width + x1);
+    glm::vec3 c01 = fetch(y1 * width + x0);
+    glm::vec3 c11 = fetch(y1 * width + x1);
+    return glm::mix(glm::mix(c00, c10, f.x), glm::mix(c01, c11, f.x), f.y);
+}
+
+static glm::mat3 GetNormalMatrix(const glm::vec3& normal) {
+    glm::vec3 v0 = glm::abs(normal.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 tangent = glm::normalize(glm::cross(v0, normal));
+    glm::vec3 bitangent = glm::normalize(glm::cross(tangent, normal));
+    return glm::mat3(tangent, bitangent, normal);
+}
+
+CpuBaker::CpuBaker(const AccelerationStructures* as, const std::vector<Light>& lights, const CpuBakeParams& params)
+    : as(as), lights(lights), params(params), tracer(as, params.bias) {
+    uint32_t texel_count = params.width * params.height;
+    position_data.resize(texel_count, glm::vec4(0.0f));
+    normal_data.resize(texel_count, glm::vec4(0.0f));
+    unocclude_data.resize(texel_count, glm::vec4(0.0f));
+    source_light.Resize(params.light_format, texel_count);
+    dest_light.Resize(params.light_format, texel_count);
+    sh_light_map.resize(texel_count * 4, glm::vec4(0.0f));
+    light_variance.resize(texel_count, 0.0f);
+
+    if (!this->params.light_groups.empty() && this->params.light_groups.size() != lights.size()) {
+        printf("cpu bake light groups ignored, expected %u entries but got %u\n", (uint32_t)lights.size(), (uint32_t)this->params.light_groups.size());
+        this->params.light_groups.clear();
+    }
+    if (!this->params.light_groups.empty() && !this->params.cache_path.empty()) {
+        // 缓存只保存合并后的光照, 无法恢复每组的结果
+        printf("cpu bake cache is not supported with light groups\n");
+        this->params.cache_path.clear();
+    }
+    if (!this->params.light_groups.empty() && this->params.error_threshold > 0.0f) {
+        // 各组的提前终止不同, 合并后与不分组的结果不一致, 分组烘焙时每组都迭代到ray_iterations
+        printf("cpu bake adaptive sampling is disabled with light groups\n");
+        this->params.error_threshold = 0.0f;
+    }
+}
+
+void CpuBaker::Bake() {
+    // 只有需要写报告时才开启遍历计数, 避免额外的原子操作
+    bool collect_stats = !params.stats_report.empty();
+    BakeStats* stats_ptr = collect_stats ? &stats : nullptr;
+    tracer.SetStatsEnabled(collect_stats);
+    tracer.ResetCounters();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        ScopedTimer timer("cpu bake", "raster", stats_ptr);
+        RasterizeGBuffer();
+    }
+    {
+        ScopedTimer timer("cpu bake", "compact", stats_ptr);
+        BuildTexelWorkList();
+    }
+    printf("cpu bake texel work list: %u of %u texels (%.1f%%)\n", (uint32_t)texels.size(), params.width * params.height, 100.0f * texels.size() / float(params.width * params.height));
+    if (!params.cache_path.empty()) {
+        ScopedTimer timer("cpu bake", "cache_load", stats_ptr);
+        LoadCache();
+    }
+    {
+        ScopedTimer timer("cpu bake", "unocclude", stats_ptr);
+        Unocclude();
+    }
+    if (params.light_groups.empty()) {
+        {
+            ScopedTimer timer("cpu bake", "direct", stats_ptr);
+            DirectLight();
+            if (!params.cache_path.empty()) {
+                source_light.Decode(bake_cache.direct_light);
+            }
+        }
+        {
+            ScopedTimer timer("cpu bake", "bounce", stats_ptr);
+            BounceLight();
+        }
+        if (!params.cache_path.empty()) {
+            // 缓存降噪和扩展之前的结果, 下一次增量烘焙在此基础上更新
+            ScopedTimer timer("cpu bake", "cache_save", stats_ptr);
+            bake_cache.sh_light_map = sh_light_map;
+            bake_cache.light_variance = light_variance;
+            SaveBakeCache(params.cache_path, bake_cache);
+        }
+        if (params.denoise.iterations > 0) {
+            ScopedTimer timer("cpu bake", "denoise", stats_ptr);
+            Denoise();
+        }
+        if (params.dilate_radius > 0) {
+            ScopedTimer timer("cpu bake", "dilate", stats_ptr);
+            Dilate();
+        }
+    } else {
+        ScopedTimer timer("cpu bake", "light_groups", stats_ptr);
+        BakeLightGroups();
+    }
+    if (!params.output_path.empty()) {
+        ScopedTimer timer("cpu bake", "export", stats_ptr);
+        ExportOutput(collect_stats);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    if (collect_stats) {
+        TraceCounters counters = tracer.GetCounters();
+        stats.AddTiming("total", elapsed.count() * 1000.0);
+        stats.AddCounter("texels", texels.size());
+        stats.AddTraceCounters("", counters);
+        stats.AddValue("rays_per_second", counters.rays / elapsed.count());
+        stats.AddValue("cells_per_ray", counters.cells_visited / std::max(1.0, double(counters.rays)));
+        stats.AddValue("triangle_tests_per_ray", counters.triangle_tests / std::max(1.0, double(counters.rays)));
+        AddFormatStats();
+        stats.WriteJson(params.stats_report);
+        tracer.SetStatsEnabled(false);
+    }
+}
+
+void CpuBaker::BakeLightGroups() {
+    uint32_t group_count = GetLightGroupCount();
+    uint32_t texel_count = params.width * params.height;
+    group_sh_light_map.resize(group_count);
+    group_light.resize(group_count);
+    group_light_variance.resize(group_count);
+    for (uint32_t group = 0; group < group_count; ++group) {
+        // 光照对光源强度是线性的, 每组单独计算直接光照和弹射, 各组使用相同的随机序列
+        active_group = group;
+        source_light.Resize(params.light_format, texel_count);
+        dest_light.Resize(params.light_format, texel_count);
+        std::fill(sh_light_map.begin(), sh_light_map.end(), glm::vec4(0.0f));
+        std::fill(light_variance.begin(), light_variance.end(), 0.0f);
+
+        // 降噪和扩展不是线性的, 在Relight中对合并后的结果执行一次
+        DirectLight();
+        BounceLight();
+
+        group_sh_light_map[group] = sh_light_map;
+        group_light_variance[group] = light_variance;
+        dest_light.Decode(group_light[group]);
+    }
+    active_group = ALL_LIGHT_GROUPS;
+
+    Relight(std::vector<glm::vec3>(group_count, glm::vec3(1.0f)));
+}
+
+// 各组的结果按权重相加, alpha在各组中相同, 取第0组的值
+static void ComposeLightGroups(const std::vector<std::vector<glm::vec4>>& groups, const std::vector<glm::vec3>& weights, std::vector<glm::vec4>& result) {
+    result.resize(groups[0].size());
+    ParallelFor(result.size(), 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            glm::vec3 sum = glm::vec3(0.0f);
+            for (uint32_t group = 0; group < groups.size(); ++group) {
+                sum += glm::vec3(groups[group][i]) * weights[group];
+            }
+            result[i] = glm::vec4(sum, groups[0][i].w);
+        }
+    });
+}
+
+void CpuBaker::Relight(const std::vector<glm::vec3>& group_weights) {
+    if (group_sh_light_map.empty() || group_weights.size() != group_sh_light_map.size()) {
+        printf("cpu bake relight expects %u group weights\n", (uint32_t)group_sh_light_map.size());
+        return;
+    }
+
+    ComposeLightGroups(group_sh_light_map, group_weights, sh_light_map);
+    std::vector<glm::vec4> light;
+    ComposeLightGroups(group_light, group_weights, light);
+    dest_light.Encode(params.light_format, light);
+
+    // 各组的噪声只在共同照亮的区域相关, 按不相关估计合并后的方差, 供降噪使用
+    ParallelFor(light_variance.size(), 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            float variance = 0.0f;
+            for (uint32_t group = 0; group < group_weights.size(); ++group) {
+                float weight = glm::dot(group_weights[group], glm::vec3(0.2126f, 0.7152f, 0.0722f));
+                variance += weight * weight * group_light_variance[group][i];
+            }
+            light_variance[i] = variance;
+        }
+    });
+    if (params.denoise.iterations > 0) {
+        Denoise();
+    }
+    if (params.dilate_radius > 0) {
+        Dilate();
+    }
+}
+
+uint32_t CpuBaker::GetLightGroupCount() const {
+    if (params.light_groups.empty()) {
+        return 0;
+    }
+    return *std::max_element(params.light_groups.begin(), params.light_groups.end()) + 2;
+}
+
+bool CpuBaker::IsLightActive(uint32_t light_index) const {
+    return active_group == ALL_LIGHT_GROUPS || params.light_groups[light_index] == active_group;
+}
+
+bool CpuBaker::IsStaticLightActive() const {
+    return active_group == ALL_LIGHT_GROUPS || active_group + 1 == GetLightGroupCount();
+}
+
+void CpuBaker::PrepareShardGBuffer() {
+    BakeStats* stats_ptr = params.stats_report.empty() ? nullptr : &stats;
+    {
+        ScopedTimer timer("cpu bake", "raster", stats_ptr);
+        RasterizeGBuffer();
+    }
+    {
+        ScopedTimer timer("cpu bake", "compact", stats_ptr);
+        BuildTexelWorkList();
+    }
+    {
+        ScopedTimer timer("cpu bake", "unocclude", stats_ptr);
+        Unocclude();
+    }
+}
+
+void CpuBaker::BakeShardPass(uint32_t pass, const ShardGBuffer& gbuffer, const ShardBakeState& state, ShardPassResult& result) {
+    // 纹素的unocclude只与自身有关, 协调进程计算一次后每个worker只取出分给自己的tile
+    normal_data = gbuffer.normal_data;
+    texels.clear();
+    for (const TexelData& texel : gbuffer.texels) {
+        if (GetShardTileOwner(texel.atlas_x, texel.atlas_y, params.width, params.shard_tile_size, params.shard_count) == params.shard_index) {
+            texels.push_back(texel);
+        }
+    }
+
+    // SH和方差在上一个pass的基础上继续累加, 与单进程烘焙的累加顺序一致, 合并后的结果逐位相同
+    sh_light_map = state.sh_light_map;
+    light_variance = state.light_variance;
+    if (pass == 0) {
+        DirectLight();
+    } else {
+        source_light.Encode(params.light_format, state.light);
+        result.rays_cast = BouncePass(pass - 1);
+        printf("cpu bake shard %u pass %u: %llu bounce rays\n", params.shard_index, pass, (unsigned long long)result.rays_cast);
+    }
+
+    const PackedLightmap& light = pass == 0 ? source_light : dest_light;
+    uint32_t layer_size = params.width * params.height;
+    result.texel_indices.resize(texels.size());
+    result.light.resize(texels.size());
+    result.sh_light_map.resize(texels.size() * 4);
+    result.light_variance.resize(texels.size());
+    for (uint32_t t = 0; t < texels.size(); ++t) {
+        uint32_t idx = texels[t].atlas_y * params.width + texels[t].atlas_x;
+        result.texel_indices[t] = idx;
+        result.light[t] = light.Load(idx);
+        for (uint32_t j = 0; j < 4; ++j) {
+            result.sh_light_map[t * 4 + j] = sh_light_map[j * layer_size + idx];
+        }
+        result.light_variance[t] = light_variance[idx];
+    }
+}
+
+void CpuBaker::FinishShardedBake(const ShardBakeState& state) {
+    bool collect_stats = !params.stats_report.empty();
+    BakeStats* stats_ptr = collect_stats ? &stats : nullptr;
+    sh_light_map = state.sh_light_map;
+    light_variance = state.light_variance;
+    // 与单进程烘焙一致, 没有弹射时dest_light保持为0
+    if (params.bounces > 0 || params.path_continuation) {
+        dest_light.Encode(params.light_format, state.light);
+    }
+    if (params.denoise.iterations > 0) {
+        ScopedTimer timer("cpu bake", "denoise", stats_ptr);
+        Denoise();
+    }
+    if (params.dilate_radius > 0) {
+        ScopedTimer timer("cpu bake", "dilate", stats_ptr);
+        Dilate();
+    }
+    if (!params.output_path.empty()) {
+        ScopedTimer timer("cpu bake", "export", stats_ptr);
+        ExportOutput(collect_stats);
+    }
+    if (collect_stats) {
+        AddFormatStats();
+    }
+}
+
+void CpuBaker::RasterizeGBuffer() {
+    ::RasterizeGBuffer(as, params.width, params.height, GBUFFER_DILATION, position_data, normal_data, unocclude_data);
+}
+
+void CpuBaker::BuildTexelWorkList() {
+    texels.clear();
+    for (uint32_t y = 0; y < params.height; ++y) {
+        for (uint32_t x = 0; x < params.width; ++x) {
+            uint32_t idx = y * params.width + x;
+            if (position_data[idx].a < 0.5f || glm::length(glm::vec3(normal_data[idx])) < 0.5f) {
+                continue;
+            }
+
+            TexelData texel;
+            texel.position = position_data[idx];
+            texel.atlas_x = x;
+            texel.normal = normal_data[idx];
+            texel.atlas_y = y;
+            texels.push_back(texel);
+        }
+    }
+}
+
+uint64_t CpuBaker::GetSettingsHash() const {
+    uint64_t hash = HashBytes(&params.width, sizeof(params.width));
+    hash = HashBytes(&params.height, sizeof(params.height), hash);
+    hash = HashBytes(&params.ray_count, sizeof(params.ray_count), hash);
+    hash = HashBytes(&params.bounces, sizeof(params.bounces), hash);
+    hash = HashBytes(&params.path_continuation, sizeof(params.path_continuation), hash);
+    hash = HashBytes(&params.max_light_samples, sizeof(params.max_light_samples), hash);
+    hash = HashBytes(&params.emissive_light_samples, sizeof(params.emissive_light_samples), hash);
+    hash = HashBytes(&params.ray_iterations, sizeof(params.ray_iterations), hash);
+    hash = HashBytes(&params.min_iterations, sizeof(params.min_iterations), hash);
+    hash = HashBytes(&params.error_threshold, sizeof(params.error_threshold), hash);
+    hash = HashBytes(&params.bias, sizeof(params.bias), hash);
+    hash = HashBytes(&params.light_format, sizeof(params.light_format), hash);
+
+    // atlas布局变化后纹素和表面的对应关系全部改变
+    for (const Triangle& triangle : as->triangles) {
+        for (uint32_t j = 0; j < 3; ++j) {
+            hash = HashBytes(&as->vertices[triangle.indices[j]].uv1, sizeof(glm::vec2), hash);
+        }
+    }
+
+    hash = HashBytes(&as->environment_info, sizeof(EnvironmentInfo), hash);
+    if (!as->environment_map.empty()) {
+        hash = HashBytes(as->environment_map.data(), as->environment_map.size() * sizeof(glm::vec4), hash);
+    }
+    return hash;
+}
+
+void CpuBaker::LoadCache() {
+    uint32_t bounce_passes = params.path_continuation ? 1 : params.bounces;
+    bake_cache.settings_hash = GetSettingsHash();
+    bake_cache.width = params.width;
+    bake_cache.height = params.height;
+    bake_cache.bounce_light.resize(bounce_passes);
+    CaptureBakeScene(as, lights, normal_data, bake_cache);
+
+    BakeCache previous;
+    std::vector<uint8_t> affected;
+    if (!LoadBakeCache(params.cache_path, previous) ||
+        !GetAffectedTexels(as, previous, bake_cache, params.cache_influence_radius, texels, normal_data, affected)) {
+        printf("cpu bake cache: full bake\n");
+        return;
+    }
+
+    // 光照数据会直接替换当前的数组, 大小与atlas不一致的缓存不能使用
+    uint32_t layer_size = params.width * params.height;
+    bool sizes_valid = previous.direct_light.size() == layer_size && previous.sh_light_map.size() == size_t(layer_size) * 4 &&
+                       previous.light_variance.size() == layer_size && previous.bounce_light.size() == bounce_passes;
+    for (const std::vector<glm::vec4>& bounce : previous.bounce_light) {
+        sizes_valid = sizes_valid && bounce.size() == layer_size;
+    }
+    if (!sizes_valid) {
+        printf("ignore invalid bake cache %s\n", params.cache_path.c_str());
+        printf("cpu bake cache: full bake\n");
+        return;
+    }
+
+    // 未受影响的纹素直接使用上一次的结果, 受影响的纹素重新追踪时覆盖直接光照和SH, 方差重新累加
+    source_light.Encode(params.light_format, previous.direct_light);
+    sh_light_map.swap(previous.sh_light_map);
+    light_variance.swap(previous.light_variance);
+    cached_bounce_light.swap(previous.bounce_light);
+
+    uint32_t texel_count = texels.size();
+    uint32_t affected_count = 0;
+    for (uint32_t t = 0; t < texel_count; ++t) {
+        if (!affected[t]) {
+            continue;
+        }
+        light_variance[texels[t].atlas_y * params.width + texels[t].atlas_x] = 0.0f;
+        texels[affected_count++] = texels[t];
+    }
+    texels.resize(affected_count);
+    printf("cpu bake cache: retracing %u of %u texels (%.1f%%)\n", affected_count, texel_count, texel_count > 0 ? 100.0f * affected_count / float(texel_count) : 0.0f);
+}
+
+void CpuBaker::Unocclude() {
+    ParallelFor(texels.size(), 256, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; ++t) {
+            TexelData& texel = texels[t];
+            glm::vec4 normal_tsize = unocclude_data[texel.atlas_y * params.width + texel.atlas_x];
+            glm::vec3 face_normal = normal_tsize;
+            float texel_size = normal_tsize.w;
+
+            glm::mat3 normal_mat = GetNormalMatrix(face_normal);
+            glm::vec3 base_pos = texel.position + face_normal * params.bias;
+
+            glm::vec3 rays[4] = {normal_mat[0], normal_mat[1], -normal_mat[0], -normal_mat[1]};
+            float min_d = 1e20f;
+            for (int i = 0; i < 4; i++) {
+                glm::vec3 ray_to = base_pos + rays[i] * texel_size;
+                Interaction isect;
+                if (tracer.TraceRay(base_pos, ray_to, isect) == RAY_BACK) {
+                    if (isect.hit_dist < min_d) {
+                        texel.position = base_pos + rays[i] * isect.hit_dist + isect.normal * params.bias * 10.0f;
+                        min_d = isect.hit_dist;
+                    }
+                }
+            }
+        }
+    });
+}
+
+void CpuBaker::DirectLight() {
+    float bound_length = glm::length(tracer.GetBoundSize());
+    int cell_scale = MAX_GRID_SIZE / LIGHT_GRID_SIZE;
+    glm::vec3 to_cell_size = (1.0f / tracer.GetBoundSize()) * float(MAX_GRID_SIZE);
+    ParallelFor(texels.size(), 256, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; ++t) {
+            const TexelData& texel = texels[t];
+            glm::vec3 position = texel.position;
+            glm::vec3 normal = texel.normal;
+
+            glm::vec4 sh_accum[4] = {
+                    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+            };
+
+            glm::vec3 static_light = glm::vec3(0.0f);
+            auto add_light = [&](const glm::vec3& radiance, const glm::vec3& light_dir) {
+                float c[4] = {
+                        0.282095f,
+                        0.488603f * light_dir.y,
+                        0.488603f * light_dir.z,
+                        0.488603f * light_dir.x
+                };
+
+                for (uint32_t j = 0; j < 4; j++) {
+                    sh_accum[j] += glm::vec4(radiance * c[j] * (1.0f / 3.0f), 0.0f);
+                }
+
+                static_light += radiance;
+            };
+
+            glm::ivec3 light_cell = glm::ivec3((position - as->bounds.min) * to_cell_size) / cell_scale;
+            light_cell = glm::clamp(light_cell, glm::ivec3(0), glm::ivec3(LIGHT_GRID_SIZE - 1));
+            uint32_t cell = light_cell.x + (light_cell.y * LIGHT_GRID_SIZE) + (light_cell.z * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE);
+            uint32_t cell_light_count = as->light_grid[cell * 2];
+            const uint32_t* cell_lights = as->light_indices.data() + as->light_grid[cell * 2 + 1];
+
+            glm::vec3 light_pos;
+            glm::vec3 light_dir;
+            glm::vec3 radiance;
+            if (cell_light_count <= params.max_light_samples) {
+                for (uint32_t i = 0; i < cell_light_count; i++) {
+                    if (!IsLightActive(cell_lights[i]) || !EvaluateLight(lights[cell_lights[i]], position, normal, bound_length, light_pos, light_dir, radiance)) {
+                        continue;
+                    }
+
+                    if (tracer.TraceShadowRay(position + light_dir * params.bias, light_pos) == RAY_MISS) {
+                        add_light(radiance, light_dir);
+                    }
+                }
+            } else {
+                // 与direct_light.comp一致的分层重要性采样
+                float total_weight = 0.0f;
+                for (uint32_t i = 0; i < cell_light_count; i++) {
+                    if (IsLightActive(cell_lights[i]) && EvaluateLight(lights[cell_lights[i]], position, normal, bound_length, light_pos, light_dir, radiance)) {
+                        total_weight += Luminance(radiance);
+                    }
+                }
+
+                if (total_weight > 0.0f) {
+                    float sample_step = total_weight / float(params.max_light_samples);
+                    float threshold = float(PcgHash(texel.atlas_x + texel.atlas_y * params.width)) / float(0xffffffffu) * sample_step;
+                    float cumulative = 0.0f;
+                    for (uint32_t i = 0; i < cell_light_count && threshold < total_weight; i++) {
+                        if (!IsLightActive(cell_lights[i]) || !EvaluateLight(lights[cell_lights[i]], position, normal, bound_length, light_pos, light_dir, radiance)) {
+                            continue;
+                        }
+
+                        float weight = Luminance(radiance);
+                        cumulative += weight;
+                        uint32_t picks = 0;
+                        while (threshold < cumulative) {
+                            threshold += sample_step;
+                            picks++;
+                        }
+
+                        if (picks > 0 && tracer.TraceShadowRay(position + light_dir * params.bias, light_pos) == RAY_MISS) {
+                            add_light(radiance * (float(picks) * sample_step / weight), light_dir);
+                        }
+                    }
+                }
+            }
+
+            // 自发光三角形, 与direct_light.comp一致按alias表采样, 分组烘焙时与环境光一起属于最后一组
+            bool static_light_active = IsStaticLightActive();
+            uint32_t emissive_light_count = static_light_active ? as->emissive_lights.size() : 0;
+            uint32_t seed = PcgHash(texel.atlas_x + texel.atlas_y * params.width) ^ 0x9e3779b9u;
+            auto random_float = [&seed]() {
+                seed = PcgHash(seed);
+                return float(seed) / float(0xffffffffu);
+            };
+            for (uint32_t s = 0; emissive_light_count > 0 && s < params.emissive_light_samples; s++) {
+                uint32_t index = glm::min(uint32_t(random_float() * float(emissive_light_count)), emissive_light_count - 1);
+                if (random_float() >= as->emissive_lights[index].alias_prob) {
+                    index = as->emissive_lights[index].alias;
+                }
+                const EmissiveLight& emissive_light = as->emissive_lights[index];
+
+                const Triangle& triangle = as->triangles[emissive_light.triangle_index];
+                float su = glm::sqrt(random_float());
+                float v = random_float();
+                light_pos = glm::vec3(as->vertices[triangle.indices[0]].position) * (1.0f - su) +
+                            glm::vec3(as->vertices[triangle.indices[1]].position) * (su * (1.0f - v)) +
+                            glm::vec3(as->vertices[triangle.indices[2]].position) * (su * v);
+
+                glm::vec3 rel = light_pos - position;
+                float dist2 = glm::dot(rel, rel);
+                light_dir = rel / glm::sqrt(dist2);
+                float cos_receiver = glm::dot(normal, light_dir);
+                float cos_emitter = glm::dot(emissive_light.normal, -light_dir);
+                if (cos_receiver <= 0.0f || cos_emitter <= 0.0f) {
+                    continue;
+                }
+
+                float pdf = emissive_light.pdf / emissive_light.area;
+                radiance = emissive_light.radiance * (cos_receiver * cos_emitter / (PI * dist2 * pdf * float(params.emissive_light_samples)));
+                if (tracer.TraceShadowRay(position + light_dir * params.bias, light_pos - light_dir * params.bias) == RAY_MISS) {
+                    add_light(radiance, light_dir);
+                }
+            }
+
+            uint32_t idx = texel.atlas_y * params.width + texel.atlas_x;
+
+            // 自身的自发光只写入SH, 不参与弹射
+            glm::vec3 emissive = as->triangle_materials[uint32_t(normal_data[idx].w)].emissive;
+            glm::vec3 lit_light = static_light;
+            if (static_light_active && emissive != glm::vec3(0.0f)) {
+                add_light(emissive * PI, normal);
+            }
+
+            static_light = lit_light * glm::vec3(as->albedo_atlas[idx]);
+
+            uint32_t layer_size = params.width * params.height;
+            source_light.Store(idx, glm::vec4(static_light, 1.0f));
+            for (uint32_t j = 0; j < 4; j++) {
+                sh_light_map[j * layer_size + idx] = sh_accum[j];
+            }
+        }
+    });
+}
+
+void CpuBaker::Denoise() {
+    DenoiseLightmap(as, params.width, params.height, params.denoise, position_data, normal_data, light_variance, sh_light_map);
+}
+
+void CpuBaker::Dilate() {
+    DilateLightmap(params.width, params.height, 4, params.dilate_radius, sh_light_map);
+}
+
+void CpuBaker::ExportOutput(bool collect_stats) {
+    // 导出的层依次为光照和4层SH, first_layer是文件中第一层在其中的序号
+    struct ExportFile {
+        std::string path;
+        LightmapExportDesc desc;
+        uint32_t first_layer;
+        LightmapWriter* writer;
+    };
+    const char* LAYER_NAMES[5] = {"irradiance", "sh0", "sh1", "sh2", "sh3"};
+    LightmapExportDesc desc = params.output_desc;
+    desc.width = params.width;
+    desc.height = params.height;
+
+    // 一个BC6H纹理数组只能是一种格式, 非负的光照和L0用UF16, 有负数的L1层另外写成SF16
+    std::vector<ExportFile> files;
+    if (desc.bc6h) {
+        files.push_back({params.output_path, desc, 0, nullptr});
+        files.back().desc.layer_names.assign(LAYER_NAMES, LAYER_NAMES + 2);
+        files.push_back({GetLightmapL1Path(params.output_path), desc, 2, nullptr});
+        files.back().desc.layer_names.assign(LAYER_NAMES + 2, LAYER_NAMES + 5);
+        files.back().desc.bc6h_signed = true;
+    } else {
+        files.push_back({params.output_path, desc, 0, nullptr});
+        files.back().desc.layer_names.assign(LAYER_NAMES, LAYER_NAMES + 5);
+    }
+    bool result = true;
+    for (ExportFile& file : files) {
+        file.writer = CreateLightmapWriter(file.path, file.desc);
+        result = result && file.writer;
+    }
+
+    // 每次写出一个BC6H块行, 只有打包存储的光照需要解码到临时行中
+    uint32_t layer_size = params.width * params.height;
+    std::vector<glm::vec4> light_rows(params.width * 4);
+    for (uint32_t y = 0; y < params.height && result; y += 4) {
+        uint32_t row_count = std::min(4u, params.height - y);
+        for (uint32_t i = 0; i < params.width * row_count; ++i) {
+            light_rows[i] = dest_light.Load(y * params.width + i);
+        }
+        const glm::vec4* layers[5] = {light_rows.data()};
+        for (uint32_t j = 0; j < 4; ++j) {
+            layers[j + 1] = &sh_light_map[j * layer_size + y * params.width];
+        }
+        for (ExportFile& file : files) {
+            result = result && file.writer->WriteRows(y, row_count, layers + file.first_layer);
+        }
+    }
+
+    for (ExportFile& file : files) {
+        if (!file.writer) {
+            continue;
+        }
+        if (!file.writer->Close() || !result) {
+            printf("cpu bake export to %s failed\n", file.path.c_str());
+        }
+        const std::vector<double>& psnr = file.writer->GetLayerPSNR();
+        for (size_t i = 0; i < psnr.size(); ++i) {
+            const std::string& name = file.desc.layer_names[i];
+            // 无损或整层为0时psnr为无穷大
+            if (std::isfinite(psnr[i])) {
+                printf("cpu bake bc6h %s: %.2f dB psnr\n", name.c_str(), psnr[i]);
+            } else {
+                printf("cpu bake bc6h %s: lossless\n", name.c_str());
+            }
+            if (collect_stats) {
+                stats.AddValue("bc6h." + name + ".psnr", psnr[i]);
+            }
+        }
+        SAFE_DELETE(file.writer);
+    }
+}
+
+void CpuBaker::AddFormatStats() {
+    // 最终光照和SH数据转换到各存储格式后相对全精度数据的误差, 以及占用的字节数
+    // SH是全精度的running sum, 光照以烘焙时使用的light_format解码后的数据为基准
+    std::vector<glm::vec4> light_data;
+    dest_light.Decode(light_data);
+    stats.AddCounter("format.light.bytes", dest_light.GetDataSize());
+    for (uint32_t i = 0; i < LIGHTMAP_FORMAT_COUNT; ++i) {
+        LightmapFormat format = (LightmapFormat)i;
+        std::string prefix = std::string("format.") + GetLightmapFormatName(format);
+        std::pair<const char*, const std::vector<glm::vec4>*> sources[] = {{"light", &light_data}, {"sh", &sh_light_map}};
+        for (const auto& source : sources) {
+            std::string name = prefix + "." + source.first;
+            LightmapFormatError error = MeasureLightmapFormatError(*source.second, format);
+            stats.AddCounter(name + ".bytes", uint64_t(source.second->size()) * GetLightmapFormatSize(format));
+            stats.AddValue(name + ".max_abs_error", error.max_abs_error);
+            stats.AddValue(name + ".mean_abs_error", error.mean_abs_error);
+            stats.AddValue(name + ".max_rel_error", error.max_rel_error);
+            stats.AddValue(name + ".mean_rel_error", error.mean_rel_error);
+            stats.AddValue(name + ".rmse", error.rmse);
+        }
+    }
+}
+
+void CpuBaker::BounceLight() {
+    uint32_t ray_iterations = glm::max(1u, params.ray_iterations);
+    uint32_t ray_count_per_iteration = params.ray_count / ray_iterations;
+    uint32_t bounce_passes = params.path_continuation ? 1 : params.bounces;
+    uint64_t rays_cast = 0;
+    for (uint32_t bounce = 0; bounce < bounce_passes; ++bounce) {
+        if (bounce > 0) {
+            std::swap(source_light, dest_light);
+        }
+        if (!cached_bounce_light.empty()) {
+            dest_light.Encode(params.light_format, cached_bounce_light[bounce]);
+        }
+
+        rays_cast += BouncePass(bounce);
+
+        if (!params.cache_path.empty()) {
+            dest_light.Decode(bake_cache.bounce_light[bounce]);
+        }
+    }
+
+    uint64_t uniform_rays = uint64_t(texels.size()) * ray_count_per_iteration * ray_iterations * bounce_passes;
+    printf("cpu bake bounce rays: %llu of %llu (%.1f%% saved)\n", (unsigned long long)rays_cast, (unsigned long long)uniform_rays,
+           uniform_rays > 0 ? 100.0 * (1.0 - double(rays_cast) / double(uniform_rays)) : 0.0);
+}
+
+uint64_t CpuBaker::BouncePass(uint32_t bounce) {
+    float bound_length = glm::length(tracer.GetBoundSize());
+    uint32_t layer_size = params.width * params.height;
+    uint32_t ray_iterations = glm::max(1u, params.ray_iterations);
+    uint32_t ray_count_per_iteration = params.ray_count / ray_iterations;
+    std::atomic<uint64_t> rays_cast(0);
+    float bsdf_count = float(ray_count_per_iteration);
+    float environment_count = float(as->environment_info.sample_count);
+    // 不采样环境光的分组中未命中的光线仍然计数, 保证各组的结果相加等于整体结果
+    bool has_environment = bounce == 0 && as->environment_info.width > 0;
+    bool sample_environment = has_environment && IsStaticLightActive();
+
+    ParallelFor(texels.size(), 16, [&](uint32_t begin, uint32_t end) {
+        uint64_t local_rays = 0;
+        for (uint32_t t = begin; t < end; ++t) {
+            const TexelData& texel = texels[t];
+            glm::vec3 normal = texel.normal;
+            glm::vec3 position = texel.position;
+            position += glm::sign(normal) * glm::abs(position * 0.0002f);
+            glm::mat3 normal_mat = GetNormalMatrix(normal);
+
+            uint32_t idx = texel.atlas_y * params.width + texel.atlas_x;
+            glm::vec3 light_total = glm::vec3(0.0f);
+            glm::vec3 sh_accum[4] = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+            float active_rays = 0.0f;
+            float lum_square_sum = 0.0f;
+            float texel_rays = 0.0f;
+
+            for (uint32_t iteration = 0; iteration < ray_iterations; ++iteration) {
+                glm::vec3 ray_from = position + normal * params.bias;
+                for (uint32_t i = 0; i < ray_count_per_iteration; i++) {
+                    uint32_t sample_index = i + ray_count_per_iteration * iteration;
+                    glm::vec3 ray_dir = normal_mat * GenerateHemisphereDirection(GetSample(idx, sample_index, SAMPLE_DIMENSION_GATHER));
+                    Interaction isect;
+                    uint32_t trace_result = tracer.TraceRay(ray_from, ray_from + ray_dir * bound_length, isect);
+                    glm::vec3 light;
+                    if (trace_result == RAY_FRONT) {
+                        light = SampleSourceLight(isect);
+                        if (bounce > 0) {
+                            light *= SampleAlbedo(isect);
+                        }
+                        if (params.path_continuation) {
+                            light += PathTrace(isect, idx, sample_index);
+                        }
+                    } else if (trace_result == RAY_MISS && sample_environment) {
+                        float bsdf_pdf = glm::dot(ray_dir, normal) / PI;
+                        float light_pdf = EnvironmentPdf(as, ray_dir);
+                        light = EnvironmentRadiance(as, ray_dir) * (bsdf_count * bsdf_pdf / (bsdf_count * bsdf_pdf + environment_count * light_pdf));
+                    } else if (trace_result == RAY_MISS && has_environment) {
+                        light = glm::vec3(0.0f);
+                    } else {
+                        continue;
+                    }
+                    active_rays += 1.0f;
+                    light_total += light;
+
+                    float lum = glm::dot(light, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+                    lum_square_sum += lum * lum;
+
+                    float c[4] = {
+                            0.282095f,
+                            0.488603f * ray_dir.y,
+                            0.488603f * ray_dir.z,
+                            0.488603f * ray_dir.x
+                    };
+
+                    for (uint32_t j = 0; j < 4; j++) {
+                        sh_accum[j] += light * c[j];
+                    }
+                }
+
+                // 环境光重要性采样, 与收集光线按balance heuristic合并
+                for (uint32_t i = 0; sample_environment && i < as->environment_info.sample_count; i++) {
+                    float light_pdf;
+                    glm::vec2 xi = GetSample(idx, i + as->environment_info.sample_count * iteration, SAMPLE_DIMENSION_ENVIRONMENT);
+                    glm::vec3 env_dir = SampleEnvironment(as, xi, light_pdf);
+                    float cos_theta = glm::dot(env_dir, normal);
+                    if (cos_theta <= 0.0f || light_pdf <= 0.0f) {
+                        continue;
+                    }
+
+                    if (tracer.TraceShadowRay(ray_from, ray_from + env_dir * bound_length) != RAY_MISS) {
+                        continue;
+                    }
+
+                    float bsdf_pdf = cos_theta / PI;
+                    float weight = environment_count * light_pdf / (environment_count * light_pdf + bsdf_count * bsdf_pdf);
+                    glm::vec3 light = EnvironmentRadiance(as, env_dir) * (weight * bsdf_pdf / light_pdf * bsdf_count / environment_count);
+                    light_total += light;
+
+                    float c[4] = {
+                            0.282095f,
+                            0.488603f * env_dir.y,
+                            0.488603f * env_dir.z,
+                            0.488603f * env_dir.x
+                    };
+
+                    for (uint32_t j = 0; j < 4; j++) {
+                        sh_accum[j] += light * c[j];
+                    }
+                }
+                texel_rays += float(ray_count_per_iteration);
+
+                if (params.error_threshold > 0.0f && iteration + 1 >= params.min_iterations) {
+                    float mean = glm::dot(light_total, glm::vec3(0.2126f, 0.7152f, 0.0722f)) / texel_rays;
+                    float std_error = glm::sqrt(glm::max(lum_square_sum / texel_rays - mean * mean, 0.0f) / texel_rays);
+                    if (std_error <= params.error_threshold * glm::max(mean, 0.001f)) {
+                        break;
+                    }
+                }
+            }
+            local_rays += uint64_t(texel_rays);
+
+            // 均值的方差, 换算到SH L0层的亮度, 各次弹射相互独立所以直接累加, 供降噪使用
+            float mean = Luminance(light_total) / texel_rays;
+            float sh_l0_scale = 1.0f + 0.282095f * 8.0f / 3.0f;
+            light_variance[idx] += glm::max(lum_square_sum / texel_rays - mean * mean, 0.0f) / texel_rays * sh_l0_scale * sh_l0_scale;
+
+            if (active_rays > 0.0f) {
+                light_total /= active_rays;
+            }
+            dest_light.Store(idx, glm::vec4(light_total, 1.0f));
+
+            float sh_weight = 8.0f / (texel_rays * 3.0f);
+            for (uint32_t j = 0; j < 4; j++) {
+                sh_light_map[j * layer_size + idx] += glm::vec4(sh_accum[j] * sh_weight, 0.0f);
+            }
+            sh_light_map[idx] += glm::vec4(light_total, 0.0f);
+        }
+        rays_cast += local_rays;
+    });
+    return rays_cast.load();
+}
+
+glm::vec2 CpuBaker::GetLightmapUV(const Interaction& isect) const {
+    const Triangle& triangle = as->triangles[isect.tri_idx];
+    return isect.barycentric.x * as->vertices[triangle.indices[0]].uv1 +
+           isect.barycentric.y * as->vertices[triangle.indices[1]].uv1 +
+           isect.barycentric.z * as->vertices[triangle.indices[2]].uv1;
+}
+
+glm::vec3 CpuBaker::SampleSourceLight(const Interaction& isect) const {
+    return SampleBilinear(params.width, params.height, GetLightmapUV(isect), [&](uint32_t index) { return glm::vec3(source_light.Load(index)); });
+}
+
+glm::vec3 CpuBaker::SampleAlbedo(const Interaction& isect) const {
+    return SampleBilinear(params.width, params.height, GetLightmapUV(isect), [&](uint32_t index) { return glm::vec3(as->albedo_atlas[index]); });
+}
+
+glm::vec3 CpuBaker::PathTrace(Interaction isect, uint32_t texel_index, uint32_t sample_index) const {
+    float bound_length = glm::length(tracer.GetBoundSize());
+    glm::vec3 beta = glm::vec3(1.0f);
+    glm::vec3 radiance = glm::vec3(0.0f);
+
+    for (uint32_t bounce = 1; bounce < params.bounces; bounce++) {
+        beta *= SampleAlbedo(isect);
+
+        // RR, 每个顶点都已经读取了缓存的直接光照, 因此从第一次延续就开始
+        float survive = glm::min(glm::max(beta.x, glm::max(beta.y, beta.z)), 0.95f);
+        uint32_t dimension = SAMPLE_DIMENSION_PATH + 2 * (bounce - 1);
+        if (GetSample(texel_index, sample_index, dimension).x >= survive) {
+            break;
+        }
+        beta /= survive;
+
+        glm::vec3 up = glm::abs(isect.normal.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, isect.normal));
+        glm::vec3 bitangent = glm::cross(isect.normal, tangent);
+
+        glm::vec2 xi = GetSample(texel_index, sample_index, dimension + 1);
+        glm::vec3 bsdf_dir = CosineSampleHemisphere(xi.x, xi.y);
+        bsdf_dir = tangent * bsdf_dir.x + bitangent * bsdf_dir.y + isect.normal * bsdf_dir.z;
+
+        glm::vec3 ray_origin = isect.hit_position + isect.normal * params.bias;
+        uint32_t trace_result = tracer.TraceRay(ray_origin, ray_origin + bsdf_dir * bound_length, isect);
+        if (trace_result == RAY_MISS) {
+            if (IsStaticLightActive()) {
+                radiance += beta * EnvironmentRadiance(as, bsdf_dir);
+            }
+            break;
+        }
+        if (trace_result != RAY_FRONT) {
+            break;
+        }
+
+        radiance += beta * SampleSourceLight(isect);
+    }
+    return radiance;
+}
+
+void CpuBaker::BenchmarkShadowRays(uint32_t rays_per_texel) {
+    if (texels.empty() || rays_per_texel == 0) {
+        return;
+    }
+
+    // 阴影光线指向包围盒内的随机点, 两种遍历使用完全相同的光线
+    std::vector<glm::vec3> targets(rays_per_texel);
+    glm::uvec4 seed = glm::uvec4(1u, 2u, 3u, 4u);
+    for (uint32_t i = 0; i < rays_per_texel; i++) {
+        float x = Rand(seed);
+        float y = Rand(seed);
+        float z = Rand(seed);
+        targets[i] = as->bounds.min + glm::vec3(x, y, z) * as->bounds.GetSize();
+    }
+
+    auto run = [&](bool any_hit, uint64_t& occluded) {
+        std::atomic<uint64_t> occluded_count(0);
+        tracer.SetStatsEnabled(true);
+        tracer.ResetCounters();
+        auto start = std::chrono::high_resolution_clock::now();
+        ParallelFor(texels.size(), 256, [&](uint32_t begin, uint32_t end) {
+            uint64_t local_occluded = 0;
+            for (uint32_t t = begin; t < end; ++t) {
+                glm::vec3 from = texels[t].position + texels[t].normal * params.bias;
+                for (uint32_t i = 0; i < rays_per_texel; i++) {
+                    if (any_hit) {
+                        local_occluded += tracer.TraceShadowRay(from, targets[i]) != RAY_MISS;
+                    } else {
+                        Interaction isect;
+                        local_occluded += tracer.TraceRay(from, targets[i], isect) != RAY_MISS;
+                    }
+                }
+            }
+            occluded_count += local_occluded;
+        });
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        occluded = occluded_count.load();
+        tracer.SetStatsEnabled(false);
+        TraceCounters counters = tracer.GetCounters();
+        printf("cpu %s rays: %.1f cells/ray, triangle tests %llu, mailbox skipped %llu (%.1f%%)\n", any_hit ? "any-hit" : "closest-hit",
+               counters.cells_visited / std::max(1.0, double(counters.rays)), (unsigned long long)counters.triangle_tests,
+               (unsigned long long)counters.mailbox_skips, 100.0 * counters.mailbox_skips / std::max<uint64_t>(counters.triangle_tests + counters.mailbox_skips, 1));
+        return elapsed.count();
+    };
+
+    uint64_t any_hit_occluded = 0;
+    uint64_t closest_hit_occluded = 0;
+    double any_hit_time = run(true, any_hit_occluded);
+    double closest_hit_time = run(false, closest_hit_occluded);
+
+    double ray_count = double(texels.size()) * rays_per_texel;
+    printf("cpu shadow rays: any-hit %.2f Mrays/s, closest-hit %.2f Mrays/s (%.2fx), occluded %llu / %llu of %.0f\n",
+           ray_count / any_hit_time * 1e-6, ray_count / closest_hit_time * 1e-6, closest_hit_time / any_hit_time,
+           (unsigned long long)any_hit_occluded, (unsigned long long)closest_hit_occluded, ray_count);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "BakeCache.h"
+#include "Denoiser.h"
+#include "Dilation.h"
+#include "LightMapperDefine.h"
+#include "LightmapExport.h"
+#include "LightmapFormat.h"
+#include "Tracer.h"
+
+#include <string>
+#include <vector>
+
+struct AccelerationStructures;
+struct ShardGBuffer;
+struct ShardBakeState;
+struct ShardPassResult;
+
+const uint32_t ALL_LIGHT_GROUPS = 0xFFFFFFFF;
+
+struct CpuBakeParams {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t ray_count = 512;
+    uint32_t bounces = 1;
+    // 收集光线在命中点继续追踪路径, 所有弹射在一遍pass中完成
+    bool path_continuation = false;
+    uint32_t max_light_samples = 16;
+    uint32_t emissive_light_samples = 8;
+    // 自适应采样, 与GPU版本的迭代方式一致
+    uint32_t ray_iterations = 1;
+    uint32_t min_iterations = 1;
+    float error_threshold = 0.0f;
+    float bias = 0.02f;
+    // 每次弹射只写入一次的光照结果的存储格式, SH的running sum保持RGBA32F
+    LightmapFormat light_format = LIGHTMAP_FORMAT_RGBA16F;
+    // 弹射结束后对SH降噪, iterations为0时关闭
+    DenoiseParams denoise;
+    // 弹射和降噪之后对SH做jump flood扩展的最大距离, 0表示不扩展
+    uint32_t dilate_radius = 8;
+    // 每个灯光所属的分组, 为空时不分组. 分组后每组单独保存降噪之前的光照, 自发光和环境光单独作为最后一组,
+    // 只修改灯光颜色或强度时用Relight按组加权相加再降噪即可得到新的结果, 不需要重新烘焙. 分组时不使用自适应采样
+    std::vector<uint32_t> light_groups;
+    // 分片烘焙时atlas按tile_size划分, tile按行优先编号后轮流分给各分片, 交错分配使各分片的负载接近
+    uint32_t shard_count = 1;
+    uint32_t shard_index = 0;
+    uint32_t shard_tile_size = 64;
+    // 不为空时启用增量烘焙, 读取上一次的缓存只重新追踪受场景变化影响的纹素, 烘焙结束后更新缓存
+    std::string cache_path;
+    // 变化的模型和灯光向外扩展的影响距离, 覆盖阴影和近处间接光的变化
+    float cache_influence_radius = 0.5f;
+    // 不为空时统计光线遍历计数和各阶段耗时, 烘焙结束后写成json报告
+    std::string stats_report;
+    // 不为空时烘焙结束后把最终光照和4层SH按行流式导出到该文件, 尺寸和层名由烘焙器填写
+    std::string output_path;
+    LightmapExportDesc output_desc;
+};
+
+// CPU烘焙后端, 流程与GPU版本一致, 主要用于性能对比
+class CpuBaker {
+public:
+    CpuBaker(const AccelerationStructures* as, const std::vector<Light>& lights, const CpuBakeParams& params);
+
+    void Bake();
+
+    void RasterizeGBuffer();
+
+    void BuildTexelWorkList();
+
+    void LoadCache();
+
+    void BakeLightGroups();
+
+    void Unocclude();
+
+    void DirectLight();
+
+    void BounceLight();
+
+    void Denoise();
+
+    void Dilate();
+
+    void ExportOutput(bool collect_stats);
+
+    // 由分片烘焙的协调进程调用, 光栅化G-buffer, 生成整张atlas的纹素列表并unocclude, 结果用GetTexels和GetNormalData发给worker
+    void PrepareShardGBuffer();
+
+    // 分片worker进程计算一个pass, pass 0为直接光照, 之后每个pass为一次弹射, state为上一个pass合并后的整张atlas
+    void BakeShardPass(uint32_t pass, const ShardGBuffer& gbuffer, const ShardBakeState& state, ShardPassResult& result);
+
+    // 所有pass合并完成后由协调进程调用, 对合并的结果降噪, 扩展并导出, 需要在PrepareShardGBuffer之后调用
+    void FinishShardedBake(const ShardBakeState& state);
+
+    // 按每组的颜色权重重新合成SH和最终光照并降噪扩展, 权重全为1时与不分组的烘焙结果在采样误差内一致, 需要在分组烘焙之后调用
+    void Relight(const std::vector<glm::vec3>& group_weights);
+
+    // 灯光分组数加上自发光和环境光所在的最后一组, 未分组时为0
+    uint32_t GetLightGroupCount() const;
+
+    // 对比任意交点与最近交点两种遍历的阴影光线吞吐量, 需要在Bake之后调用
+    void BenchmarkShadowRays(uint32_t rays_per_texel);
+
+    uint32_t GetWidth() const { return params.width; }
+
+    uint32_t GetHeight() const { return params.height; }
+
+    const std::vector<TexelData>& GetTexels() const { return texels; }
+
+    const std::vector<glm::vec4>& GetPositionData() const { return position_data; }
+
+    const std::vector<glm::vec4>& GetNormalData() const { return normal_data; }
+
+    // 最终结果, 对应dest_light_tex, 按light_format存储
+    const PackedLightmap& GetLightData() const { return dest_light; }
+
+    // 4层SH数据按层依次存放, 对应sh_light_map
+    const std::vector<glm::vec4>& GetSHData() const { return sh_light_map; }
+
+    // 每组的4层SH数据, 布局与GetSHData一致
+    const std::vector<std::vector<glm::vec4>>& GetLightGroupSHData() const { return group_sh_light_map; }
+
+    // stats_report不为空时烘焙过程中记录的统计数据, 分片烘焙的协调进程在其中加入各个pass的耗时
+    BakeStats& GetStats() { return stats; }
+
+private:
+    void AddFormatStats();
+
+    uint64_t GetSettingsHash() const;
+
+    bool IsLightActive(uint32_t light_index) const;
+
+    bool IsStaticLightActive() const;
+
+    glm::vec2 GetLightmapUV(const Interaction& isect) const;
+
+    glm::vec3 SampleSourceLight(const Interaction& isect) const;
+
+    glm::vec3 SampleAlbedo(const Interaction& isect) const;
+
+    // 从source_light读取上一次的光照, 计算第bounce次弹射写入dest_light并累加到SH, 返回追踪的收集光线数
+    uint64_t BouncePass(uint32_t bounce);
+
+    // sample_index为收集光线的样本序号, 路径上每个顶点的随机数由纹素, 样本序号和深度决定
+    glm::vec3 PathTrace(Interaction isect, uint32_t texel_index, uint32_t sample_index) const;
+
+private:
+    const AccelerationStructures* as = nullptr;
+    std::vector<Light> lights;
+    CpuBakeParams params;
+    Tracer tracer;
+    BakeStats stats;
+
+    std::vector<glm::vec4> position_data;
+    std::vector<glm::vec4> normal_data;
+    std::vector<glm::vec4> unocclude_data;
+    std::vector<TexelData> texels;
+    PackedLightmap source_light;
+    PackedLightmap dest_light;
+    std::vector<glm::vec4> sh_light_map;
+    // 弹射光照在SH L0层的亮度方差
+    std::vector<float> light_variance;
+    // 本次烘焙的场景快照和结果, 以及增量烘焙时上一次每次弹射的结果
+    BakeCache bake_cache;
+    std::vector<std::vector<glm::vec4>> cached_bounce_light;
+    // 分组烘焙时当前计算的分组和每组的结果
+    uint32_t active_group = ALL_LIGHT_GROUPS;
+    std::vector<std::vector<glm::vec4>> group_sh_light_map;
+    std::vector<std::vector<glm::vec4>> group_light;
+    std::vector<std::vector<float>> group_light_variance;
+};
@@ -0,0 +1,111 @@
+#include "Denoiser.h"
+#include "Builder.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+static const uint32_t INVALID_CHART = 0xFFFFFFFF;
+
+// B3样条核的一维权重, 按到中心的距离索引
+static const float KERNEL_WEIGHTS[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+static float Luminance(const glm::vec3& color) {
+    return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+void DenoiseLightmap(const AccelerationStructures* as, uint32_t width, uint32_t height, const DenoiseParams& params,
+                     const std::vector<glm::vec4>& position, const std::vector<glm::vec4>& normal,
+                     const std::vector<float>& variance, std::vector<glm::vec4>& sh) {
+    if (params.iterations == 0) {
+        return;
+    }
+
+    uint32_t layer_size = width * height;
+    std::vector<uint32_t> charts(layer_size, INVALID_CHART);
+    std::vector<glm::vec3> normals(layer_size, glm::vec3(0.0f));
+    for (uint32_t i = 0; i < layer_size; ++i) {
+        if (position[i].w < 0.5f || glm::length(glm::vec3(normal[i])) < 0.5f) {
+            continue;
+        }
+        charts[i] = as->triangles[uint32_t(normal[i].w)].indices[3];
+        normals[i] = glm::normalize(glm::vec3(normal[i]));
+    }
+
+    float inv_plane = 1.0f / (params.sigma_plane * params.sigma_plane);
+    std::vector<glm::vec4> source(sh.size());
+    std::vector<float> luminance(layer_size);
+    std::vector<float> source_variance(layer_size);
+    std::vector<float> dest_variance = variance;
+    for (uint32_t iteration = 0; iteration < params.iterations; ++iteration) {
+        std::swap(source, sh);
+        std::swap(source_variance, dest_variance);
+        for (uint32_t i = 0; i < layer_size; ++i) {
+            luminance[i] = Luminance(source[i]);
+        }
+
+        int step = 1 << iteration;
+        ParallelFor(height, 4, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = begin; y < end; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    uint32_t idx = y * width + x;
+                    uint32_t chart = charts[idx];
+                    if (chart == INVALID_CHART) {
+                        for (uint32_t j = 0; j < 4; ++j) {
+                            sh[j * layer_size + idx] = source[j * layer_size + idx];
+                        }
+                        dest_variance[idx] = source_variance[idx];
+                        continue;
+                    }
+
+                    glm::vec3 center_position = position[idx];
+                    glm::vec3 center_normal = normals[idx];
+                    float center_luminance = luminance[idx];
+                    float center_variance = source_variance[idx];
+                    glm::vec3 sum[4] = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+                    float weight_sum = 0.0f;
+                    float variance_sum = 0.0f;
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        int sy = int(y) + dy * step;
+                        if (sy < 0 || sy >= int(height)) {
+                            continue;
+                        }
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            int sx = int(x) + dx * step;
+                            if (sx < 0 || sx >= int(width)) {
+                                continue;
+                            }
+
+                            uint32_t sample_idx = sy * width + sx;
+                            if (charts[sample_idx] != chart) {
+                                continue;
+                            }
+
+                            float weight = KERNEL_WEIGHTS[std::abs(dx)] * KERNEL_WEIGHTS[std::abs(dy)];
+                            if (sample_idx != idx) {
+                                glm::vec3 offset = glm::vec3(position[sample_idx]) - center_position;
+                                float distance = glm::length(offset);
+                                float plane = distance > 0.0f ? glm::dot(center_normal, offset) / distance : 0.0f;
+                                float normal_weight = glm::pow(glm::max(glm::dot(center_normal, normals[sample_idx]), 0.0f), params.normal_power);
+                                float luminance_diff = glm::abs(center_luminance - luminance[sample_idx]);
+                                float luminance_scale = params.sigma_luminance * glm::sqrt(center_variance + source_variance[sample_idx]) + 1e-6f;
+                                weight *= glm::exp(-plane * plane * inv_plane - luminance_diff / luminance_scale) * normal_weight;
+                            }
+
+                            for (uint32_t j = 0; j < 4; ++j) {
+                                sum[j] += glm::vec3(source[j * layer_size + sample_idx]) * weight;
+                            }
+                            weight_sum += weight;
+                            variance_sum += weight * weight * source_variance[sample_idx];
+                        }
+                    }
+
+                    // 中心纹素的权重不为0, weight_sum一定大于0
+                    for (uint32_t j = 0; j < 4; ++j) {
+                        sh[j * layer_size + idx] = glm::vec4(sum[j] / weight_sum, source[j * layer_size + idx].w);
+                    }
+                    dest_variance[idx] = variance_sum / (weight_sum * weight_sum);
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "LightMapperDefine.h"
+
+#include <vector>
+
+struct AccelerationStructures;
+
+// 边缘保持的à-trous小波滤波, 每次迭代为5x5的B3样条核, 第i次迭代的采样间隔为2^i个纹素
+// GPU版本为denoise.comp, 两者的权重计算一致
+struct DenoiseParams {
+    // 0表示关闭降噪, 4次迭代的覆盖范围为61x61个纹素
+    uint32_t iterations = 0;
+    // 邻居偏离中心纹素切平面的程度, 为两者连线与切平面夹角的正弦
+    float sigma_plane = 0.2f;
+    // 插值法线夹角余弦的指数
+    float normal_power = 32.0f;
+    // L0亮度差异以两者标准差为单位的容差, 方差随滤波一起传递, 因此每次迭代的容差自动收紧
+    float sigma_luminance = 2.0f;
+};
+
+// 只对4层SH滤波, 四层使用相同的权重, sh按层依次存放
+// 不同chart的纹素权重为0, 因此不会跨越uv岛, 未被覆盖的纹素保持不变
+// position和normal与RasterizeGBuffer的输出一致, normal的w为三角形索引
+// variance为每个纹素L0亮度的方差, 方差为0的纹素之间只有亮度相同时才会混合
+void DenoiseLightmap(const AccelerationStructures* as, uint32_t width, uint32_t height, const DenoiseParams& params,
+                     const std::vector<glm::vec4>& position, const std::vector<glm::vec4>& normal,
+                     const std::vector<float>& variance, std::vector<glm::vec4>& sh);
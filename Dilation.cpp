@@ -0,0 +1,99 @@
+#include "Dilation.h"
+#include "Parallel.h"
+
+#include <climits>
+
+static const glm::ivec2 INVALID_SEED = glm::ivec2(-1);
+
+static int DistanceSquared(const glm::ivec2& a, const glm::ivec2& b) {
+    glm::ivec2 d = a - b;
+    return d.x * d.x + d.y * d.y;
+}
+
+std::vector<uint32_t> GetJumpFloodSteps(uint32_t radius) {
+    std::vector<uint32_t> steps;
+    if (radius == 0) {
+        return steps;
+    }
+
+    uint32_t step = 1;
+    while (step * 2 <= radius) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        steps.push_back(step);
+    }
+    steps.push_back(1);
+    return steps;
+}
+
+void DilateLightmap(uint32_t width, uint32_t height, uint32_t layer_count, uint32_t radius, std::vector<glm::vec4>& layers) {
+    std::vector<uint32_t> steps = GetJumpFloodSteps(radius);
+    if (steps.empty()) {
+        return;
+    }
+
+    // 每个纹素记录目前找到的最近的已覆盖纹素
+    uint32_t layer_size = width * height;
+    std::vector<glm::ivec2> seeds(layer_size, INVALID_SEED);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            if (layers[y * width + x].a > 0.0f) {
+                seeds[y * width + x] = glm::ivec2(x, y);
+            }
+        }
+    }
+
+    std::vector<glm::ivec2> dest_seeds(layer_size);
+    for (uint32_t step : steps) {
+        ParallelFor(height, 16, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = begin; y < end; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    glm::ivec2 pos = glm::ivec2(x, y);
+                    glm::ivec2 best = seeds[y * width + x];
+                    int best_dist = best == INVALID_SEED ? INT_MAX : DistanceSquared(best, pos);
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            glm::ivec2 sample_pos = pos + glm::ivec2(dx, dy) * int(step);
+                            if (sample_pos.x < 0 || sample_pos.y < 0 || sample_pos.x >= int(width) || sample_pos.y >= int(height)) {
+                                continue;
+                            }
+
+                            glm::ivec2 seed = seeds[sample_pos.y * width + sample_pos.x];
+                            if (seed == INVALID_SEED) {
+                                continue;
+                            }
+
+                            int dist = DistanceSquared(seed, pos);
+                            if (dist < best_dist) {
+                                best = seed;
+                                best_dist = dist;
+                            }
+                        }
+                    }
+                    dest_seeds[y * width + x] = best;
+                }
+            }
+        });
+        seeds.swap(dest_seeds);
+    }
+
+    // 已覆盖纹素的来源是自身, 只需要复制未覆盖的纹素, 来源都是已覆盖的纹素所以可以原地写入
+    int max_dist = int(radius * radius);
+    ParallelFor(height, 16, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                uint32_t idx = y * width + x;
+                glm::ivec2 seed = seeds[idx];
+                if (seed == INVALID_SEED || seed == glm::ivec2(x, y) || DistanceSquared(seed, glm::ivec2(x, y)) > max_dist) {
+                    continue;
+                }
+
+                uint32_t seed_idx = seed.y * width + seed.x;
+                for (uint32_t j = 0; j < layer_count; ++j) {
+                    layers[j * layer_size + idx] = layers[j * layer_size + seed_idx];
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "LightMapperDefine.h"
+
+#include <vector>
+
+// jump flood每次迭代的采样间隔, 从不超过radius的最大2的幂开始减半到1, 最后再做一次间隔为1的迭代修正误差
+// radius为0时不需要迭代
+std::vector<uint32_t> GetJumpFloodSteps(uint32_t radius);
+
+// 用jump flood扩展lightmap, 替代原先固定2个纹素的5x5搜索, GPU版本为jump_flood.comp和dilate.comp
+// 第0层alpha为0的纹素视为未覆盖, 复制欧氏距离最近的已覆盖纹素的所有层, 距离超过radius的保持不变
+// 每个纹素只取一个来源且已覆盖的纹素不会被改写, 因此不同chart的数据不会混合, gutter中的纹素归属于最近的chart
+// layers按层依次存放, 每层width * height个纹素
+void DilateLightmap(uint32_t width, uint32_t height, uint32_t layer_count, uint32_t radius, std::vector<glm::vec4>& layers);
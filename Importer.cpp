@@ -9,6 +9,7 @@
 #include <gtx/quaternion.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <Blast/Gfx/GfxDefine.h>
+#include <stb_image.h>
 
 glm::mat4 GetLocalMatrix(cgltf_node* node) {
     glm::vec3 translation = glm::vec3(0.0f);
@@ -61,6 +62,37 @@ cgltf_attribute* GetGltfAttribute(cgltf_primitive* primitive, cgltf_attribute_ty
     return nullptr;
 }
 
+// 读取材质纹理并转换为RGBA8, 支持外部文件和内嵌buffer
+TextureData* LoadTexture(cgltf_texture* texture, const std::string& file_path) {
+    if (!texture || !texture->image) {
+        return nullptr;
+    }
+
+    cgltf_image* image = texture->image;
+    int width, height, channels;
+    stbi_uc* pixels = nullptr;
+    if (image->buffer_view) {
+        const stbi_uc* image_data = (const stbi_uc*)image->buffer_view->buffer->data + image->buffer_view->offset;
+        pixels = stbi_load_from_memory(image_data, (int)image->buffer_view->size, &width, &height, &channels, 4);
+    } else if (image->uri) {
+        std::string image_path = file_path.substr(0, file_path.find_last_of("/\\") + 1) + image->uri;
+        pixels = stbi_load(image_path.c_str(), &width, &height, &channels, 4);
+    }
+
+    if (!pixels) {
+        printf("failed to load texture %s\n", image->uri ? image->uri : "");
+        return nullptr;
+    }
+
+    TextureData* texture_data = new TextureData();
+    texture_data->width = width;
+    texture_data->height = height;
+    texture_data->data = new uint8_t[width * height * 4];
+    memcpy(texture_data->data, pixels, width * height * 4);
+    stbi_image_free(pixels);
+    return texture_data;
+}
+
 std::vector<Model*> ImportScene(const std::string& file_path) {
     cgltf_options options = {static_cast<cgltf_file_type>(0)};
     cgltf_data* data = NULL;
@@ -115,12 +147,12 @@ std::vector<Model*> ImportScene(const std::string& file_path) {
         // 填充空缺数据
         bool uv_data_empty = false;
         bool normal_data_empty = false;
-        if (!uvData || normalData) {
+        if (!uvData || !normalData) {
             float* uvs = nullptr;
             if (!uvData) {
                 uv_data_empty = true;
                 uvData = new uint8_t[vertex_count * sizeof(glm::vec2)];
-                uvs = (float*)normalData;
+                uvs = (float*)uvData;
             }
 
             float* normals = nullptr;
@@ -131,12 +163,12 @@ std::vector<Model*> ImportScene(const std::string& file_path) {
             }
 
             for (int j = 0; j < vertex_count; ++j) {
-                if (!uvData) {
+                if (uvs) {
                     uvs[j * 2] = 0.0f;
                     uvs[j * 2 + 1] = 0.0f;
                 }
 
-                if (!normalData) {
+                if (normals) {
                     normals[j * 3] = 1.0f;
                     normals[j * 3 + 1] = 0.0f;
                     normals[j * 3 + 2] = 0.0f;
@@ -171,7 +203,7 @@ std::vector<Model*> ImportScene(const std::string& file_path) {
         uint8_t* uv0_data = new uint8_t[vertex_count * sizeof(glm::vec2)];
         memcpy(uv0_data, uvData, vertex_count * sizeof(glm::vec2));
         uint8_t* uv1_data = new uint8_t[vertex_count * sizeof(glm::vec2)];
-        memcpy(uv0_data, uvData, vertex_count * sizeof(glm::vec2));
+        memcpy(uv1_data, uvData, vertex_count * sizeof(glm::vec2));
 
         uint8_t* index_data = nullptr;
         if (indexType == blast::INDEX_TYPE_UINT16) {
@@ -208,17 +240,55 @@ std::vector<Model*> ImportScene(const std::string& file_path) {
         model->SetUV1Data(uv1_data);
         model->SetIndexData(index_data);
 
+        // 自发光材质
+        if (cmaterial) {
+            model->SetEmissiveFactor(glm::vec3(cmaterial->emissive_factor[0], cmaterial->emissive_factor[1], cmaterial->emissive_factor[2]));
+            // glTF的自发光贴图与基础色贴图一样是sRGB编码
+            TextureData* emissive_texture = LoadTexture(cmaterial->emissive_texture.texture, file_path);
+            if (emissive_texture) {
+                emissive_texture->GenerateMips(true);
+            }
+            model->SetEmissiveTexture(emissive_texture);
+        }
+
+        // 基础色, 烘焙时用作反照率
+        if (cmaterial && cmaterial->has_pbr_metallic_roughness) {
+            cgltf_pbr_metallic_roughness* pbr = &cmaterial->pbr_metallic_roughness;
+            model->SetBaseColorFactor(glm::vec4(pbr->base_color_factor[0], pbr->base_color_factor[1], pbr->base_color_factor[2], pbr->base_color_factor[3]));
+            TextureData* base_color_texture = LoadTexture(pbr->base_color_texture.texture, file_path);
+            if (base_color_texture) {
+                base_color_texture->GenerateMips(true);
+            }
+            model->SetBaseColorTexture(base_color_texture);
+        }
+
         models.push_back(model);
 
         // 释放临时内存
         if (uv_data_empty) {
-            SAFE_DELETE(uvData);
+            SAFE_DELETE_ARRAY(uvData);
         }
         if (normal_data_empty) {
-            SAFE_DELETE(normalData);
+            SAFE_DELETE_ARRAY(normalData);
         }
     }
 
     cgltf_free(data);
     return models;
-}
\ No newline at end of file
+}
+
+bool ImportEnvironmentMap(const std::string& file_path, std::vector<glm::vec4>& pixels, uint32_t& width, uint32_t& height) {
+    int w, h, channels;
+    float* data = stbi_loadf(file_path.c_str(), &w, &h, &channels, 4);
+    if (!data) {
+        printf("failed to load environment map %s\n", file_path.c_str());
+        return false;
+    }
+
+    width = w;
+    height = h;
+    pixels.resize(width * height);
+    memcpy(pixels.data(), data, sizeof(glm::vec4) * width * height);
+    stbi_image_free(data);
+    return true;
+}
@@ -2,7 +2,11 @@
 
 #include <string>
 #include <vector>
+#include <glm.hpp>
 
 class Model;
 
-std::vector<Model*> ImportScene(const std::string& file_path);
\ No newline at end of file
+std::vector<Model*> ImportScene(const std::string& file_path);
+
+// 读取equirect格式的HDR环境贴图, 失败时返回false
+bool ImportEnvironmentMap(const std::string& file_path, std::vector<glm::vec4>& pixels, uint32_t& width, uint32_t& height);
@@ -22,6 +22,8 @@ static float gEpsilon = std::numeric_limits<float>::epsilon();
     }
 
 #define MAX_GRID_SIZE 128
+// 灯光网格比三角形网格粗, 每个cell记录影响范围覆盖它的灯光
+#define LIGHT_GRID_SIZE 16
 
 inline uint32_t murmur3(const uint32_t* key, size_t wordCount, uint32_t seed) noexcept {
     uint32_t h = seed;
@@ -67,6 +69,42 @@ struct Light {
     float inv_spot_attenuation;
 };
 
+// 每个三角形的材质, 布局与shader中的TriangleMaterial一致
+struct TriangleMaterial {
+    glm::vec4 emissive;
+};
+
+// 自发光三角形光源, 按功率使用alias表采样
+struct EmissiveLight {
+    glm::vec3 radiance;
+    uint32_t triangle_index;
+    glm::vec3 normal;
+    float area;
+    // 选中该光源的概率
+    float pdf;
+    float alias_prob;
+    uint32_t alias;
+    uint32_t padding;
+};
+
+// 环境光buffer的头部, 之后紧跟equirect格式的像素数据, 布局与shader中的EnvironmentMap一致
+struct EnvironmentInfo {
+    uint32_t width;
+    uint32_t height;
+    // 每次迭代对环境光重要性采样的光线数
+    uint32_t sample_count;
+    // 亮度乘sin(theta)在uv空间上的积分, 用于计算pdf
+    float integral;
+};
+
+// 紧凑化后的有效纹素, 布局与shader中的Texel一致
+struct TexelData {
+    glm::vec3 position;
+    uint32_t atlas_x;
+    glm::vec3 normal;
+    uint32_t atlas_y;
+};
+
 struct Vertex {
     glm::vec4 position;
     glm::vec4 normal;
@@ -139,6 +177,7 @@ struct Seam {
 };
 
 struct Triangle {
+    // 前3位为顶点索引, 第4位为三角形所属的lightmap chart
     uint32_t indices[4] = {};
     float min_bounds[4] = {};
     float max_bounds[4] = {};
@@ -0,0 +1,529 @@
+#include "LightmapExport.h"
+#include "LightMapperDefine.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+static bool SeekFile(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static bool WriteAt(FILE* file, uint64_t offset, const void* data, size_t size) {
+    return SeekFile(file, offset) && fwrite(data, 1, size, file) == size;
+}
+
+template <typename T>
+static void Append(std::vector<uint8_t>& buffer, const T& value) {
+    const uint8_t* bytes = (const uint8_t*)&value;
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void AppendString(std::vector<uint8_t>& buffer, const std::string& value) {
+    buffer.insert(buffer.end(), value.begin(), value.end());
+    buffer.push_back(0);
+}
+
+static std::string BuildMetadataJson(const LightmapExportDesc& desc) {
+    std::string json;
+    char text[256];
+    snprintf(text, sizeof(text), "{\"width\": %u, \"height\": %u, \"layers\": [", desc.width, desc.height);
+    json += text;
+    for (size_t i = 0; i < desc.layer_names.size(); ++i) {
+        json += (i > 0 ? ", \"" : "\"") + desc.layer_names[i] + "\"";
+    }
+    json += "], \"meshes\": [";
+    for (size_t i = 0; i < desc.mesh_rects.size(); ++i) {
+        const LightmapMeshRect& rect = desc.mesh_rects[i];
+        snprintf(text, sizeof(text), "%s{\"scale\": [%.9g, %.9g], \"offset\": [%.9g, %.9g]}", i > 0 ? ", " : "",
+                 rect.scale.x, rect.scale.y, rect.offset.x, rect.offset.y);
+        json += text;
+    }
+    json += "]}";
+    return json;
+}
+
+bool ParseLightmapExport(const std::string& name, LightmapExportDesc& desc) {
+    struct ExportName {
+        const char* name;
+        LightmapContainer container;
+        LightmapFormat format;
+        bool bc6h;
+    };
+    static const ExportName EXPORT_NAMES[] = {
+        {"exr16", LIGHTMAP_CONTAINER_EXR, LIGHTMAP_FORMAT_RGBA16F, false},
+        {"exr32", LIGHTMAP_CONTAINER_EXR, LIGHTMAP_FORMAT_RGBA32F, false},
+        {"ktx2-rgba16f", LIGHTMAP_CONTAINER_KTX2, LIGHTMAP_FORMAT_RGBA16F, false},
+        {"ktx2-rgba32f", LIGHTMAP_CONTAINER_KTX2, LIGHTMAP_FORMAT_RGBA32F, false},
+        {"ktx2-bc6h", LIGHTMAP_CONTAINER_KTX2, LIGHTMAP_FORMAT_RGBA16F, true},
+        {"dds-rgba16f", LIGHTMAP_CONTAINER_DDS, LIGHTMAP_FORMAT_RGBA16F, false},
+        {"dds-rgba32f", LIGHTMAP_CONTAINER_DDS, LIGHTMAP_FORMAT_RGBA32F, false},
+        {"dds-bc6h", LIGHTMAP_CONTAINER_DDS, LIGHTMAP_FORMAT_RGBA16F, true},
+    };
+    for (const ExportName& export_name : EXPORT_NAMES) {
+        if (name == export_name.name) {
+            desc.container = export_name.container;
+            desc.format = export_name.format;
+            desc.bc6h = export_name.bc6h;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string GetLightmapL1Path(const std::string& file_path) {
+    size_t dot = file_path.find_last_of('.');
+    size_t slash = file_path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return file_path + "_l1";
+    }
+    return file_path.substr(0, dot) + "_l1" + file_path.substr(dot);
+}
+
+std::vector<LightmapMeshRect> ComputeMeshLightmapRects(std::vector<Model*>& models) {
+    std::vector<LightmapMeshRect> rects(models.size());
+    for (size_t i = 0; i < models.size(); ++i) {
+        const glm::vec2* uv1_data = (const glm::vec2*)models[i]->GetUV1Data();
+        if (!uv1_data || models[i]->GetVertexCount() == 0) {
+            continue;
+        }
+        glm::vec2 min_uv(FLT_MAX), max_uv(-FLT_MAX);
+        for (uint32_t j = 0; j < models[i]->GetVertexCount(); ++j) {
+            min_uv = glm::min(min_uv, uv1_data[j]);
+            max_uv = glm::max(max_uv, uv1_data[j]);
+        }
+        rects[i].scale = max_uv - min_uv;
+        rects[i].offset = min_uv;
+    }
+    return rects;
+}
+
+// 不压缩的scanline EXR, 每个块一行, 行的大小固定所以偏移表可以在创建时写出
+class ExrWriter : public LightmapWriter {
+public:
+    ~ExrWriter() override {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    bool Open(const std::string& file_path, const LightmapExportDesc& desc) {
+        this->desc = desc;
+        component_size = desc.format == LIGHTMAP_FORMAT_RGBA32F ? 4 : 2;
+
+        // 通道需要按名称排序, 记录每个通道对应的层和分量
+        const char* components = "RGB";
+        for (uint32_t layer = 0; layer < desc.layer_names.size(); ++layer) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                channels.push_back(std::make_pair(desc.layer_names[layer] + "." + components[c], layer * 4 + c));
+            }
+        }
+        std::sort(channels.begin(), channels.end());
+
+        std::vector<uint8_t> header;
+        Append(header, uint32_t(20000630));
+        uint32_t version = 2;
+        for (const auto& channel : channels) {
+            if (channel.first.size() > 31) {
+                version |= 0x400;
+            }
+        }
+        Append(header, version);
+
+        std::vector<uint8_t> channel_list;
+        for (const auto& channel : channels) {
+            AppendString(channel_list, channel.first);
+            // pixel type: 1为HALF, 2为FLOAT; 之后是pLinear, 3字节保留和x, y采样率
+            Append(channel_list, uint32_t(component_size == 4 ? 2 : 1));
+            Append(channel_list, uint32_t(0));
+            Append(channel_list, int32_t(1));
+            Append(channel_list, int32_t(1));
+        }
+        channel_list.push_back(0);
+        WriteAttribute(header, "channels", "chlist", channel_list.data(), (uint32_t)channel_list.size());
+
+        uint8_t compression = 0;
+        WriteAttribute(header, "compression", "compression", &compression, 1);
+        int32_t window[4] = {0, 0, int32_t(desc.width) - 1, int32_t(desc.height) - 1};
+        WriteAttribute(header, "dataWindow", "box2i", window, sizeof(window));
+        WriteAttribute(header, "displayWindow", "box2i", window, sizeof(window));
+        uint8_t line_order = 0;
+        WriteAttribute(header, "lineOrder", "lineOrder", &line_order, 1);
+        float aspect_ratio = 1.0f;
+        WriteAttribute(header, "pixelAspectRatio", "float", &aspect_ratio, sizeof(float));
+        float window_center[2] = {0.0f, 0.0f};
+        WriteAttribute(header, "screenWindowCenter", "v2f", window_center, sizeof(window_center));
+        float window_width = 1.0f;
+        WriteAttribute(header, "screenWindowWidth", "float", &window_width, sizeof(float));
+        std::string metadata = BuildMetadataJson(desc);
+        WriteAttribute(header, "lightmapMeshes", "string", metadata.data(), (uint32_t)metadata.size());
+        header.push_back(0);
+
+        row_size = uint64_t(channels.size()) * desc.width * component_size;
+        data_offset = header.size() + uint64_t(desc.height) * sizeof(uint64_t);
+        for (uint32_t y = 0; y < desc.height; ++y) {
+            Append(header, uint64_t(data_offset + y * (row_size + 8)));
+        }
+
+        file = fopen(file_path.c_str(), "wb");
+        if (!file) {
+            printf("cannot write lightmap %s\n", file_path.c_str());
+            return false;
+        }
+        rows_written.assign(desc.height, 0);
+        row_buffer.resize(8 + row_size);
+        return fwrite(header.data(), 1, header.size(), file) == header.size();
+    }
+
+    bool WriteRows(uint32_t y, uint32_t row_count, const glm::vec4* const* layers) override {
+        for (uint32_t r = 0; r < row_count; ++r) {
+            uint32_t row = y + r;
+            if (row >= desc.height || rows_written[row]) {
+                return false;
+            }
+            rows_written[row] = 1;
+
+            uint8_t* data = row_buffer.data();
+            int32_t block_header[2] = {int32_t(row), int32_t(row_size)};
+            memcpy(data, block_header, 8);
+            data += 8;
+            for (const auto& channel : channels) {
+                const glm::vec4* texels = layers[channel.second / 4] + size_t(r) * desc.width;
+                uint32_t component = channel.second % 4;
+                for (uint32_t x = 0; x < desc.width; ++x, data += component_size) {
+                    if (component_size == 4) {
+                        memcpy(data, &texels[x][component], 4);
+                    } else {
+                        uint16_t half = FloatToHalf(texels[x][component]);
+                        memcpy(data, &half, 2);
+                    }
+                }
+            }
+            if (!WriteAt(file, data_offset + row * (row_size + 8), row_buffer.data(), row_buffer.size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Close() override {
+        bool complete = std::find(rows_written.begin(), rows_written.end(), 0) == rows_written.end();
+        bool closed = fclose(file) == 0;
+        file = nullptr;
+        return complete && closed;
+    }
+
+private:
+    static void WriteAttribute(std::vector<uint8_t>& header, const char* name, const char* type, const void* data, uint32_t size) {
+        AppendString(header, name);
+        AppendString(header, type);
+        Append(header, size);
+        header.insert(header.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    }
+
+private:
+    FILE* file = nullptr;
+    LightmapExportDesc desc;
+    uint32_t component_size = 2;
+    std::vector<std::pair<std::string, uint32_t>> channels;
+    uint64_t row_size = 0;
+    uint64_t data_offset = 0;
+    std::vector<uint8_t> rows_written;
+    std::vector<uint8_t> row_buffer;
+};
+
+// KTX2和DDS的纹理数组, 只有一级mip时各层的数据依次存放, 每行的偏移固定
+class TextureArrayWriter : public LightmapWriter {
+public:
+    ~TextureArrayWriter() override {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    bool Open(const std::string& file_path, const LightmapExportDesc& desc) {
+        this->desc = desc;
+        uint32_t layer_count = (uint32_t)desc.layer_names.size();
+        blocks_x = (desc.width + 3) / 4;
+        if (desc.bc6h) {
+            layer_size = uint64_t(GetBC6HBlockCount(desc.width, desc.height)) * BC6H_BLOCK_SIZE;
+        } else {
+            layer_size = uint64_t(desc.width) * desc.height * GetLightmapFormatSize(desc.format);
+        }
+
+        std::vector<uint8_t> header = desc.container == LIGHTMAP_CONTAINER_KTX2 ? BuildKtx2Header(layer_count) : BuildDdsHeader(layer_count);
+        data_offset = header.size();
+        file = fopen(file_path.c_str(), "wb");
+        if (!file) {
+            printf("cannot write lightmap %s\n", file_path.c_str());
+            return false;
+        }
+        if (desc.container == LIGHTMAP_CONTAINER_DDS) {
+            WriteMetadataFile(file_path + ".json");
+        }
+
+        rows_written.assign(desc.height, 0);
+        square_sums.assign(layer_count, 0.0);
+        peaks.assign(layer_count, 0.0);
+        return fwrite(header.data(), 1, header.size(), file) == header.size();
+    }
+
+    bool WriteRows(uint32_t y, uint32_t row_count, const glm::vec4* const* layers) override {
+        uint32_t layer_count = (uint32_t)desc.layer_names.size();
+        for (uint32_t r = 0; r < row_count; ++r) {
+            uint32_t row = y + r;
+            if (row >= desc.height || rows_written[row]) {
+                return false;
+            }
+            rows_written[row] = 1;
+
+            if (!desc.bc6h) {
+                row_data.Resize(desc.format, desc.width);
+                for (uint32_t layer = 0; layer < layer_count; ++layer) {
+                    const glm::vec4* texels = layers[layer] + size_t(r) * desc.width;
+                    for (uint32_t x = 0; x < desc.width; ++x) {
+                        row_data.Store(x, texels[x]);
+                    }
+                    uint64_t offset = data_offset + layer * layer_size + uint64_t(row) * row_data.GetDataSize();
+                    if (!WriteAt(file, offset, row_data.GetData(), row_data.GetDataSize())) {
+                        return false;
+                    }
+                }
+                continue;
+            }
+
+            // 缓存到凑齐一个块行再压缩
+            uint32_t block_row = row / 4;
+            PendingBlockRow& pending = pending_block_rows[block_row];
+            if (pending.texels.empty()) {
+                pending.texels.resize(size_t(layer_count) * desc.width * 4);
+            }
+            for (uint32_t layer = 0; layer < layer_count; ++layer) {
+                memcpy(&pending.texels[(size_t(layer) * 4 + row % 4) * desc.width], layers[layer] + size_t(r) * desc.width, sizeof(glm::vec4) * desc.width);
+            }
+            pending.row_count++;
+            if (pending.row_count == std::min(4u, desc.height - block_row * 4)) {
+                bool result = WriteBlockRow(block_row, pending);
+                pending_block_rows.erase(block_row);
+                if (!result) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool Close() override {
+        bool complete = std::find(rows_written.begin(), rows_written.end(), 0) == rows_written.end();
+        bool closed = fclose(file) == 0;
+        file = nullptr;
+
+        if (desc.bc6h) {
+            double count = double(desc.width) * desc.height * 3.0;
+            layer_psnr.resize(desc.layer_names.size());
+            for (size_t layer = 0; layer < desc.layer_names.size(); ++layer) {
+                double mse = square_sums[layer] / std::max(count, 1.0);
+                layer_psnr[layer] = mse > 0.0 && peaks[layer] > 0.0 ? 10.0 * std::log10(peaks[layer] * peaks[layer] / mse) : INFINITY;
+            }
+        }
+        return complete && closed;
+    }
+
+private:
+    struct PendingBlockRow {
+        std::vector<glm::vec4> texels;
+        uint32_t row_count = 0;
+    };
+
+    bool WriteBlockRow(uint32_t block_row, const PendingBlockRow& pending) {
+        uint32_t rows = std::min(4u, desc.height - block_row * 4);
+        std::vector<uint8_t> blocks;
+        std::vector<glm::vec4> decoded;
+        for (uint32_t layer = 0; layer < desc.layer_names.size(); ++layer) {
+            const glm::vec4* texels = &pending.texels[size_t(layer) * 4 * desc.width];
+            EncodeBC6H(texels, desc.width, rows, desc.bc6h_quality, desc.bc6h_signed, blocks);
+            uint64_t offset = data_offset + layer * layer_size + uint64_t(block_row) * blocks_x * BC6H_BLOCK_SIZE;
+            if (!WriteAt(file, offset, blocks.data(), blocks.size())) {
+                return false;
+            }
+
+            // 解码统计误差, 用于psnr报告
+            DecodeBC6H(blocks.data(), desc.width, rows, desc.bc6h_signed, decoded);
+            for (uint32_t i = 0; i < desc.width * rows; ++i) {
+                for (int c = 0; c < 3; ++c) {
+                    double d = double(decoded[i][c]) - double(texels[i][c]);
+                    square_sums[layer] += d * d;
+                    peaks[layer] = std::max(peaks[layer], std::fabs(double(texels[i][c])));
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> BuildKtx2Header(uint32_t layer_count) const {
+        // VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_BC6H_UFLOAT_BLOCK, VK_FORMAT_BC6H_SFLOAT_BLOCK
+        uint32_t vk_format = desc.bc6h ? (desc.bc6h_signed ? 144 : 143) : (desc.format == LIGHTMAP_FORMAT_RGBA32F ? 109 : 97);
+        uint32_t type_size = desc.bc6h ? 1 : (desc.format == LIGHTMAP_FORMAT_RGBA32F ? 4 : 2);
+        uint32_t texel_block_size = desc.bc6h ? BC6H_BLOCK_SIZE : GetLightmapFormatSize(desc.format);
+
+        // data format descriptor, 单个basic descriptor block
+        std::vector<uint8_t> dfd;
+        uint32_t sample_count = desc.bc6h ? 1 : 4;
+        Append(dfd, uint32_t(4 + 24 + 16 * sample_count));
+        Append(dfd, uint32_t(0));
+        Append(dfd, uint16_t(2));
+        Append(dfd, uint16_t(24 + 16 * sample_count));
+        // color model: KHR_DF_MODEL_BC6H或RGBSDA, BT709, 线性, alpha非预乘
+        dfd.push_back(desc.bc6h ? 131 : 1);
+        dfd.push_back(1);
+        dfd.push_back(1);
+        dfd.push_back(0);
+        uint8_t block_dimension = desc.bc6h ? 3 : 0;
+        uint8_t texel_block[4] = {block_dimension, block_dimension, 0, 0};
+        dfd.insert(dfd.end(), texel_block, texel_block + 4);
+        uint8_t bytes_plane[8] = {(uint8_t)texel_block_size};
+        dfd.insert(dfd.end(), bytes_plane, bytes_plane + 8);
+        const uint8_t float_flag = 0x80;
+        const uint8_t signed_flag = 0x40;
+        if (desc.bc6h) {
+            Append(dfd, uint16_t(0));
+            dfd.push_back(127);
+            dfd.push_back(desc.bc6h_signed ? float_flag | signed_flag : float_flag);
+            Append(dfd, uint32_t(0));
+            Append(dfd, uint32_t(desc.bc6h_signed ? 0xbf800000 : 0));
+            Append(dfd, uint32_t(0x3f800000));
+        } else {
+            // R, G, B, A的通道id为0, 1, 2, 15
+            const uint8_t channel_ids[4] = {0, 1, 2, 15};
+            uint32_t bits = type_size * 8;
+            for (uint32_t c = 0; c < 4; ++c) {
+                Append(dfd, uint16_t(c * bits));
+                dfd.push_back(uint8_t(bits - 1));
+                dfd.push_back(channel_ids[c] | float_flag | signed_flag);
+                Append(dfd, uint32_t(0));
+                Append(dfd, uint32_t(0xbf800000));
+                Append(dfd, uint32_t(0x3f800000));
+            }
+        }
+
+        // key/value数据按key排序, 每项按4字节对齐
+        std::vector<uint8_t> kvd;
+        std::pair<std::string, std::string> entries[2] = {{"KTXwriter", "Lightmapper"}, {"lightmapMeshes", BuildMetadataJson(desc)}};
+        for (const auto& entry : entries) {
+            Append(kvd, uint32_t(entry.first.size() + 1 + entry.second.size() + 1));
+            AppendString(kvd, entry.first);
+            AppendString(kvd, entry.second);
+            kvd.resize((kvd.size() + 3) & ~size_t(3), 0);
+        }
+
+        const uint32_t index_end = 12 + 9 * 4 + 4 * 4 + 2 * 8 + 3 * 8;
+        uint32_t dfd_offset = index_end;
+        uint32_t kvd_offset = dfd_offset + (uint32_t)dfd.size();
+        // 只有一级mip时level数据按纹素块大小和4的最小公倍数对齐
+        uint64_t level_offset = kvd_offset + kvd.size();
+        uint64_t alignment = std::max<uint64_t>(texel_block_size, 4);
+        level_offset = (level_offset + alignment - 1) / alignment * alignment;
+
+        std::vector<uint8_t> header;
+        const uint8_t identifier[12] = {0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a};
+        header.insert(header.end(), identifier, identifier + 12);
+        uint32_t fields[9] = {vk_format, type_size, desc.width, desc.height, 0, layer_count, 1, 1, 0};
+        for (uint32_t field : fields) {
+            Append(header, field);
+        }
+        Append(header, dfd_offset);
+        Append(header, uint32_t(dfd.size()));
+        Append(header, kvd_offset);
+        Append(header, uint32_t(kvd.size()));
+        Append(header, uint64_t(0));
+        Append(header, uint64_t(0));
+        Append(header, level_offset);
+        Append(header, layer_size * layer_count);
+        Append(header, layer_size * layer_count);
+        header.insert(header.end(), dfd.begin(), dfd.end());
+        header.insert(header.end(), kvd.begin(), kvd.end());
+        header.resize(level_offset, 0);
+        return header;
+    }
+
+    std::vector<uint8_t> BuildDdsHeader(uint32_t layer_count) const {
+        // DDS_HEADER和DDS_HEADER_DXT10, 像素格式使用DX10扩展头
+        uint32_t header[32 + 5] = {};
+        header[0] = 0x20534444;
+        header[1] = 124;
+        if (desc.bc6h) {
+            header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000;
+            header[5] = (uint32_t)layer_size;
+        } else {
+            header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;
+            header[5] = desc.width * GetLightmapFormatSize(desc.format);
+        }
+        header[3] = desc.height;
+        header[4] = desc.width;
+        header[7] = 1;
+        header[19] = 32;
+        header[20] = 0x4;
+        header[21] = 0x30315844;
+        header[27] = 0x1000;
+        // DXGI_FORMAT_BC6H_UF16或BC6H_SF16, R32G32B32A32_FLOAT或R16G16B16A16_FLOAT, D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        header[32] = desc.bc6h ? (desc.bc6h_signed ? 96 : 95) : (desc.format == LIGHTMAP_FORMAT_RGBA32F ? 2 : 10);
+        header[33] = 3;
+        header[35] = layer_count;
+        return std::vector<uint8_t>((const uint8_t*)header, (const uint8_t*)header + sizeof(header));
+    }
+
+    void WriteMetadataFile(const std::string& file_path) const {
+        FILE* metadata_file = fopen(file_path.c_str(), "w");
+        if (!metadata_file) {
+            printf("cannot write lightmap metadata %s\n", file_path.c_str());
+            return;
+        }
+        fprintf(metadata_file, "%s\n", BuildMetadataJson(desc).c_str());
+        fclose(metadata_file);
+    }
+
+private:
+    FILE* file = nullptr;
+    LightmapExportDesc desc;
+    uint32_t blocks_x = 0;
+    uint64_t layer_size = 0;
+    uint64_t data_offset = 0;
+    std::vector<uint8_t> rows_written;
+    PackedLightmap row_data;
+    std::map<uint32_t, PendingBlockRow> pending_block_rows;
+    std::vector<double> square_sums;
+    std::vector<double> peaks;
+};
+
+LightmapWriter* CreateLightmapWriter(const std::string& file_path, const LightmapExportDesc& desc) {
+    if (desc.format != LIGHTMAP_FORMAT_RGBA16F && desc.format != LIGHTMAP_FORMAT_RGBA32F) {
+        printf("lightmap export only supports rgba16f and rgba32f, got %s\n", GetLightmapFormatName(desc.format));
+        return nullptr;
+    }
+    if (desc.bc6h && desc.container == LIGHTMAP_CONTAINER_EXR) {
+        printf("exr does not support bc6h\n");
+        return nullptr;
+    }
+
+    if (desc.container == LIGHTMAP_CONTAINER_EXR) {
+        ExrWriter* writer = new ExrWriter();
+        if (!writer->Open(file_path, desc)) {
+            SAFE_DELETE(writer);
+        }
+        return writer;
+    }
+
+    TextureArrayWriter* writer = new TextureArrayWriter();
+    if (!writer->Open(file_path, desc)) {
+        SAFE_DELETE(writer);
+    }
+    return writer;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "LightmapFormat.h"
+#include "BC6HEncoder.h"
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Model;
+
+enum LightmapContainer {
+    // 每层写成layer.R, layer.G, layer.B三个通道, 不压缩的scanline文件
+    LIGHTMAP_CONTAINER_EXR,
+    // 每层是纹理数组的一层, 只有一级mip
+    LIGHTMAP_CONTAINER_KTX2,
+    LIGHTMAP_CONTAINER_DDS,
+};
+
+// 网格的lightmap uv在atlas中的矩形, uv1 = local_uv * scale + offset
+// local_uv为网格自身在矩形内归一化的lightmap uv, 运行时可以据此单独流送或重排每个网格的lightmap
+struct LightmapMeshRect {
+    glm::vec2 scale = glm::vec2(1.0f);
+    glm::vec2 offset = glm::vec2(0.0f);
+};
+
+struct LightmapExportDesc {
+    LightmapContainer container = LIGHTMAP_CONTAINER_EXR;
+    // 只支持RGBA16F和RGBA32F, EXR只写出rgb
+    LightmapFormat format = LIGHTMAP_FORMAT_RGBA16F;
+    // KTX2和DDS可以压缩成BC6H, 此时忽略format
+    bool bc6h = false;
+    // 压缩成BC6H_SF16, 用于有负数的层, 一个文件中的所有层使用相同的格式
+    bool bc6h_signed = false;
+    BC6HQuality bc6h_quality = BC6H_QUALITY_NORMAL;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::string> layer_names;
+    // EXR和KTX2写入文件自身的元数据中, DDS写到同名的.json文件
+    std::vector<LightmapMeshRect> mesh_rects;
+};
+
+// 按名称解析导出格式: exr16, exr32, ktx2-rgba16f, ktx2-rgba32f, ktx2-bc6h, dds-rgba16f, dds-rgba32f, dds-bc6h
+bool ParseLightmapExport(const std::string& name, LightmapExportDesc& desc);
+
+// BC6H导出时SH的L1层有负数, 单独写成BC6H_SF16的文件, 文件名在扩展名前加上_l1
+std::string GetLightmapL1Path(const std::string& file_path);
+
+// 统计每个网格的uv1包围矩形
+std::vector<LightmapMeshRect> ComputeMeshLightmapRects(std::vector<Model*>& models);
+
+// 流式写出lightmap, 文件头在创建时写出, 之后每行数据确定后即可写入, 不需要保存整张atlas的副本
+class LightmapWriter {
+public:
+    virtual ~LightmapWriter() {}
+
+    // layers[i]指向第i层从第y行开始的row_count行纹素, 每行只写入一次, 顺序任意
+    // BC6H在凑齐4行的块行后才编码写出
+    virtual bool WriteRows(uint32_t y, uint32_t row_count, const glm::vec4* const* layers) = 0;
+
+    // 返回false表示有未写入的行或写文件失败
+    virtual bool Close() = 0;
+
+    // BC6H压缩时每层相对原始数据的psnr, 需要在Close之后调用, 其他格式为空
+    const std::vector<double>& GetLayerPSNR() const { return layer_psnr; }
+
+protected:
+    std::vector<double> layer_psnr;
+};
+
+// 失败时返回nullptr
+LightmapWriter* CreateLightmapWriter(const std::string& file_path, const LightmapExportDesc& desc);
@@ -0,0 +1,231 @@
+#include "LightmapFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// half, R11G11B10F的分量都是5位指数, 偏移15, 只有尾数位数不同
+static const int SMALL_FLOAT_EXPONENT_BIAS = 15;
+
+// 无符号浮点编码, 最近舍入, 超出范围时截断到最大的有限值而不是无穷大
+static uint32_t FloatToSmallFloat(float value, uint32_t mantissa_bits) {
+    if (!(value > 0.0f)) {
+        return 0;
+    }
+
+    uint32_t max_bits = (30u << mantissa_bits) | ((1u << mantissa_bits) - 1);
+    int exponent;
+    float mantissa = std::frexp(value, &exponent);
+    int biased_exponent = exponent - 1 + SMALL_FLOAT_EXPONENT_BIAS;
+    uint32_t bits;
+    if (biased_exponent <= 0) {
+        // 非规格化数, 舍入进位后正好是最小的规格化数
+        bits = (uint32_t)std::lround(std::ldexp(double(value), SMALL_FLOAT_EXPONENT_BIAS - 1 + int(mantissa_bits)));
+    } else if (biased_exponent >= 31) {
+        bits = max_bits;
+    } else {
+        // 尾数舍入进位时自然进到指数位
+        bits = (uint32_t(biased_exponent) << mantissa_bits) + (uint32_t)std::lround((mantissa * 2.0 - 1.0) * double(1u << mantissa_bits));
+    }
+    return std::min(bits, max_bits);
+}
+
+static float SmallFloatToFloat(uint32_t bits, uint32_t mantissa_bits) {
+    uint32_t exponent = bits >> mantissa_bits;
+    uint32_t mantissa = bits & ((1u << mantissa_bits) - 1);
+    if (exponent == 0) {
+        return std::ldexp(float(mantissa), 1 - SMALL_FLOAT_EXPONENT_BIAS - int(mantissa_bits));
+    }
+
+    uint32_t float_bits = ((exponent - SMALL_FLOAT_EXPONENT_BIAS + 127) << 23) | (mantissa << (23 - mantissa_bits));
+    float value;
+    memcpy(&value, &float_bits, sizeof(float));
+    return value;
+}
+
+uint16_t FloatToHalf(float value) {
+    uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+    return sign | (uint16_t)FloatToSmallFloat(std::fabs(value), 10);
+}
+
+float HalfToFloat(uint16_t bits) {
+    float value = SmallFloatToFloat(bits & 0x7fff, 10);
+    return (bits & 0x8000) ? -value : value;
+}
+
+// 参考EXT_texture_shared_exponent中的转换方法
+uint32_t PackRGB9E5(const glm::vec3& color) {
+    const int mantissa_bits = 9;
+    const int exponent_bias = 15;
+    const float max_value = float((1 << mantissa_bits) - 1) / float(1 << mantissa_bits) * float(1 << (31 - exponent_bias));
+
+    // NaN同样截断为0
+    glm::vec3 c = glm::vec3(
+            color.r > 0.0f ? std::min(color.r, max_value) : 0.0f,
+            color.g > 0.0f ? std::min(color.g, max_value) : 0.0f,
+            color.b > 0.0f ? std::min(color.b, max_value) : 0.0f);
+    float max_channel = std::max(c.r, std::max(c.g, c.b));
+
+    int exponent = -exponent_bias;
+    if (max_channel > 0.0f) {
+        std::frexp(max_channel, &exponent);
+        exponent = std::max(exponent, -exponent_bias);
+    }
+    int shared_exponent = exponent + exponent_bias;
+    if (std::lround(std::ldexp(double(max_channel), mantissa_bits - exponent)) == (1 << mantissa_bits)) {
+        shared_exponent++;
+    }
+
+    int scale = mantissa_bits - (shared_exponent - exponent_bias);
+    uint32_t r = (uint32_t)std::lround(std::ldexp(double(c.r), scale));
+    uint32_t g = (uint32_t)std::lround(std::ldexp(double(c.g), scale));
+    uint32_t b = (uint32_t)std::lround(std::ldexp(double(c.b), scale));
+    return r | (g << 9) | (b << 18) | (uint32_t(shared_exponent) << 27);
+}
+
+glm::vec3 UnpackRGB9E5(uint32_t bits) {
+    float scale = std::ldexp(1.0f, int(bits >> 27) - 15 - 9);
+    return glm::vec3(float(bits & 0x1ff), float((bits >> 9) & 0x1ff), float((bits >> 18) & 0x1ff)) * scale;
+}
+
+uint32_t PackR11G11B10F(const glm::vec3& color) {
+    return FloatToSmallFloat(color.r, 6) | (FloatToSmallFloat(color.g, 6) << 11) | (FloatToSmallFloat(color.b, 5) << 22);
+}
+
+glm::vec3 UnpackR11G11B10F(uint32_t bits) {
+    return glm::vec3(SmallFloatToFloat(bits & 0x7ff, 6), SmallFloatToFloat((bits >> 11) & 0x7ff, 6), SmallFloatToFloat(bits >> 22, 5));
+}
+
+uint32_t GetLightmapFormatSize(LightmapFormat format) {
+    switch (format) {
+        case LIGHTMAP_FORMAT_RGBA32F:
+            return 16;
+        case LIGHTMAP_FORMAT_RGBA16F:
+            return 8;
+        case LIGHTMAP_FORMAT_RGB9E5:
+        case LIGHTMAP_FORMAT_R11G11B10F:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static const char* LIGHTMAP_FORMAT_NAMES[LIGHTMAP_FORMAT_COUNT] = {"rgba32f", "rgba16f", "rgb9e5", "r11g11b10f"};
+
+const char* GetLightmapFormatName(LightmapFormat format) {
+    return format < LIGHTMAP_FORMAT_COUNT ? LIGHTMAP_FORMAT_NAMES[format] : "unknown";
+}
+
+bool ParseLightmapFormat(const std::string& name, LightmapFormat& format) {
+    for (uint32_t i = 0; i < LIGHTMAP_FORMAT_COUNT; ++i) {
+        if (name == LIGHTMAP_FORMAT_NAMES[i]) {
+            format = (LightmapFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PackedLightmap::Resize(LightmapFormat format, uint32_t texel_count) {
+    this->format = format;
+    this->texel_count = texel_count;
+    data.assign(size_t(texel_count) * GetLightmapFormatSize(format), 0);
+}
+
+void PackedLightmap::Store(uint32_t index, const glm::vec4& value) {
+    uint8_t* texel = data.data() + size_t(index) * GetLightmapFormatSize(format);
+    switch (format) {
+        case LIGHTMAP_FORMAT_RGBA32F:
+            memcpy(texel, &value, sizeof(glm::vec4));
+            break;
+        case LIGHTMAP_FORMAT_RGBA16F: {
+            uint16_t half[4] = {FloatToHalf(value.r), FloatToHalf(value.g), FloatToHalf(value.b), FloatToHalf(value.a)};
+            memcpy(texel, half, sizeof(half));
+            break;
+        }
+        case LIGHTMAP_FORMAT_RGB9E5: {
+            uint32_t bits = PackRGB9E5(value);
+            memcpy(texel, &bits, sizeof(uint32_t));
+            break;
+        }
+        case LIGHTMAP_FORMAT_R11G11B10F: {
+            uint32_t bits = PackR11G11B10F(value);
+            memcpy(texel, &bits, sizeof(uint32_t));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+glm::vec4 PackedLightmap::Load(uint32_t index) const {
+    const uint8_t* texel = data.data() + size_t(index) * GetLightmapFormatSize(format);
+    switch (format) {
+        case LIGHTMAP_FORMAT_RGBA32F: {
+            glm::vec4 value;
+            memcpy(&value, texel, sizeof(glm::vec4));
+            return value;
+        }
+        case LIGHTMAP_FORMAT_RGBA16F: {
+            uint16_t half[4];
+            memcpy(half, texel, sizeof(half));
+            return glm::vec4(HalfToFloat(half[0]), HalfToFloat(half[1]), HalfToFloat(half[2]), HalfToFloat(half[3]));
+        }
+        case LIGHTMAP_FORMAT_RGB9E5: {
+            uint32_t bits;
+            memcpy(&bits, texel, sizeof(uint32_t));
+            return glm::vec4(UnpackRGB9E5(bits), 1.0f);
+        }
+        case LIGHTMAP_FORMAT_R11G11B10F: {
+            uint32_t bits;
+            memcpy(&bits, texel, sizeof(uint32_t));
+            return glm::vec4(UnpackR11G11B10F(bits), 1.0f);
+        }
+        default:
+            return glm::vec4(0.0f);
+    }
+}
+
+void PackedLightmap::Encode(LightmapFormat format, const std::vector<glm::vec4>& texels) {
+    Resize(format, (uint32_t)texels.size());
+    for (uint32_t i = 0; i < texel_count; ++i) {
+        Store(i, texels[i]);
+    }
+}
+
+void PackedLightmap::Decode(std::vector<glm::vec4>& texels) const {
+    texels.resize(texel_count);
+    for (uint32_t i = 0; i < texel_count; ++i) {
+        texels[i] = Load(i);
+    }
+}
+
+LightmapFormatError MeasureLightmapFormatError(const std::vector<glm::vec4>& reference, LightmapFormat format) {
+    PackedLightmap packed;
+    packed.Encode(format, reference);
+
+    LightmapFormatError error;
+    double square_sum = 0.0;
+    uint64_t rel_count = 0;
+    for (uint32_t i = 0; i < packed.GetTexelCount(); ++i) {
+        glm::vec4 value = packed.Load(i);
+        for (int k = 0; k < 3; ++k) {
+            double abs_error = std::fabs(double(value[k]) - double(reference[i][k]));
+            error.max_abs_error = std::max(error.max_abs_error, abs_error);
+            error.mean_abs_error += abs_error;
+            square_sum += abs_error * abs_error;
+            if (std::fabs(reference[i][k]) > 1e-3f) {
+                double rel_error = abs_error / std::fabs(double(reference[i][k]));
+                error.max_rel_error = std::max(error.max_rel_error, rel_error);
+                error.mean_rel_error += rel_error;
+                rel_count++;
+            }
+        }
+    }
+
+    double count = std::max(1.0, double(reference.size()) * 3.0);
+    error.mean_abs_error /= count;
+    error.rmse = std::sqrt(square_sum / count);
+    error.mean_rel_error /= std::max<uint64_t>(rel_count, 1);
+    return error;
+}
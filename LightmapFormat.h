@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// lightmap的存储格式, 累加用的running sum始终保持RGBA32F
+enum LightmapFormat {
+    LIGHTMAP_FORMAT_RGBA32F,
+    // 带符号, 可以存储SH的L1系数
+    LIGHTMAP_FORMAT_RGBA16F,
+    // 以下两种只有RGB且无符号, 负数截断为0, alpha读出为1
+    LIGHTMAP_FORMAT_RGB9E5,
+    LIGHTMAP_FORMAT_R11G11B10F,
+    LIGHTMAP_FORMAT_COUNT,
+};
+
+uint32_t GetLightmapFormatSize(LightmapFormat format);
+
+const char* GetLightmapFormatName(LightmapFormat format);
+
+// 按名称解析格式: rgba32f, rgba16f, rgb9e5, r11g11b10f
+bool ParseLightmapFormat(const std::string& name, LightmapFormat& format);
+
+uint16_t FloatToHalf(float value);
+
+float HalfToFloat(uint16_t bits);
+
+uint32_t PackRGB9E5(const glm::vec3& color);
+
+glm::vec3 UnpackRGB9E5(uint32_t bits);
+
+uint32_t PackR11G11B10F(const glm::vec3& color);
+
+glm::vec3 UnpackR11G11B10F(uint32_t bits);
+
+// 按格式打包存储的lightmap, 用于只写入一次的中间结果和最终输出
+class PackedLightmap {
+public:
+    void Resize(LightmapFormat format, uint32_t texel_count);
+
+    void Store(uint32_t index, const glm::vec4& value);
+
+    glm::vec4 Load(uint32_t index) const;
+
+    void Encode(LightmapFormat format, const std::vector<glm::vec4>& texels);
+
+    void Decode(std::vector<glm::vec4>& texels) const;
+
+    LightmapFormat GetFormat() const { return format; }
+
+    uint32_t GetTexelCount() const { return texel_count; }
+
+    const uint8_t* GetData() const { return data.data(); }
+
+    size_t GetDataSize() const { return data.size(); }
+
+private:
+    LightmapFormat format = LIGHTMAP_FORMAT_RGBA32F;
+    uint32_t texel_count = 0;
+    std::vector<uint8_t> data;
+};
+
+// 以RGBA32F数据为基准, 统计转换到指定格式后rgb通道的误差
+struct LightmapFormatError {
+    double max_abs_error = 0.0;
+    double mean_abs_error = 0.0;
+    // 相对误差只统计绝对值大于1e-3的分量, 避免接近0的值放大误差
+    double max_rel_error = 0.0;
+    double mean_rel_error = 0.0;
+    double rmse = 0.0;
+};
+
+LightmapFormatError MeasureLightmapFormatError(const std::vector<glm::vec4>& reference, LightmapFormat format);
@@ -13,6 +13,73 @@ void CombindVertexData(void* dst, void* src, uint32_t vertexCount, uint32_t attr
     }
 }
 
+TextureData::~TextureData() {
+    SAFE_DELETE_ARRAY(data);
+}
+
+void TextureData::GenerateMips(bool srgb) {
+    mips.clear();
+    if (!data || width == 0 || height == 0) {
+        return;
+    }
+
+    std::vector<glm::vec4> level(width * height);
+    for (uint32_t i = 0; i < width * height; i++) {
+        glm::vec4 texel = glm::vec4(data[i * 4], data[i * 4 + 1], data[i * 4 + 2], data[i * 4 + 3]) / 255.0f;
+        if (srgb) {
+            texel = glm::vec4(glm::pow(glm::vec3(texel), glm::vec3(2.2f)), texel.w);
+        }
+        level[i] = texel;
+    }
+    mips.push_back(level);
+
+    uint32_t level_width = width;
+    uint32_t level_height = height;
+    while (level_width > 1 || level_height > 1) {
+        const std::vector<glm::vec4>& prev = mips.back();
+        uint32_t next_width = glm::max(level_width / 2, 1u);
+        uint32_t next_height = glm::max(level_height / 2, 1u);
+        std::vector<glm::vec4> next(next_width * next_height);
+        for (uint32_t y = 0; y < next_height; y++) {
+            for (uint32_t x = 0; x < next_width; x++) {
+                uint32_t x0 = glm::min(x * 2, level_width - 1);
+                uint32_t x1 = glm::min(x * 2 + 1, level_width - 1);
+                uint32_t y0 = glm::min(y * 2, level_height - 1);
+                uint32_t y1 = glm::min(y * 2 + 1, level_height - 1);
+                next[y * next_width + x] = (prev[y0 * level_width + x0] + prev[y0 * level_width + x1] +
+                                            prev[y1 * level_width + x0] + prev[y1 * level_width + x1]) * 0.25f;
+            }
+        }
+        mips.push_back(next);
+        level_width = next_width;
+        level_height = next_height;
+    }
+}
+
+glm::vec4 TextureData::SampleLevel(const glm::vec2& uv, float lod) const {
+    if (mips.empty()) {
+        return glm::vec4(1.0f);
+    }
+
+    uint32_t level = glm::min(uint32_t(glm::max(lod + 0.5f, 0.0f)), uint32_t(mips.size() - 1));
+    const std::vector<glm::vec4>& texels = mips[level];
+    int level_width = glm::max(width >> level, 1u);
+    int level_height = glm::max(height >> level, 1u);
+
+    glm::vec2 p = (uv - glm::floor(uv)) * glm::vec2(level_width, level_height) - 0.5f;
+    glm::vec2 f = p - glm::floor(p);
+    int x0 = int(glm::floor(p.x));
+    int y0 = int(glm::floor(p.y));
+    int x1 = (x0 + 1) % level_width;
+    int y1 = (y0 + 1) % level_height;
+    x0 = (x0 + level_width) % level_width;
+    y0 = (y0 + level_height) % level_height;
+
+    glm::vec4 a = glm::mix(texels[y0 * level_width + x0], texels[y0 * level_width + x1], f.x);
+    glm::vec4 b = glm::mix(texels[y1 * level_width + x0], texels[y1 * level_width + x1], f.x);
+    return glm::mix(a, b, f.y);
+}
+
 Model::Model() {
 }
 
@@ -22,6 +89,8 @@ Model::~Model() {
     SAFE_DELETE_ARRAY(uv0_data);
     SAFE_DELETE_ARRAY(uv1_data);
     SAFE_DELETE_ARRAY(index_data);
+    SAFE_DELETE(emissive_texture);
+    SAFE_DELETE(base_color_texture);
 }
 
 void Model::ResetPositionData(uint8_t* position_data) {
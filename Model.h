@@ -7,6 +7,23 @@
 
 #include <vector>
 
+// CPU端的材质纹理, RGBA8格式
+struct TextureData {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t* data = nullptr;
+    // 线性空间的mip链, 第0层为原图
+    std::vector<std::vector<glm::vec4>> mips;
+
+    ~TextureData();
+
+    // 生成box filter的mip链, srgb为true时先转换到线性空间
+    void GenerateMips(bool srgb);
+
+    // 选取与lod最接近的mip层做双线性采样, 需要先调用GenerateMips
+    glm::vec4 SampleLevel(const glm::vec2& uv, float lod) const;
+};
+
 class Model {
 public:
     Model();
@@ -63,6 +80,22 @@ public:
 
     blast::IndexType GetIndexType() { return index_type; }
 
+    void SetEmissiveFactor(const glm::vec3& emissive_factor) { this->emissive_factor = emissive_factor; }
+
+    glm::vec3 GetEmissiveFactor() { return emissive_factor; }
+
+    void SetEmissiveTexture(TextureData* emissive_texture) { this->emissive_texture = emissive_texture; }
+
+    TextureData* GetEmissiveTexture() { return emissive_texture; }
+
+    void SetBaseColorFactor(const glm::vec4& base_color_factor) { this->base_color_factor = base_color_factor; }
+
+    glm::vec4 GetBaseColorFactor() { return base_color_factor; }
+
+    void SetBaseColorTexture(TextureData* base_color_texture) { this->base_color_texture = base_color_texture; }
+
+    TextureData* GetBaseColorTexture() { return base_color_texture; }
+
     blast::GfxBuffer* GetVertexBuffer() { return vertex_buffer; }
 
     blast::GfxBuffer* GetIndexBuffer() { return index_buffer; }
@@ -77,6 +110,11 @@ private:
     uint8_t* uv1_data = nullptr;
     uint8_t* index_data = nullptr;
     blast::IndexType index_type;
+    glm::vec3 emissive_factor = glm::vec3(0.0f);
+    TextureData* emissive_texture = nullptr;
+    // 没有材质时沿用原先的默认反照率
+    glm::vec4 base_color_factor = glm::vec4(0.9f, 0.9f, 0.9f, 1.0f);
+    TextureData* base_color_texture = nullptr;
     blast::GfxBuffer* vertex_buffer = nullptr;
     blast::GfxBuffer* index_buffer = nullptr;
 };
\ No newline at end of file
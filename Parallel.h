@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// 工作线程数的上限, 0表示使用全部硬件线程, 同一台机器上的多个分片烘焙进程平分硬件线程
+inline std::atomic<uint32_t>& GetWorkerCountLimit() {
+    static std::atomic<uint32_t> limit(0);
+    return limit;
+}
+
+inline uint32_t GetWorkerCount() {
+    uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t limit = GetWorkerCountLimit();
+    return limit > 0 ? std::min(count, limit) : count;
+}
+
+// 将[0, count)按chunk大小切分, 由工作线程动态领取执行
+inline void ParallelFor(uint32_t count, uint32_t chunk, const std::function<void(uint32_t begin, uint32_t end)>& func) {
+    if (count == 0) {
+        return;
+    }
+    chunk = std::max(1u, chunk);
+
+    std::atomic<uint32_t> next(0);
+    auto worker = [&]() {
+        while (true) {
+            uint32_t begin = next.fetch_add(chunk);
+            if (begin >= count) {
+                break;
+            }
+            func(begin, std::min(count, begin + chunk));
+        }
+    };
+
+    uint32_t thread_count = std::min(GetWorkerCount(), (count - 1) / chunk + 1);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
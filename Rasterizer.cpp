@@ -0,0 +1,262 @@
+#include "Rasterizer.h"
+#include "Builder.h"
+#include "Parallel.h"
+
+#include <cfloat>
+
+// 每个tile由一个线程独占写入, 不需要同步
+static const uint32_t RASTER_TILE_SIZE = 32;
+
+struct RasterTriangle {
+    glm::vec2 uv[3];
+    glm::vec2 edges[3];
+    // 边函数的符号, 使三角形内部的边函数都为正
+    float orientation;
+    glm::mat2 inv_uv_edges;
+    glm::vec3 pos[3];
+    // 修正过朝向的顶点法线, 只用于计算平滑位置
+    glm::vec3 smooth_norm[3];
+    glm::vec3 norm[3];
+    glm::vec3 face_normal;
+    float texel_size;
+    // 扩展后覆盖的纹素范围
+    glm::ivec2 texel_min;
+    glm::ivec2 texel_max;
+};
+
+static glm::vec2 ClosestPointOnSegment(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b) {
+    glm::vec2 ab = b - a;
+    float t = glm::clamp(glm::dot(p - a, ab) / glm::max(glm::dot(ab, ab), 1e-12f), 0.0f, 1.0f);
+    return a + ab * t;
+}
+
+bool GetTexelCoverage(const glm::vec2 uv[3], const glm::vec2& p, float dilation, glm::vec2& closest, float& distance) {
+    glm::mat2 uv_edges = glm::mat2(uv[1] - uv[0], uv[2] - uv[0]);
+    float orientation = glm::determinant(uv_edges) > 0.0f ? 1.0f : -1.0f;
+
+    // 与RasterizeGBuffer中的边函数计算顺序一致, 边界上的判断结果相同
+    bool inside = true;
+    for (int k = 0; k < 3; ++k) {
+        glm::vec2 edge = uv[(k + 1) % 3] - uv[k];
+        float edge_a = -edge.y * orientation;
+        float edge_b = edge.x * orientation;
+        float edge_c = -(edge_a * uv[k].x + edge_b * uv[k].y);
+        float e = edge_a * p.x + (edge_b * p.y + edge_c);
+        if (e + dilation * (glm::abs(edge.x) + glm::abs(edge.y)) < 0.0f) {
+            return false;
+        }
+        inside = inside && e >= 0.0f;
+    }
+
+    closest = p;
+    distance = 0.0f;
+    if (!inside) {
+        float min_distance2 = FLT_MAX;
+        for (int k = 0; k < 3; ++k) {
+            glm::vec2 q = ClosestPointOnSegment(p, uv[k], uv[(k + 1) % 3]);
+            float distance2 = glm::dot(p - q, p - q);
+            if (distance2 < min_distance2) {
+                min_distance2 = distance2;
+                closest = q;
+            }
+        }
+        distance = glm::sqrt(min_distance2);
+    }
+    return true;
+}
+
+static bool SetupTriangle(const AccelerationStructures* as, uint32_t t, const glm::vec2& atlas_size, float dilation, RasterTriangle& tri) {
+    const Triangle& triangle = as->triangles[t];
+    const Vertex* v[3] = {
+            &as->vertices[triangle.indices[0]],
+            &as->vertices[triangle.indices[1]],
+            &as->vertices[triangle.indices[2]],
+    };
+    for (int k = 0; k < 3; ++k) {
+        tri.uv[k] = v[k]->uv1 * atlas_size;
+        tri.pos[k] = v[k]->position;
+        tri.norm[k] = v[k]->normal;
+    }
+
+    glm::mat2 uv_edges = glm::mat2(tri.uv[1] - tri.uv[0], tri.uv[2] - tri.uv[0]);
+    float det = glm::determinant(uv_edges);
+    if (glm::abs(det) < 1e-8f) {
+        return false;
+    }
+    tri.inv_uv_edges = glm::inverse(uv_edges);
+    tri.orientation = det > 0.0f ? 1.0f : -1.0f;
+    for (int k = 0; k < 3; ++k) {
+        tri.edges[k] = tri.uv[(k + 1) % 3] - tri.uv[k];
+    }
+
+    // 纹素坐标上位置的偏导, 对应GPU上的dFdx/dFdy
+    glm::vec3 dpdx = (tri.pos[1] - tri.pos[0]) * tri.inv_uv_edges[0][0] + (tri.pos[2] - tri.pos[0]) * tri.inv_uv_edges[0][1];
+    glm::vec3 dpdy = (tri.pos[1] - tri.pos[0]) * tri.inv_uv_edges[1][0] + (tri.pos[2] - tri.pos[0]) * tri.inv_uv_edges[1][1];
+    glm::vec3 delta_uv = glm::max(glm::abs(dpdx), glm::abs(dpdy));
+    tri.texel_size = glm::max(delta_uv.x, glm::max(delta_uv.y, delta_uv.z)) * glm::sqrt(2.0f);
+    tri.face_normal = glm::normalize(glm::cross(tri.pos[0] - tri.pos[1], tri.pos[0] - tri.pos[2]));
+
+    // 修正朝向三角形内部的顶点法线
+    glm::vec3 center = (tri.pos[0] + tri.pos[1] + tri.pos[2]) * 0.3333333f;
+    for (int k = 0; k < 3; ++k) {
+        tri.smooth_norm[k] = tri.norm[k];
+        glm::vec3 dir = glm::normalize(tri.pos[k] - center);
+        float d = glm::dot(dir, tri.norm[k]);
+        if (d < 0.0f) {
+            tri.smooth_norm[k] = glm::normalize(tri.norm[k] - dir * d);
+        }
+    }
+
+    // 纹素中心在[uv_min - dilation, uv_max + dilation]内才可能被覆盖
+    glm::vec2 uv_min = glm::min(tri.uv[0], glm::min(tri.uv[1], tri.uv[2])) - dilation - 0.5f;
+    glm::vec2 uv_max = glm::max(tri.uv[0], glm::max(tri.uv[1], tri.uv[2])) + dilation - 0.5f;
+    tri.texel_min = glm::max(glm::ivec2(glm::ceil(uv_min)), glm::ivec2(0));
+    tri.texel_max = glm::min(glm::ivec2(glm::floor(uv_max)), glm::ivec2(atlas_size) - 1);
+    return tri.texel_min.x <= tri.texel_max.x && tri.texel_min.y <= tri.texel_max.y;
+}
+
+void RasterizeGBuffer(const AccelerationStructures* as, uint32_t width, uint32_t height, float dilation,
+                      std::vector<glm::vec4>& position, std::vector<glm::vec4>& normal, std::vector<glm::vec4>& unocclude) {
+    position.assign(width * height, glm::vec4(0.0f));
+    normal.assign(width * height, glm::vec4(0.0f));
+    unocclude.assign(width * height, glm::vec4(0.0f));
+
+    uint32_t triangle_count = (uint32_t)as->triangles.size();
+    uint32_t tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    uint32_t tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    glm::vec2 atlas_size = glm::vec2(width, height);
+
+    // 三角形设置和分tile并行进行, 每段三角形单独记录所在的tile, 合并时保持三角形顺序
+    const uint32_t setup_chunk = 4096;
+    uint32_t chunk_count = (triangle_count + setup_chunk - 1) / setup_chunk;
+    std::vector<RasterTriangle> setups(triangle_count);
+    std::vector<std::vector<glm::uvec2>> chunk_bins(chunk_count);
+    ParallelFor(triangle_count, setup_chunk, [&](uint32_t begin, uint32_t end) {
+        std::vector<glm::uvec2>& bins = chunk_bins[begin / setup_chunk];
+        for (uint32_t t = begin; t < end; ++t) {
+            RasterTriangle& tri = setups[t];
+            if (!SetupTriangle(as, t, atlas_size, dilation, tri)) {
+                continue;
+            }
+            for (uint32_t ty = tri.texel_min.y / RASTER_TILE_SIZE; ty <= tri.texel_max.y / RASTER_TILE_SIZE; ++ty) {
+                for (uint32_t tx = tri.texel_min.x / RASTER_TILE_SIZE; tx <= tri.texel_max.x / RASTER_TILE_SIZE; ++tx) {
+                    bins.push_back(glm::uvec2(ty * tiles_x + tx, t));
+                }
+            }
+        }
+    });
+
+    // 按tile计数排序成连续的三角形列表
+    std::vector<uint32_t> tile_offsets(tiles_x * tiles_y + 1, 0);
+    for (const std::vector<glm::uvec2>& bins : chunk_bins) {
+        for (const glm::uvec2& bin : bins) {
+            tile_offsets[bin.x + 1]++;
+        }
+    }
+    for (uint32_t i = 0; i < tiles_x * tiles_y; ++i) {
+        tile_offsets[i + 1] += tile_offsets[i];
+    }
+    std::vector<uint32_t> tile_triangles(tile_offsets.back());
+    std::vector<uint32_t> tile_cursor(tile_offsets.begin(), tile_offsets.end() - 1);
+    for (const std::vector<glm::uvec2>& bins : chunk_bins) {
+        for (const glm::uvec2& bin : bins) {
+            tile_triangles[tile_cursor[bin.x]++] = bin.y;
+        }
+    }
+
+    // 先求出每个纹素最终覆盖的三角形和采样点, 再逐纹素计算一次属性, 避免重叠部分重复着色
+    ParallelFor(tiles_x * tiles_y, 1, [&](uint32_t begin, uint32_t end) {
+        const uint32_t tile_texels = RASTER_TILE_SIZE * RASTER_TILE_SIZE;
+        float best_distance[tile_texels];
+        uint32_t best_triangle[tile_texels];
+        glm::vec2 best_uv[tile_texels];
+        for (uint32_t tile = begin; tile < end; ++tile) {
+            glm::ivec2 tile_min = glm::ivec2(tile % tiles_x, tile / tiles_x) * int(RASTER_TILE_SIZE);
+            glm::ivec2 tile_max = glm::min(tile_min + int(RASTER_TILE_SIZE), glm::ivec2(width, height)) - 1;
+            std::fill(best_distance, best_distance + tile_texels, FLT_MAX);
+
+            for (uint32_t i = tile_offsets[tile]; i < tile_offsets[tile + 1]; ++i) {
+                uint32_t t = tile_triangles[i];
+                const RasterTriangle& tri = setups[t];
+                glm::ivec2 texel_min = glm::max(tri.texel_min, tile_min);
+                glm::ivec2 texel_max = glm::min(tri.texel_max, tile_max);
+
+                // 边函数e = a * x + b * y + c, 三角形内部为正
+                // 方框与三角形的分离轴只剩三条边的法线, 包围盒方向已由texel范围保证
+                glm::vec3 edge_a, edge_b, edge_c, edge_extent;
+                for (int k = 0; k < 3; ++k) {
+                    edge_a[k] = -tri.edges[k].y * tri.orientation;
+                    edge_b[k] = tri.edges[k].x * tri.orientation;
+                    edge_c[k] = -(edge_a[k] * tri.uv[k].x + edge_b[k] * tri.uv[k].y);
+                    edge_extent[k] = dilation * (glm::abs(tri.edges[k].x) + glm::abs(tri.edges[k].y));
+                }
+
+                for (int y = texel_min.y; y <= texel_max.y; ++y) {
+                    glm::vec3 row_e = edge_b * (y + 0.5f) + edge_c;
+                    for (int x = texel_min.x; x <= texel_max.x; ++x) {
+                        glm::vec3 e = edge_a * (x + 0.5f) + row_e;
+                        if (e.x + edge_extent.x < 0.0f || e.y + edge_extent.y < 0.0f || e.z + edge_extent.z < 0.0f) {
+                            continue;
+                        }
+
+                        // 在三角形外的纹素取三角形上最近的点
+                        glm::vec2 p = glm::vec2(x + 0.5f, y + 0.5f);
+                        glm::vec2 sample_uv = p;
+                        float distance = 0.0f;
+                        if (e.x < 0.0f || e.y < 0.0f || e.z < 0.0f) {
+                            float min_distance2 = FLT_MAX;
+                            for (int k = 0; k < 3; ++k) {
+                                glm::vec2 q = ClosestPointOnSegment(p, tri.uv[k], tri.uv[(k + 1) % 3]);
+                                float distance2 = glm::dot(p - q, p - q);
+                                if (distance2 < min_distance2) {
+                                    min_distance2 = distance2;
+                                    sample_uv = q;
+                                }
+                            }
+                            distance = glm::sqrt(min_distance2);
+                        }
+
+                        // 距离相同时后绘制的三角形覆盖之前的, 与GPU光栅化的顺序一致
+                        uint32_t local = (y - tile_min.y) * RASTER_TILE_SIZE + (x - tile_min.x);
+                        if (distance <= best_distance[local]) {
+                            best_distance[local] = distance;
+                            best_triangle[local] = t;
+                            best_uv[local] = sample_uv;
+                        }
+                    }
+                }
+            }
+
+            for (int y = tile_min.y; y <= tile_max.y; ++y) {
+                for (int x = tile_min.x; x <= tile_max.x; ++x) {
+                    uint32_t local = (y - tile_min.y) * RASTER_TILE_SIZE + (x - tile_min.x);
+                    if (best_distance[local] == FLT_MAX) {
+                        continue;
+                    }
+
+                    uint32_t t = best_triangle[local];
+                    const RasterTriangle& tri = setups[t];
+                    glm::vec2 b12 = glm::clamp(tri.inv_uv_edges * (best_uv[local] - tri.uv[0]), 0.0f, 1.0f);
+                    glm::vec3 barycentric = glm::vec3(glm::max(1.0f - b12.x - b12.y, 0.0f), b12.x, b12.y);
+                    barycentric /= barycentric.x + barycentric.y + barycentric.z;
+
+                    glm::vec3 vertex_pos = tri.pos[0] * barycentric.x + tri.pos[1] * barycentric.y + tri.pos[2] * barycentric.z;
+                    glm::vec3 smooth_position = glm::vec3(0.0f);
+                    for (int k = 0; k < 3; ++k) {
+                        glm::vec3 proj = vertex_pos - tri.smooth_norm[k] * (glm::dot(tri.smooth_norm[k], vertex_pos) - glm::dot(tri.smooth_norm[k], tri.pos[k]));
+                        smooth_position += proj * barycentric[k];
+                    }
+                    if (glm::dot(tri.face_normal, smooth_position) > glm::dot(tri.face_normal, vertex_pos)) {
+                        vertex_pos = smooth_position;
+                    }
+                    glm::vec3 interp_normal = glm::normalize(tri.norm[0] * barycentric.x + tri.norm[1] * barycentric.y + tri.norm[2] * barycentric.z);
+
+                    uint32_t idx = y * width + x;
+                    position[idx] = glm::vec4(vertex_pos, 1.0f);
+                    normal[idx] = glm::vec4(interp_normal, float(t));
+                    unocclude[idx] = glm::vec4(tri.face_normal, tri.texel_size);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "LightMapperDefine.h"
+
+#include <vector>
+
+struct AccelerationStructures;
+
+// 保守光栅化的扩展半径, 以纹素为单位, 纹素中心周围边长为2 * GBUFFER_DILATION的方框与三角形相交即被覆盖, 用来填满chart边缘的采样范围
+const float GBUFFER_DILATION = 3.0f;
+
+// 与RasterizeGBuffer相同的覆盖判断, uv为纹素坐标下的三角形, p为纹素中心
+// 覆盖时返回true, closest为三角形上离p最近的点, distance为到该点的距离, p在三角形内时为p本身和0
+bool GetTexelCoverage(const glm::vec2 uv[3], const glm::vec2& p, float dilation, glm::vec2& closest, float& distance);
+
+// 在lightmap空间中对所有三角形做一遍保守光栅化, 生成烘焙用的G-buffer
+// 纹素中心周围边长为2 * dilation的方框与三角形相交即被覆盖, dilation为0.5时就是标准的保守光栅化
+// 多个三角形覆盖同一纹素时取离纹素中心最近的, 被扩展覆盖的纹素使用三角形上最近点的属性
+// position: xyz为位置, w为1表示被覆盖
+// normal: xyz为插值法线, w为三角形索引
+// unocclude: xyz为面法线, w为纹素在世界空间的尺寸
+void RasterizeGBuffer(const AccelerationStructures* as, uint32_t width, uint32_t height, float dilation,
+                      std::vector<glm::vec4>& position, std::vector<glm::vec4>& normal, std::vector<glm::vec4>& unocclude);
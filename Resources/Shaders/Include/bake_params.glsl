@@ -0,0 +1,29 @@
+// 与main.cpp中的BakeParam保持一致, 所有烘焙pass共用同一份push constant
+layout(push_constant) uniform BakeParams {
+    vec4 bound_size;
+    vec4 to_cell_offset;
+    vec4 to_cell_size;
+    ivec2 atlas_size;
+    float bias;
+    uint ray_count;
+    uint ray_count_per_iteration;
+    uint light_count;
+    uint grid_size;
+    uint texel_offset;
+    uint texel_stride;
+    uint max_iterations;
+    uint current_iterations;
+    uint bounces;
+    uint min_iterations;
+    float error_threshold;
+    uint current_bounce;
+    uint max_light_samples;
+    uint emissive_light_count;
+    uint emissive_light_samples;
+    // 不为0时统计网格遍历的计数
+    uint trace_counters;
+    // 分组烘焙时只计算这一组的光源, ALL_LIGHT_GROUPS时计算所有光源
+    uint light_group;
+} params;
+
+#define ALL_LIGHT_GROUPS 0xffffffffu
@@ -0,0 +1,22 @@
+// 烘焙用到的公共结构, buffer的绑定由各个pass自行声明
+#define LIGHT_TYPE_DIRECTIONAL 0
+#define LIGHT_TYPE_OMNI 1
+#define LIGHT_TYPE_SPOT 2
+
+struct Light {
+    vec3 position;
+    uint type;
+    vec4 direction_energy;
+    vec4 color;
+    float range;
+    float attenuation;
+    float cos_spot_angle;
+    float inv_spot_attenuation;
+};
+
+struct Texel {
+    vec3 position;
+    uint atlas_x;
+    vec3 normal;
+    uint atlas_y;
+};
@@ -0,0 +1,22 @@
+// 场景几何, 与Builder中的Vertex/Triangle布局一致
+struct Vertex {
+    vec4 position;
+    vec4 normal;
+    vec2 uv0;
+    vec2 uv1;
+};
+
+layout(set = 0, binding = 2000, std430) restrict readonly buffer Vertices {
+    Vertex data[];
+} vertices;
+
+struct Triangle {
+    // xyz为顶点索引, w为lightmap chart
+    uvec4 indices;
+    vec4 min_bounds;
+    vec4 max_bounds;
+};
+
+layout(set = 0, binding = 2001, std430) restrict readonly buffer Triangles {
+    Triangle data[];
+} triangles;
@@ -0,0 +1,199 @@
+// 网格遍历与三角形求交, 各个烘焙pass共用
+// 包含前需要声明nearest_sampler, 可以在包含前定义下面的宏来配置变体
+#include "scene.glsl"
+#include "bake_params.glsl"
+
+// 正面交点的距离是否减去bias, 使正面交点优先于同距离的背面交点
+#ifndef TRACE_FRONT_FACE_BIAS
+#define TRACE_FRONT_FACE_BIAS true
+#endif
+
+layout(set = 0, binding = 2002, std430) restrict readonly buffer GridIndices {
+    uint data[];
+} grid_indices;
+
+layout(binding = 1000) uniform utexture3D grid_texture;
+
+// 与Tracer的计数一致, 依次为光线数, 访问的cell数, 三角形测试数, mailbox跳过的测试数和命中数
+// 每个计数用两个uint保存低32位和高32位, 由主机端清零
+layout(set = 0, binding = 2015, std430) restrict buffer TraceCounters {
+    uint data[10];
+} trace_counters;
+
+void AddTraceCounter(uint index, uint value) {
+    uint low = atomicAdd(trace_counters.data[index * 2], value);
+    if (low + value < low) {
+        atomicAdd(trace_counters.data[index * 2 + 1], 1);
+    }
+}
+
+// 每条光线结束时累加一次, 没有开启统计时不产生原子操作
+void AddTraceCounters(uint cells, uint tests, uint skips, bool hit) {
+    if (params.trace_counters == 0) {
+        return;
+    }
+    AddTraceCounter(0, 1);
+    AddTraceCounter(1, cells);
+    AddTraceCounter(2, tests);
+    AddTraceCounter(3, skips);
+    if (hit) {
+        AddTraceCounter(4, 1);
+    }
+}
+
+struct Interaction {
+    bool hit;
+    float hit_dist;
+    vec3 hit_position;
+    uint tri_idx;
+    vec3 wo;
+    vec3 normal;
+    vec3 barycentric;
+};
+
+bool RayHitTriangle(vec3 from, vec3 dir, float max_dist, vec3 p0, vec3 p1, vec3 p2, out float r_distance, out vec3 r_barycentric) {
+    const float EPSILON = 0.00001;
+    const vec3 e0 = p1 - p0;
+    const vec3 e1 = p0 - p2;
+    vec3 triangle_normal = cross(e1, e0);
+
+    float n_dot_dir = dot(triangle_normal, dir);
+
+    if (abs(n_dot_dir) < EPSILON) {
+        return false;
+    }
+
+    const vec3 e2 = (p0 - from) / n_dot_dir;
+    const vec3 i = cross(dir, e2);
+
+    r_barycentric.y = dot(i, e1);
+    r_barycentric.z = dot(i, e0);
+    r_barycentric.x = 1.0 - (r_barycentric.z + r_barycentric.y);
+    r_distance = dot(triangle_normal, e2);
+
+    return (r_distance > 0.0) && (r_distance < max_dist) && all(greaterThanEqual(r_barycentric, vec3(0.0)));
+}
+
+const uint RAY_MISS = 0;
+const uint RAY_FRONT = 1;
+const uint RAY_BACK = 2;
+const uint RAY_ANY = 3;
+
+// 最近交点与任意交点共用的遍历, 调用处any_hit都是常量, 内联后分支会被编译器消除
+// any_hit时遇到第一个交点就返回, 不计算法线和交点信息
+// 跨cell的三角形可能在后面的cell中才被命中, 最近交点只有在当前cell的出口之前才能返回
+uint TraceRayCore(vec3 p_from, vec3 p_to, const bool any_hit, out Interaction isect) {
+    vec3 rel = p_to - p_from;
+    float rel_len = length(rel);
+    vec3 dir = normalize(rel);
+    vec3 inv_dir = 1.0 / dir;
+    vec3 from_cell = (p_from - params.to_cell_offset.xyz) * params.to_cell_size.xyz;
+    vec3 to_cell = (p_to - params.to_cell_offset.xyz) * params.to_cell_size.xyz;
+    vec3 rel_cell = to_cell - from_cell;
+    float t_max = length(rel_cell);
+    float cell_to_world = rel_len / t_max;
+    ivec3 icell = ivec3(from_cell);
+    ivec3 iendcell = ivec3(to_cell);
+    vec3 dir_cell = rel_cell / t_max;
+    vec3 delta = min(abs(1.0 / dir_cell), params.grid_size);
+    ivec3 step = ivec3(sign(rel_cell));
+    vec3 side = (sign(rel_cell) * (vec3(icell) - from_cell) + (sign(rel_cell) * 0.5) + 0.5) * delta;
+
+    // 最近测试过的8个三角形, 与Tracer中的MAILBOX_SIZE一致, 用两个向量移位代替数组避免动态索引
+    uvec4 mailbox0 = uvec4(0xffffffffu);
+    uvec4 mailbox1 = uvec4(0xffffffffu);
+
+    uint hit = RAY_MISS;
+    float best_distance = 1e20;
+    isect.hit = false;
+
+    // 每一步都跨过一个cell的边界, 穿过整个网格不会超过3 * grid_size步
+    // 方向为NaN或长度为0时cell不会前进, 用这个上限防止死循环
+    uint max_cells = 3 * params.grid_size;
+    uint cells = 0;
+    uint tests = 0;
+    uint skips = 0;
+
+    while (all(greaterThanEqual(icell, ivec3(0))) && all(lessThan(icell, ivec3(params.grid_size))) && cells < max_cells) {
+        cells++;
+        uvec2 cell_data = texelFetch(usampler3D(grid_texture, nearest_sampler), icell, 0).xy;
+        for (uint i = 0; i < cell_data.x; i++) {
+            uint tidx = grid_indices.data[cell_data.y + i];
+
+            if (any(equal(mailbox0, uvec4(tidx))) || any(equal(mailbox1, uvec4(tidx)))) {
+                skips++;
+                continue;
+            }
+            mailbox1 = uvec4(mailbox0.w, mailbox1.xyz);
+            mailbox0 = uvec4(tidx, mailbox0.xyz);
+            tests++;
+
+            Triangle triangle = triangles.data[tidx];
+            vec3 t0 = (triangle.min_bounds.xyz - p_from) * inv_dir;
+            vec3 t1 = (triangle.max_bounds.xyz - p_from) * inv_dir;
+            vec3 tmin = min(t0, t1), tmax = max(t0, t1);
+
+            if (max(tmin.x, max(tmin.y, tmin.z)) > min(tmax.x, min(tmax.y, tmax.z))) {
+                continue;
+            }
+
+            vec3 vtx0 = vertices.data[triangle.indices.x].position.xyz;
+            vec3 vtx1 = vertices.data[triangle.indices.y].position.xyz;
+            vec3 vtx2 = vertices.data[triangle.indices.z].position.xyz;
+            float distance;
+            vec3 barycentric;
+
+            if (!RayHitTriangle(p_from, dir, rel_len, vtx0, vtx1, vtx2, distance, barycentric)) {
+                continue;
+            }
+
+            if (any_hit) {
+                AddTraceCounters(cells, tests, skips, true);
+                return RAY_ANY;
+            }
+
+            vec3 normal = normalize(cross((vtx0 - vtx1), (vtx0 - vtx2)));
+            bool backface = dot(normal, dir) >= 0.0;
+            if (TRACE_FRONT_FACE_BIAS && !backface) {
+                distance = max(params.bias, distance - params.bias);
+            }
+
+            // 选择最优距离
+            if (distance < best_distance) {
+                hit = backface ? RAY_BACK : RAY_FRONT;
+                best_distance = distance;
+                isect.hit = true;
+                isect.hit_dist = distance;
+                isect.hit_position = p_from + dir * distance;
+                isect.barycentric = barycentric;
+                isect.tri_idx = tidx;
+                isect.normal = normal;
+                isect.wo = normalize(-dir);
+            }
+        }
+
+        // 最近交点在当前cell之内, 或者光线已经走到终点
+        float exit_t = min(side.x, min(side.y, side.z));
+        if ((hit != RAY_MISS && best_distance <= exit_t * cell_to_world) || icell == iendcell || exit_t >= t_max) {
+            break;
+        }
+
+        bvec3 mask = lessThanEqual(side.xyz, min(side.yzx, side.zxy));
+        side += vec3(mask) * delta;
+        icell += ivec3(vec3(mask)) * step;
+    }
+
+    AddTraceCounters(cells, tests, skips, hit != RAY_MISS);
+    return hit;
+}
+
+// 最近交点查询
+uint TraceRay(vec3 p_from, vec3 p_to, out Interaction isect) {
+    return TraceRayCore(p_from, p_to, false, isect);
+}
+
+// 任意交点查询, 只用于判断遮挡
+uint TraceShadowRay(vec3 p_from, vec3 p_to) {
+    Interaction isect;
+    return TraceRayCore(p_from, p_to, true, isect);
+}
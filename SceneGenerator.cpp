@@ -0,0 +1,363 @@
+#include "SceneGenerator.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <vector>
+
+struct GeneratedMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<uint32_t> indices;
+};
+
+struct GeneratedMaterial {
+    glm::vec3 base_color;
+    glm::vec3 emissive;
+};
+
+struct GeneratedNode {
+    uint32_t mesh;
+    uint32_t material;
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+static uint32_t PcgHash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static float RandomFloat(uint32_t& seed) {
+    seed = PcgHash(seed);
+    return float(seed) / float(0xffffffffu);
+}
+
+// 按(nu + 1) * (nv + 1)的顶点网格添加三角形, 网格沿u, v的叉积方向为正面
+static void AddGridIndices(GeneratedMesh& mesh, uint32_t base, uint32_t nu, uint32_t nv, bool flip) {
+    for (uint32_t j = 0; j < nv; ++j) {
+        for (uint32_t i = 0; i < nu; ++i) {
+            uint32_t a = base + j * (nu + 1) + i;
+            uint32_t b = a + 1;
+            uint32_t c = b + nu + 1;
+            uint32_t d = a + nu + 1;
+            if (flip) {
+                std::swap(b, d);
+            }
+            mesh.indices.insert(mesh.indices.end(), {a, b, c, a, c, d});
+        }
+    }
+}
+
+// 中心在原点, 边长为1的方块, 每个面细分为subdivisions * subdivisions
+static GeneratedMesh GenerateBox(uint32_t subdivisions) {
+    const glm::vec3 face_normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const glm::vec3 face_u[6] = {{0, 0, -1}, {0, 0, 1}, {1, 0, 0}, {1, 0, 0}, {1, 0, 0}, {-1, 0, 0}};
+    const glm::vec3 face_v[6] = {{0, 1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}, {0, 1, 0}, {0, 1, 0}};
+
+    GeneratedMesh mesh;
+    for (uint32_t f = 0; f < 6; ++f) {
+        uint32_t base = (uint32_t)mesh.positions.size();
+        for (uint32_t j = 0; j <= subdivisions; ++j) {
+            for (uint32_t i = 0; i <= subdivisions; ++i) {
+                float s = float(i) / float(subdivisions);
+                float t = float(j) / float(subdivisions);
+                mesh.positions.push_back(face_normals[f] * 0.5f + face_u[f] * (s - 0.5f) + face_v[f] * (t - 0.5f));
+                mesh.normals.push_back(face_normals[f]);
+                mesh.uvs.push_back(glm::vec2(s, t));
+            }
+        }
+        AddGridIndices(mesh, base, subdivisions, subdivisions, false);
+    }
+    return mesh;
+}
+
+// 直径为1的球
+static GeneratedMesh GenerateSphere(uint32_t segments) {
+    uint32_t rings = std::max(segments / 2, 2u);
+    GeneratedMesh mesh;
+    for (uint32_t j = 0; j <= rings; ++j) {
+        float theta = glm::pi<float>() * float(j) / float(rings);
+        for (uint32_t i = 0; i <= segments; ++i) {
+            float phi = glm::two_pi<float>() * float(i) / float(segments);
+            glm::vec3 normal = glm::vec3(glm::sin(theta) * glm::cos(phi), glm::cos(theta), glm::sin(theta) * glm::sin(phi));
+            mesh.positions.push_back(normal * 0.5f);
+            mesh.normals.push_back(normal);
+            mesh.uvs.push_back(glm::vec2(float(i) / float(segments), float(j) / float(rings)));
+        }
+    }
+    // 极点处的四边形退化为一个三角形
+    for (uint32_t j = 0; j < rings; ++j) {
+        for (uint32_t i = 0; i < segments; ++i) {
+            uint32_t a = j * (segments + 1) + i;
+            uint32_t b = a + 1;
+            uint32_t c = b + segments + 1;
+            uint32_t d = a + segments + 1;
+            if (j > 0) {
+                mesh.indices.insert(mesh.indices.end(), {a, b, c});
+            }
+            if (j < rings - 1) {
+                mesh.indices.insert(mesh.indices.end(), {a, c, d});
+            }
+        }
+    }
+    return mesh;
+}
+
+// 外径为1的圆环, 作为体育场中间的高精度物体
+static GeneratedMesh GenerateTorus(uint32_t segments) {
+    const float major_radius = 0.35f;
+    const float minor_radius = 0.15f;
+    uint32_t tube_segments = std::max(segments / 2, 3u);
+    GeneratedMesh mesh;
+    for (uint32_t j = 0; j <= tube_segments; ++j) {
+        float v = glm::two_pi<float>() * float(j) / float(tube_segments);
+        for (uint32_t i = 0; i <= segments; ++i) {
+            float u = glm::two_pi<float>() * float(i) / float(segments);
+            glm::vec3 normal = glm::vec3(glm::cos(v) * glm::cos(u), glm::sin(v), glm::cos(v) * glm::sin(u));
+            glm::vec3 center = glm::vec3(glm::cos(u), 0.0f, glm::sin(u)) * major_radius;
+            mesh.positions.push_back(center + normal * minor_radius);
+            mesh.normals.push_back(normal);
+            mesh.uvs.push_back(glm::vec2(float(i) / float(segments), float(j) / float(tube_segments)));
+        }
+    }
+    AddGridIndices(mesh, 0, segments, tube_segments, true);
+    return mesh;
+}
+
+static glm::quat RotationY(float angle) {
+    return glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+bool ParseSceneLayout(const std::string& name, SceneLayout& layout) {
+    if (name == "clutter") {
+        layout = SCENE_LAYOUT_UNIFORM_CLUTTER;
+    } else if (name == "stadium") {
+        layout = SCENE_LAYOUT_TEAPOT_IN_STADIUM;
+    } else if (name == "city") {
+        layout = SCENE_LAYOUT_CITY_BLOCKS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool GenerateScene(const SceneGeneratorDesc& desc, const std::string& file_path) {
+    // 地面和看台只用不细分的方块, 体育场中三角形集中在中心物体上
+    enum { MESH_BOX, MESH_COARSE_BOX, MESH_SPHERE, MESH_TORUS };
+    std::vector<GeneratedMesh> meshes;
+    meshes.push_back(GenerateBox(std::max(desc.detail / 4, 1u)));
+    meshes.push_back(GenerateBox(1));
+    meshes.push_back(GenerateSphere(std::max(desc.detail, 4u)));
+    meshes.push_back(GenerateTorus(std::max(desc.detail, 4u)));
+
+    // 最后一个材质为自发光
+    std::vector<GeneratedMaterial> materials = {
+        {glm::vec3(0.725f, 0.71f, 0.68f), glm::vec3(0.0f)},
+        {glm::vec3(0.63f, 0.065f, 0.05f), glm::vec3(0.0f)},
+        {glm::vec3(0.14f, 0.45f, 0.091f), glm::vec3(0.0f)},
+        {glm::vec3(0.2f, 0.3f, 0.6f), glm::vec3(0.0f)},
+        {glm::vec3(1.0f), glm::vec3(1.0f)},
+    };
+    uint32_t emissive_material = (uint32_t)materials.size() - 1;
+    uint32_t diffuse_material_count = emissive_material;
+
+    uint32_t seed = desc.seed;
+    float extent = desc.extent;
+    std::vector<GeneratedNode> nodes;
+
+    // 地面
+    nodes.push_back({MESH_COARSE_BOX, 0, glm::vec3(0.0f, -0.5f, 0.0f), glm::quat(1, 0, 0, 0), glm::vec3(extent, 1.0f, extent)});
+
+    if (desc.layout == SCENE_LAYOUT_UNIFORM_CLUTTER) {
+        // 每64个物体中有一个自发光
+        for (uint32_t i = 0; i < desc.object_count; ++i) {
+            uint32_t mesh = RandomFloat(seed) < 0.5f ? MESH_BOX : MESH_SPHERE;
+            uint32_t material = i % 64 == 63 ? emissive_material : uint32_t(RandomFloat(seed) * diffuse_material_count) % diffuse_material_count;
+            glm::vec3 position = glm::vec3(RandomFloat(seed) - 0.5f, RandomFloat(seed) * 0.25f, RandomFloat(seed) - 0.5f) * extent;
+            float size = extent * (0.005f + RandomFloat(seed) * 0.02f);
+            nodes.push_back({mesh, material, position, RotationY(RandomFloat(seed) * glm::two_pi<float>()), glm::vec3(size)});
+        }
+    } else if (desc.layout == SCENE_LAYOUT_TEAPOT_IN_STADIUM) {
+        // 看台由环形排列的方块组成, 每圈一排, 外圈更高
+        const uint32_t tiers = 8;
+        uint32_t blocks_per_tier = std::max(desc.object_count / tiers, 1u);
+        float inner_radius = extent * 0.35f;
+        float tier_depth = extent * 0.015f;
+        for (uint32_t i = 0; i < desc.object_count; ++i) {
+            uint32_t tier = i / blocks_per_tier % tiers;
+            float angle = glm::two_pi<float>() * (float(i % blocks_per_tier) + 0.5f) / float(blocks_per_tier);
+            float radius = inner_radius + float(tier) * tier_depth;
+            float width = glm::two_pi<float>() * radius / float(blocks_per_tier) * 0.95f;
+            float height = tier_depth * float(tier + 1);
+            glm::vec3 position = glm::vec3(glm::cos(angle) * radius, height * 0.5f, glm::sin(angle) * radius);
+            nodes.push_back({MESH_COARSE_BOX, tier % diffuse_material_count, position, RotationY(-angle), glm::vec3(tier_depth, height, width)});
+        }
+
+        // 看台顶部的灯带
+        float roof_radius = inner_radius + float(tiers) * tier_depth;
+        for (uint32_t i = 0; i < 16; ++i) {
+            float angle = glm::two_pi<float>() * float(i) / 16.0f;
+            glm::vec3 position = glm::vec3(glm::cos(angle) * roof_radius, tier_depth * float(tiers + 2), glm::sin(angle) * roof_radius);
+            nodes.push_back({MESH_COARSE_BOX, emissive_material, position, RotationY(-angle), glm::vec3(tier_depth, tier_depth * 0.5f, extent * 0.05f)});
+        }
+
+        // 中心的高精度物体只占场景很小的体积
+        float hero_size = extent * 0.005f;
+        nodes.push_back({MESH_TORUS, 1, glm::vec3(0.0f, hero_size * 0.15f, 0.0f), glm::quat(1, 0, 0, 0), glm::vec3(hero_size)});
+    } else if (desc.layout == SCENE_LAYOUT_CITY_BLOCKS) {
+        // 每个街区2x2栋楼, 街区之间留出街道
+        uint32_t block_count = std::max((desc.object_count + 3) / 4, 1u);
+        uint32_t blocks_per_row = (uint32_t)glm::ceil(glm::sqrt(float(block_count)));
+        float block_size = extent / float(blocks_per_row);
+        float street_width = block_size * 0.2f;
+        float lot_size = (block_size - street_width) * 0.5f;
+        for (uint32_t i = 0; i < desc.object_count; ++i) {
+            uint32_t block = i / 4;
+            uint32_t lot = i % 4;
+            glm::vec2 block_origin = glm::vec2(float(block % blocks_per_row), float(block / blocks_per_row)) * block_size - extent * 0.5f;
+            glm::vec2 lot_center = block_origin + glm::vec2(street_width * 0.5f) + (glm::vec2(float(lot % 2), float(lot / 2)) + 0.5f) * lot_size;
+            float height = lot_size * (1.0f + RandomFloat(seed) * RandomFloat(seed) * 8.0f);
+            glm::vec3 size = glm::vec3(lot_size * 0.9f, height, lot_size * 0.9f);
+            uint32_t material = uint32_t(RandomFloat(seed) * diffuse_material_count) % diffuse_material_count;
+            nodes.push_back({MESH_BOX, material, glm::vec3(lot_center.x, height * 0.5f, lot_center.y), glm::quat(1, 0, 0, 0), size});
+        }
+
+        // 路灯
+        for (uint32_t block = 0; block < block_count; ++block) {
+            glm::vec2 corner = glm::vec2(float(block % blocks_per_row), float(block / blocks_per_row)) * block_size - extent * 0.5f;
+            float lamp_size = street_width * 0.2f;
+            nodes.push_back({MESH_SPHERE, emissive_material, glm::vec3(corner.x, lot_size * 0.5f, corner.y), glm::quat(1, 0, 0, 0), glm::vec3(lamp_size)});
+        }
+    }
+
+    // 写入bin, 每个网格的数据依次为position, normal, uv, index, 都按4字节对齐
+    std::string bin_path = file_path.substr(0, file_path.find_last_of('.')) + ".bin";
+    std::string bin_name = bin_path.substr(bin_path.find_last_of("/\\") + 1);
+    FILE* bin_file = fopen(bin_path.c_str(), "wb");
+    if (!bin_file) {
+        printf("cannot write scene buffer %s\n", bin_path.c_str());
+        return false;
+    }
+
+    struct MeshLayout {
+        size_t offsets[4];
+        size_t sizes[4];
+        bool index_uint16;
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+    std::vector<MeshLayout> layouts(meshes.size());
+    size_t buffer_size = 0;
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const GeneratedMesh& mesh = meshes[m];
+        MeshLayout& layout = layouts[m];
+        layout.index_uint16 = mesh.positions.size() <= 0xffff;
+        layout.min = glm::vec3(FLT_MAX);
+        layout.max = glm::vec3(-FLT_MAX);
+        for (const glm::vec3& position : mesh.positions) {
+            layout.min = glm::min(layout.min, position);
+            layout.max = glm::max(layout.max, position);
+        }
+
+        std::vector<uint16_t> indices16;
+        const void* data[4] = {mesh.positions.data(), mesh.normals.data(), mesh.uvs.data(), mesh.indices.data()};
+        layout.sizes[0] = mesh.positions.size() * sizeof(glm::vec3);
+        layout.sizes[1] = mesh.normals.size() * sizeof(glm::vec3);
+        layout.sizes[2] = mesh.uvs.size() * sizeof(glm::vec2);
+        layout.sizes[3] = mesh.indices.size() * sizeof(uint32_t);
+        if (layout.index_uint16) {
+            indices16.assign(mesh.indices.begin(), mesh.indices.end());
+            data[3] = indices16.data();
+            layout.sizes[3] = indices16.size() * sizeof(uint16_t);
+        }
+
+        for (uint32_t k = 0; k < 4; ++k) {
+            layout.offsets[k] = buffer_size;
+            fwrite(data[k], 1, layout.sizes[k], bin_file);
+            buffer_size += layout.sizes[k];
+            const uint8_t padding[4] = {};
+            size_t padding_size = (4 - buffer_size % 4) % 4;
+            fwrite(padding, 1, padding_size, bin_file);
+            buffer_size += padding_size;
+        }
+    }
+    fclose(bin_file);
+
+    FILE* file = fopen(file_path.c_str(), "w");
+    if (!file) {
+        printf("cannot write scene %s\n", file_path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n  \"asset\": {\"version\": \"2.0\", \"generator\": \"Lightmapper SceneGenerator\"},\n");
+    fprintf(file, "  \"buffers\": [{\"uri\": \"%s\", \"byteLength\": %zu}],\n", bin_name.c_str(), buffer_size);
+
+    // 每个网格4个buffer view和4个accessor
+    fprintf(file, "  \"bufferViews\": [");
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        for (uint32_t k = 0; k < 4; ++k) {
+            fprintf(file, "%s\n    {\"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu, \"target\": %d}",
+                    m + k > 0 ? "," : "", layouts[m].offsets[k], layouts[m].sizes[k], k < 3 ? 34962 : 34963);
+        }
+    }
+    fprintf(file, "\n  ],\n  \"accessors\": [");
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const MeshLayout& layout = layouts[m];
+        uint32_t view = uint32_t(m * 4);
+        size_t vertex_count = meshes[m].positions.size();
+        fprintf(file, "%s\n    {\"bufferView\": %u, \"componentType\": 5126, \"count\": %zu, \"type\": \"VEC3\", \"min\": [%g, %g, %g], \"max\": [%g, %g, %g]}",
+                m > 0 ? "," : "", view, vertex_count, layout.min.x, layout.min.y, layout.min.z, layout.max.x, layout.max.y, layout.max.z);
+        fprintf(file, ",\n    {\"bufferView\": %u, \"componentType\": 5126, \"count\": %zu, \"type\": \"VEC3\"}", view + 1, vertex_count);
+        fprintf(file, ",\n    {\"bufferView\": %u, \"componentType\": 5126, \"count\": %zu, \"type\": \"VEC2\"}", view + 2, vertex_count);
+        fprintf(file, ",\n    {\"bufferView\": %u, \"componentType\": %d, \"count\": %zu, \"type\": \"SCALAR\"}",
+                view + 3, layout.index_uint16 ? 5123 : 5125, meshes[m].indices.size());
+    }
+
+    fprintf(file, "\n  ],\n  \"materials\": [");
+    for (size_t i = 0; i < materials.size(); ++i) {
+        const GeneratedMaterial& material = materials[i];
+        fprintf(file, "%s\n    {\"pbrMetallicRoughness\": {\"baseColorFactor\": [%g, %g, %g, 1], \"metallicFactor\": 0}, \"emissiveFactor\": [%g, %g, %g]}",
+                i > 0 ? "," : "", material.base_color.r, material.base_color.g, material.base_color.b, material.emissive.r, material.emissive.g, material.emissive.b);
+    }
+
+    // 材质绑定在primitive上, 每种网格和材质的组合对应一个mesh, 共享accessor
+    fprintf(file, "\n  ],\n  \"meshes\": [");
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        for (size_t i = 0; i < materials.size(); ++i) {
+            uint32_t accessor = uint32_t(m * 4);
+            fprintf(file, "%s\n    {\"primitives\": [{\"attributes\": {\"POSITION\": %u, \"NORMAL\": %u, \"TEXCOORD_0\": %u}, \"indices\": %u, \"material\": %zu}]}",
+                    m + i > 0 ? "," : "", accessor, accessor + 1, accessor + 2, accessor + 3, i);
+        }
+    }
+
+    fprintf(file, "\n  ],\n  \"nodes\": [");
+    uint64_t triangle_count = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const GeneratedNode& node = nodes[i];
+        triangle_count += meshes[node.mesh].indices.size() / 3;
+        fprintf(file, "%s\n    {\"mesh\": %zu, \"translation\": [%g, %g, %g], \"rotation\": [%g, %g, %g, %g], \"scale\": [%g, %g, %g]}",
+                i > 0 ? "," : "", node.mesh * materials.size() + node.material,
+                node.translation.x, node.translation.y, node.translation.z,
+                node.rotation.x, node.rotation.y, node.rotation.z, node.rotation.w,
+                node.scale.x, node.scale.y, node.scale.z);
+    }
+
+    fprintf(file, "\n  ],\n  \"scenes\": [{\"nodes\": [");
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        fprintf(file, "%s%zu", i > 0 ? ", " : "", i);
+    }
+    fprintf(file, "]}],\n  \"scene\": 0\n}\n");
+    fclose(file);
+
+    printf("generated scene %s: %zu objects, %llu triangles\n", file_path.c_str(), nodes.size(), (unsigned long long)triangle_count);
+    return true;
+}
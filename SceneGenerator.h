@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// 程序化生成的场景布局, 用于在大规模场景下测试加速结构, atlas和烘焙调度
+enum SceneLayout {
+    // 包围盒内随机分布的方块和球
+    SCENE_LAYOUT_UNIFORM_CLUTTER,
+    // 巨大的体育场中间放一个高精度的小物体, 三角形分布极不均匀
+    SCENE_LAYOUT_TEAPOT_IN_STADIUM,
+    // 街区网格上的密集楼房
+    SCENE_LAYOUT_CITY_BLOCKS,
+};
+
+struct SceneGeneratorDesc {
+    SceneLayout layout = SCENE_LAYOUT_UNIFORM_CLUTTER;
+    // clutter的物体数, 体育场的看台块数, 城市的楼房数
+    uint32_t object_count = 1000;
+    // 曲面的分段数, clutter和城市中的方块每条边细分detail / 4段
+    uint32_t detail = 16;
+    // 场景的水平尺寸
+    float extent = 100.0f;
+    uint32_t seed = 1;
+};
+
+// 写出gltf和同名的bin文件, 可以直接用ImportScene读取
+bool GenerateScene(const SceneGeneratorDesc& desc, const std::string& file_path);
+
+// 按名称解析布局: clutter, stadium, city
+bool ParseSceneLayout(const std::string& name, SceneLayout& layout);
@@ -0,0 +1,340 @@
+#include "ShardBake.h"
+#include "BakeCache.h"
+#include "Builder.h"
+#include "Parallel.h"
+#include "Stats.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static const uint32_t SHARD_FILE_MAGIC = 0x44524853;
+static const uint32_t SHARD_FILE_VERSION = 2;
+
+enum ShardFileType {
+    SHARD_FILE_SCENE = 0,
+    SHARD_FILE_STATE,
+    SHARD_FILE_RESULT,
+};
+
+template <typename T>
+static void WriteValue(FILE* file, const T& value) {
+    fwrite(&value, sizeof(T), 1, file);
+}
+
+template <typename T>
+static bool ReadValue(FILE* file, T& value) {
+    return fread(&value, sizeof(T), 1, file) == 1;
+}
+
+static FILE* OpenShardFile(const std::string& file_path, ShardFileType type, bool write) {
+    FILE* file = fopen(file_path.c_str(), write ? "wb" : "rb");
+    if (file == nullptr) {
+        printf("cannot %s shard file %s\n", write ? "write" : "read", file_path.c_str());
+        return nullptr;
+    }
+
+    uint32_t header[3] = {SHARD_FILE_MAGIC, SHARD_FILE_VERSION, (uint32_t)type};
+    if (write) {
+        fwrite(header, sizeof(header), 1, file);
+        return file;
+    }
+
+    uint32_t file_header[3] = {};
+    if (fread(file_header, sizeof(file_header), 1, file) != 1 || file_header[0] != header[0] || file_header[1] != header[1] || file_header[2] != header[2]) {
+        printf("invalid shard file %s\n", file_path.c_str());
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
+static bool CloseShardFile(const std::string& file_path, FILE* file, bool valid) {
+    valid = valid && ferror(file) == 0;
+    if (fclose(file) != 0 || !valid) {
+        printf("cannot access shard file %s\n", file_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+uint32_t GetShardTileOwner(uint32_t x, uint32_t y, uint32_t width, uint32_t tile_size, uint32_t shard_count) {
+    uint32_t tiles_x = (width + tile_size - 1) / tile_size;
+    return ((y / tile_size) * tiles_x + x / tile_size) % shard_count;
+}
+
+bool SaveShardScene(const std::string& file_path, const AccelerationStructures* as, const std::vector<Light>& lights, const CpuBakeParams& params,
+                    const ShardGBuffer& gbuffer) {
+    FILE* file = OpenShardFile(file_path, SHARD_FILE_SCENE, true);
+    if (file == nullptr) {
+        return false;
+    }
+
+    // worker只计算光照, 路径, 降噪和导出参数由协调进程使用, 不需要写入
+    WriteValue(file, params.width);
+    WriteValue(file, params.height);
+    WriteValue(file, params.ray_count);
+    WriteValue(file, params.bounces);
+    WriteValue(file, params.path_continuation);
+    WriteValue(file, params.max_light_samples);
+    WriteValue(file, params.emissive_light_samples);
+    WriteValue(file, params.ray_iterations);
+    WriteValue(file, params.min_iterations);
+    WriteValue(file, params.error_threshold);
+    WriteValue(file, params.bias);
+    WriteValue(file, params.light_format);
+    WriteValue(file, params.shard_count);
+    WriteValue(file, params.shard_tile_size);
+    WriteVector(file, lights);
+
+    WriteValue(file, as->bounds);
+    WriteVector(file, as->vertices);
+    WriteVector(file, as->triangles);
+    WriteVector(file, as->mesh_triangle_offsets);
+    WriteVector(file, as->seams);
+    WriteVector(file, as->triangle_indices);
+    WriteVector(file, as->grid_indices);
+    WriteVector(file, as->light_indices);
+    WriteVector(file, as->light_grid);
+    WriteVector(file, as->triangle_materials);
+    WriteVector(file, as->emissive_lights);
+    WriteValue(file, as->albedo_width);
+    WriteValue(file, as->albedo_height);
+    WriteVector(file, as->albedo_atlas);
+    WriteValue(file, as->environment_info);
+    WriteVector(file, as->environment_map);
+    WriteVector(file, as->environment_cdf);
+
+    WriteVector(file, gbuffer.texels);
+    WriteVector(file, gbuffer.normal_data);
+    return CloseShardFile(file_path, file, true);
+}
+
+AccelerationStructures* LoadShardScene(const std::string& file_path, std::vector<Light>& lights, CpuBakeParams& params, ShardGBuffer& gbuffer) {
+    FILE* file = OpenShardFile(file_path, SHARD_FILE_SCENE, false);
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    AccelerationStructures* as = new AccelerationStructures();
+    bool valid = ReadValue(file, params.width) && ReadValue(file, params.height) && ReadValue(file, params.ray_count) &&
+                 ReadValue(file, params.bounces) && ReadValue(file, params.path_continuation) &&
+                 ReadValue(file, params.max_light_samples) && ReadValue(file, params.emissive_light_samples) &&
+                 ReadValue(file, params.ray_iterations) && ReadValue(file, params.min_iterations) &&
+                 ReadValue(file, params.error_threshold) && ReadValue(file, params.bias) && ReadValue(file, params.light_format) &&
+                 ReadValue(file, params.shard_count) && ReadValue(file, params.shard_tile_size) && ReadVector(file, lights);
+    valid = valid && ReadValue(file, as->bounds) && ReadVector(file, as->vertices) && ReadVector(file, as->triangles) &&
+            ReadVector(file, as->mesh_triangle_offsets) && ReadVector(file, as->seams) && ReadVector(file, as->triangle_indices) &&
+            ReadVector(file, as->grid_indices) && ReadVector(file, as->light_indices) && ReadVector(file, as->light_grid) &&
+            ReadVector(file, as->triangle_materials) && ReadVector(file, as->emissive_lights) &&
+            ReadValue(file, as->albedo_width) && ReadValue(file, as->albedo_height) && ReadVector(file, as->albedo_atlas) &&
+            ReadValue(file, as->environment_info) && ReadVector(file, as->environment_map) && ReadVector(file, as->environment_cdf);
+    valid = valid && ReadVector(file, gbuffer.texels) && ReadVector(file, gbuffer.normal_data) &&
+            gbuffer.normal_data.size() == params.width * params.height;
+    if (!CloseShardFile(file_path, file, valid)) {
+        SAFE_DELETE(as);
+    }
+    return as;
+}
+
+static bool SaveShardState(const std::string& file_path, const ShardBakeState& state) {
+    FILE* file = OpenShardFile(file_path, SHARD_FILE_STATE, true);
+    if (file == nullptr) {
+        return false;
+    }
+    WriteVector(file, state.light);
+    WriteVector(file, state.sh_light_map);
+    WriteVector(file, state.light_variance);
+    return CloseShardFile(file_path, file, true);
+}
+
+static bool LoadShardState(const std::string& file_path, ShardBakeState& state) {
+    FILE* file = OpenShardFile(file_path, SHARD_FILE_STATE, false);
+    if (file == nullptr) {
+        return false;
+    }
+    bool valid = ReadVector(file, state.light) && ReadVector(file, state.sh_light_map) && ReadVector(file, state.light_variance);
+    return CloseShardFile(file_path, file, valid);
+}
+
+static bool SaveShardPassResult(const std::string& file_path, const ShardPassResult& result) {
+    FILE* file = OpenShardFile(file_path, SHARD_FILE_RESULT, true);
+    if (file == nullptr) {
+        return false;
+    }
+    WriteVector(file, result.texel_indices);
+    WriteVector(file, result.light);
+    WriteVector(file, result.sh_light_map);
+    WriteVector(file, result.light_variance);
+    WriteValue(file, result.rays_cast);
+    return CloseShardFile(file_path, file, true);
+}
+
+static bool LoadShardPassResult(const std::string& file_path, ShardPassResult& result) {
+    FILE* file = OpenShardFile(file_path, SHARD_FILE_RESULT, false);
+    if (file == nullptr) {
+        return false;
+    }
+    bool valid = ReadVector(file, result.texel_indices) && ReadVector(file, result.light) &&
+                 ReadVector(file, result.sh_light_map) && ReadVector(file, result.light_variance) && ReadValue(file, result.rays_cast);
+    valid = valid && result.light.size() == result.texel_indices.size() && result.sh_light_map.size() == result.texel_indices.size() * 4 &&
+            result.light_variance.size() == result.texel_indices.size();
+    return CloseShardFile(file_path, file, valid);
+}
+
+int RunShardWorker(const std::string& scene_path, const std::string& state_path, uint32_t pass, uint32_t shard_index,
+                   uint32_t thread_count, const std::string& output_path) {
+    GetWorkerCountLimit() = thread_count;
+
+    std::vector<Light> lights;
+    CpuBakeParams params;
+    ShardGBuffer gbuffer;
+    AccelerationStructures* as = LoadShardScene(scene_path, lights, params, gbuffer);
+    if (as == nullptr) {
+        return 1;
+    }
+    params.shard_index = shard_index;
+    // 合并在协调进程中进行, worker不降噪, 不扩展也不导出
+    params.dilate_radius = 0;
+
+    ShardBakeState state;
+    ShardPassResult result;
+    bool success = LoadShardState(state_path, state);
+    if (success) {
+        CpuBaker baker(as, lights, params);
+        baker.BakeShardPass(pass, gbuffer, state, result);
+        success = SaveShardPassResult(output_path, result);
+    }
+    SAFE_DELETE(as);
+    return success ? 0 : 1;
+}
+
+std::string GetShardFilePrefix(const std::string& directory) {
+    std::string prefix = directory;
+    if (prefix.empty()) {
+#ifdef _WIN32
+        const char* temp_dir = getenv("TEMP");
+        const char* default_dir = ".";
+#else
+        const char* temp_dir = getenv("TMPDIR");
+        const char* default_dir = "/tmp";
+#endif
+        prefix = temp_dir != nullptr && temp_dir[0] != '\0' ? temp_dir : default_dir;
+    }
+    if (prefix.back() != '/' && prefix.back() != '\\') {
+        prefix += '/';
+    }
+    uint64_t timestamp = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return prefix + "lightmap_bake_" + std::to_string(timestamp);
+}
+
+static std::string GetShardResultPath(const std::string& file_prefix, uint32_t shard_index) {
+    return file_prefix + ".shard" + std::to_string(shard_index);
+}
+
+bool RunShardedBake(const std::string& executable, const std::string& file_prefix, const AccelerationStructures* as,
+                    const std::vector<Light>& lights, const CpuBakeParams& params) {
+    CpuBakeParams shard_params = params;
+    shard_params.shard_count = glm::max(1u, params.shard_count);
+    shard_params.shard_tile_size = glm::max(1u, params.shard_tile_size);
+    if (!shard_params.light_groups.empty() || !shard_params.cache_path.empty()) {
+        printf("sharded bake does not support light groups or the bake cache, they are ignored\n");
+        shard_params.light_groups.clear();
+        shard_params.cache_path.clear();
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bool collect_stats = !shard_params.stats_report.empty();
+    CpuBaker baker(as, lights, shard_params);
+    BakeStats* stats_ptr = collect_stats ? &baker.GetStats() : nullptr;
+
+    // G-buffer只在协调进程计算一次, 随场景文件发给每个pass的所有worker
+    ShardGBuffer gbuffer;
+    baker.PrepareShardGBuffer();
+    gbuffer.texels = baker.GetTexels();
+    gbuffer.normal_data = baker.GetNormalData();
+
+    std::string scene_path = file_prefix + ".scene";
+    std::string state_path = file_prefix + ".state";
+    if (!SaveShardScene(scene_path, as, lights, shard_params, gbuffer)) {
+        return false;
+    }
+
+    uint32_t texel_count = params.width * params.height;
+    ShardBakeState state;
+    state.light.assign(texel_count, glm::vec4(0.0f));
+    state.sh_light_map.assign(texel_count * 4, glm::vec4(0.0f));
+    state.light_variance.assign(texel_count, 0.0f);
+
+    // 同一台机器上的worker平分硬件线程
+    uint32_t thread_count = glm::max(1u, GetWorkerCount() / shard_params.shard_count);
+    uint32_t pass_count = 1 + (shard_params.path_continuation ? 1 : shard_params.bounces);
+    uint64_t rays_cast = 0;
+    bool success = true;
+    for (uint32_t pass = 0; pass < pass_count && success; ++pass) {
+        std::string pass_name = pass == 0 ? "direct_pass" : "bounce_pass" + std::to_string(pass - 1);
+        ScopedTimer timer("sharded bake", pass_name.c_str(), stats_ptr);
+        success = SaveShardState(state_path, state);
+
+        std::vector<int> exit_codes(shard_params.shard_count, 0);
+        std::vector<std::thread> workers;
+        for (uint32_t shard = 0; success && shard < shard_params.shard_count; ++shard) {
+            std::string command = "\"" + executable + "\" --bake-shard \"" + scene_path + "\" \"" + state_path + "\" " +
+                                  std::to_string(pass) + " " + std::to_string(shard) + " " + std::to_string(thread_count) +
+                                  " \"" + GetShardResultPath(file_prefix, shard) + "\"";
+#ifdef _WIN32
+            // cmd会去掉整条命令最外层的引号
+            command = "\"" + command + "\"";
+#endif
+            workers.emplace_back([command, shard, &exit_codes]() { exit_codes[shard] = std::system(command.c_str()); });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        // 按分片顺序合并, 每个纹素只属于一个分片, 合并结果与worker的完成顺序无关
+        for (uint32_t shard = 0; success && shard < shard_params.shard_count; ++shard) {
+            ShardPassResult result;
+            if (exit_codes[shard] != 0 || !LoadShardPassResult(GetShardResultPath(file_prefix, shard), result)) {
+                printf("shard %u failed in pass %u\n", shard, pass);
+                success = false;
+                break;
+            }
+            rays_cast += result.rays_cast;
+
+            for (uint32_t t = 0; t < result.texel_indices.size(); ++t) {
+                uint32_t idx = result.texel_indices[t];
+                if (idx >= texel_count) {
+                    success = false;
+                    break;
+                }
+                state.light[idx] = result.light[t];
+                for (uint32_t j = 0; j < 4; ++j) {
+                    state.sh_light_map[j * texel_count + idx] = result.sh_light_map[t * 4 + j];
+                }
+                state.light_variance[idx] = result.light_variance[t];
+            }
+        }
+    }
+
+    if (success) {
+        baker.FinishShardedBake(state);
+    }
+    if (success && collect_stats) {
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        stats_ptr->AddTiming("total", elapsed.count() * 1000.0);
+        stats_ptr->AddCounter("texels", gbuffer.texels.size());
+        stats_ptr->AddCounter("shards", shard_params.shard_count);
+        stats_ptr->AddCounter("bounce_rays", rays_cast);
+        stats_ptr->AddValue("bounce_rays_per_second", rays_cast / elapsed.count());
+        stats_ptr->WriteJson(shard_params.stats_report);
+    }
+
+    remove(scene_path.c_str());
+    remove(state_path.c_str());
+    for (uint32_t shard = 0; shard < shard_params.shard_count; ++shard) {
+        remove(GetShardResultPath(file_prefix, shard).c_str());
+    }
+    return success;
+}
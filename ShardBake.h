@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CpuBaker.h"
+
+#include <string>
+#include <vector>
+
+// 分片烘焙: 协调进程把加速结构, 灯光, 烘焙参数和G-buffer序列化到场景文件, 逐个pass启动worker进程,
+// 每个worker只计算分给自己的tile中的纹素, pass结束后协调进程按纹素合并结果再开始下一个pass.
+// 每个纹素只由一个分片计算且随机序列只与纹素有关, 合并结果与单进程烘焙逐位相同, 与分片数无关
+
+// 协调进程光栅化并unocclude一次的整张atlas的纹素列表, worker只取出分给自己的tile
+// normal_data的w为三角形序号, 直接光照读取纹素自身的自发光时使用
+struct ShardGBuffer {
+    std::vector<TexelData> texels;
+    std::vector<glm::vec4> normal_data;
+};
+
+// 上一个pass合并后的整张atlas, light为该pass写入的光照, 4层SH按层依次存放
+struct ShardBakeState {
+    std::vector<glm::vec4> light;
+    std::vector<glm::vec4> sh_light_map;
+    std::vector<float> light_variance;
+};
+
+// 一个分片在一个pass中计算的纹素, sh_light_map每个纹素连续存放4层
+struct ShardPassResult {
+    std::vector<uint32_t> texel_indices;
+    std::vector<glm::vec4> light;
+    std::vector<glm::vec4> sh_light_map;
+    std::vector<float> light_variance;
+    // 弹射pass中追踪的收集光线数, 写入统计报告
+    uint64_t rays_cast = 0;
+};
+
+// 纹素所在tile按行优先编号后对分片数取模
+uint32_t GetShardTileOwner(uint32_t x, uint32_t y, uint32_t width, uint32_t tile_size, uint32_t shard_count);
+
+bool SaveShardScene(const std::string& file_path, const AccelerationStructures* as, const std::vector<Light>& lights, const CpuBakeParams& params,
+                    const ShardGBuffer& gbuffer);
+
+// 失败时返回nullptr
+AccelerationStructures* LoadShardScene(const std::string& file_path, std::vector<Light>& lights, CpuBakeParams& params, ShardGBuffer& gbuffer);
+
+// 中间文件的前缀, directory为空时使用系统临时目录, 文件名带时间戳, 同时运行的多个烘焙互不影响
+std::string GetShardFilePrefix(const std::string& directory);
+
+// worker进程入口, 由Lightmapper --bake-shard调用, 返回进程退出码
+int RunShardWorker(const std::string& scene_path, const std::string& state_path, uint32_t pass, uint32_t shard_index,
+                   uint32_t thread_count, const std::string& output_path);
+
+// 协调进程, executable为worker进程的可执行文件, 中间文件以file_prefix为前缀, 烘焙结束后删除
+// params.stats_report不为空时写出G-buffer, 各个pass, 降噪和导出的耗时以及worker追踪的弹射光线数
+bool RunShardedBake(const std::string& executable, const std::string& file_prefix, const AccelerationStructures* as,
+                    const std::vector<Light>& lights, const CpuBakeParams& params);
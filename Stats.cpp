@@ -0,0 +1,66 @@
+#include "Stats.h"
+
+#include <cmath>
+#include <cstdio>
+
+void BakeStats::AddTiming(const std::string& name, double ms) {
+    timings.emplace_back(name, ms);
+}
+
+void BakeStats::AddCounter(const std::string& name, uint64_t value) {
+    counters.emplace_back(name, value);
+}
+
+void BakeStats::AddValue(const std::string& name, double value) {
+    values.emplace_back(name, value);
+}
+
+void BakeStats::AddTraceCounters(const std::string& prefix, const TraceCounters& trace_counters) {
+    AddCounter(prefix + "rays", trace_counters.rays);
+    AddCounter(prefix + "cells_visited", trace_counters.cells_visited);
+    AddCounter(prefix + "triangle_tests", trace_counters.triangle_tests);
+    AddCounter(prefix + "mailbox_skips", trace_counters.mailbox_skips);
+    AddCounter(prefix + "hits", trace_counters.hits);
+}
+
+bool BakeStats::WriteJson(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        printf("cannot write stats report %s\n", path.c_str());
+        return false;
+    }
+
+    // 名称都是代码中的常量, 不需要转义
+    fprintf(file, "{\n  \"timings_ms\": {");
+    for (size_t i = 0; i < timings.size(); ++i) {
+        fprintf(file, "%s\n    \"%s\": %.3f", i > 0 ? "," : "", timings[i].first.c_str(), timings[i].second);
+    }
+    fprintf(file, "\n  },\n  \"counters\": {");
+    for (size_t i = 0; i < counters.size(); ++i) {
+        fprintf(file, "%s\n    \"%s\": %llu", i > 0 ? "," : "", counters[i].first.c_str(), (unsigned long long)counters[i].second);
+    }
+    fprintf(file, "\n  },\n  \"values\": {");
+    for (size_t i = 0; i < values.size(); ++i) {
+        // JSON没有inf和nan, 非有限值写成null
+        if (std::isfinite(values[i].second)) {
+            fprintf(file, "%s\n    \"%s\": %.6g", i > 0 ? "," : "", values[i].first.c_str(), values[i].second);
+        } else {
+            fprintf(file, "%s\n    \"%s\": null", i > 0 ? "," : "", values[i].first.c_str());
+        }
+    }
+    fprintf(file, "\n  }\n}\n");
+    fclose(file);
+    return true;
+}
+
+ScopedTimer::ScopedTimer(const char* category, const char* name, BakeStats* stats)
+    : category(category), name(name), stats(stats), start(std::chrono::high_resolution_clock::now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    printf("%s %s: %.2f ms\n", category, name, elapsed.count());
+    if (stats) {
+        stats->AddTiming(name, elapsed.count());
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 光线遍历的计数器, Tracer在开启统计时累计
+struct TraceCounters {
+    uint64_t rays = 0;
+    uint64_t cells_visited = 0;
+    uint64_t triangle_tests = 0;
+    uint64_t mailbox_skips = 0;
+    uint64_t hits = 0;
+};
+
+// 一次烘焙的统计数据, 烘焙结束后写成json报告
+class BakeStats {
+public:
+    void AddTiming(const std::string& name, double ms);
+
+    void AddCounter(const std::string& name, uint64_t value);
+
+    void AddValue(const std::string& name, double value);
+
+    void AddTraceCounters(const std::string& prefix, const TraceCounters& counters);
+
+    bool WriteJson(const std::string& path) const;
+
+private:
+    std::vector<std::pair<std::string, double>> timings;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::vector<std::pair<std::string, double>> values;
+};
+
+// 打印作用域耗时, stats不为空时以name为key记录到报告中
+class ScopedTimer {
+public:
+    ScopedTimer(const char* category, const char* name, BakeStats* stats = nullptr);
+
+    ~ScopedTimer();
+
+private:
+    const char* category;
+    const char* name;
+    BakeStats* stats;
+    std::chrono::high_resolution_clock::time_point start;
+};
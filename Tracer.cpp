@@ -0,0 +1,223 @@
+#include "Tracer.h"
+#include "Builder.h"
+
+static bool RayHitTriangle(const glm::vec3& from, const glm::vec3& dir, float max_dist, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float& r_distance, glm::vec3& r_barycentric) {
+    const float EPSILON = 0.00001f;
+    const glm::vec3 e0 = p1 - p0;
+    const glm::vec3 e1 = p0 - p2;
+    glm::vec3 triangle_normal = glm::cross(e1, e0);
+
+    float n_dot_dir = glm::dot(triangle_normal, dir);
+
+    if (glm::abs(n_dot_dir) < EPSILON) {
+        return false;
+    }
+
+    const glm::vec3 e2 = (p0 - from) / n_dot_dir;
+    const glm::vec3 i = glm::cross(dir, e2);
+
+    r_barycentric.y = glm::dot(i, e1);
+    r_barycentric.z = glm::dot(i, e0);
+    r_barycentric.x = 1.0f - (r_barycentric.z + r_barycentric.y);
+    r_distance = glm::dot(triangle_normal, e2);
+
+    return (r_distance > 0.0f) && (r_distance < max_dist) && r_barycentric.x >= 0.0f && r_barycentric.y >= 0.0f && r_barycentric.z >= 0.0f;
+}
+
+// 网格DDA遍历的状态
+struct GridWalker {
+    glm::ivec3 icell;
+    glm::ivec3 iendcell;
+    glm::ivec3 step;
+    glm::vec3 delta;
+    glm::vec3 side;
+
+    // cell空间中的光线长度
+    float t_max;
+
+    GridWalker(const glm::vec3& from_cell, const glm::vec3& to_cell) {
+        glm::vec3 rel_cell = to_cell - from_cell;
+        t_max = glm::length(rel_cell);
+        glm::vec3 dir_cell = rel_cell / t_max;
+        glm::vec3 sign_cell = glm::sign(rel_cell);
+        icell = glm::ivec3(from_cell);
+        iendcell = glm::ivec3(to_cell);
+        delta = glm::min(glm::abs(1.0f / dir_cell), glm::vec3(float(MAX_GRID_SIZE)));
+        step = glm::ivec3(sign_cell);
+        side = (sign_cell * (glm::vec3(icell) - from_cell) + (sign_cell * 0.5f) + 0.5f) * delta;
+    }
+
+    // 每一步都跨过一个cell的边界, 穿过整个网格不会超过3 * MAX_GRID_SIZE步
+    // 方向为NaN或长度为0时cell不会前进, 用这个上限防止死循环
+    static const uint32_t MAX_STEPS = 3 * MAX_GRID_SIZE;
+
+    bool Inside() const {
+        return icell.x >= 0 && icell.y >= 0 && icell.z >= 0 && icell.x < MAX_GRID_SIZE && icell.y < MAX_GRID_SIZE && icell.z < MAX_GRID_SIZE;
+    }
+
+    // 离开当前cell时在cell空间中走过的距离
+    float ExitT() const {
+        return glm::min(side.x, glm::min(side.y, side.z));
+    }
+
+    void Next() {
+        glm::bvec3 mask;
+        mask.x = side.x <= glm::min(side.y, side.z);
+        mask.y = side.y <= glm::min(side.z, side.x);
+        mask.z = side.z <= glm::min(side.x, side.y);
+        side += glm::vec3(mask) * delta;
+        icell += glm::ivec3(mask) * step;
+    }
+
+    uint32_t CellIndex() const {
+        return icell.x + (icell.y * MAX_GRID_SIZE) + (icell.z * MAX_GRID_SIZE * MAX_GRID_SIZE);
+    }
+};
+
+Tracer::Tracer(const AccelerationStructures* as, float bias) {
+    this->as = as;
+    this->bias = bias;
+    bound_size = as->bounds.GetSize();
+    to_cell_offset = as->bounds.min;
+    to_cell_size = (1.0f / bound_size) * float(MAX_GRID_SIZE);
+}
+
+TraceCounters Tracer::GetCounters() const {
+    TraceCounters counters;
+    counters.rays = rays.load();
+    counters.cells_visited = cells_visited.load();
+    counters.triangle_tests = triangle_tests.load();
+    counters.mailbox_skips = mailbox_skips.load();
+    counters.hits = hits.load();
+    return counters;
+}
+
+void Tracer::ResetCounters() {
+    rays = 0;
+    cells_visited = 0;
+    triangle_tests = 0;
+    mailbox_skips = 0;
+    hits = 0;
+}
+
+void Tracer::AddCounters(uint32_t cells, uint32_t tests, uint32_t skips, bool hit) const {
+    rays.fetch_add(1, std::memory_order_relaxed);
+    cells_visited.fetch_add(cells, std::memory_order_relaxed);
+    triangle_tests.fetch_add(tests, std::memory_order_relaxed);
+    mailbox_skips.fetch_add(skips, std::memory_order_relaxed);
+    hits.fetch_add(hit ? 1 : 0, std::memory_order_relaxed);
+}
+
+uint32_t Tracer::TraceRay(const glm::vec3& from, const glm::vec3& to, Interaction& isect) const {
+    return Trace<false>(from, to, isect);
+}
+
+uint32_t Tracer::TraceShadowRay(const glm::vec3& from, const glm::vec3& to) const {
+    Interaction isect;
+    return Trace<true>(from, to, isect);
+}
+
+// 最近交点与任意交点共用的遍历, any_hit时遇到第一个交点就返回, 不计算法线和交点信息
+// 跨cell的三角形可能在后面的cell中才被命中, 最近交点只有在当前cell的出口之前才能返回
+template <bool any_hit>
+uint32_t Tracer::Trace(const glm::vec3& from, const glm::vec3& to, Interaction& isect) const {
+    glm::vec3 rel = to - from;
+    float rel_len = glm::length(rel);
+    glm::vec3 dir = glm::normalize(rel);
+    glm::vec3 inv_dir = 1.0f / dir;
+    GridWalker walker((from - to_cell_offset) * to_cell_size, (to - to_cell_offset) * to_cell_size);
+    float cell_to_world = rel_len / walker.t_max;
+
+    uint32_t mailbox[MAILBOX_SIZE];
+    for (uint32_t i = 0; i < MAILBOX_SIZE; i++) {
+        mailbox[i] = UINT32_MAX;
+    }
+    uint32_t mailbox_next = 0;
+    uint32_t cells = 0;
+    uint32_t tests = 0;
+    uint32_t skips = 0;
+
+    uint32_t hit = RAY_MISS;
+    float best_distance = 1e20f;
+    isect.hit = false;
+
+    while (walker.Inside() && cells < GridWalker::MAX_STEPS) {
+        cells++;
+        uint32_t cell = walker.CellIndex();
+        uint32_t cell_count = as->grid_indices[cell * 2];
+        uint32_t cell_offset = as->grid_indices[cell * 2 + 1];
+        for (uint32_t i = 0; i < cell_count; i++) {
+            uint32_t tidx = as->triangle_indices[cell_offset + i];
+
+            bool tested = false;
+            for (uint32_t j = 0; j < MAILBOX_SIZE; j++) {
+                tested |= mailbox[j] == tidx;
+            }
+            if (tested) {
+                skips++;
+                continue;
+            }
+            mailbox[mailbox_next] = tidx;
+            mailbox_next = (mailbox_next + 1) % MAILBOX_SIZE;
+            tests++;
+
+            const Triangle& triangle = as->triangles[tidx];
+            glm::vec3 t0 = (glm::vec3(triangle.min_bounds[0], triangle.min_bounds[1], triangle.min_bounds[2]) - from) * inv_dir;
+            glm::vec3 t1 = (glm::vec3(triangle.max_bounds[0], triangle.max_bounds[1], triangle.max_bounds[2]) - from) * inv_dir;
+            glm::vec3 tmin = glm::min(t0, t1), tmax = glm::max(t0, t1);
+
+            if (glm::max(tmin.x, glm::max(tmin.y, tmin.z)) > glm::min(tmax.x, glm::min(tmax.y, tmax.z))) {
+                continue;
+            }
+
+            glm::vec3 vtx0 = as->vertices[triangle.indices[0]].position;
+            glm::vec3 vtx1 = as->vertices[triangle.indices[1]].position;
+            glm::vec3 vtx2 = as->vertices[triangle.indices[2]].position;
+            float distance;
+            glm::vec3 barycentric;
+
+            if (!RayHitTriangle(from, dir, rel_len, vtx0, vtx1, vtx2, distance, barycentric)) {
+                continue;
+            }
+
+            if (any_hit) {
+                if (stats_enabled) {
+                    AddCounters(cells, tests, skips, true);
+                }
+                return RAY_ANY;
+            }
+
+            glm::vec3 normal = glm::normalize(glm::cross((vtx0 - vtx1), (vtx0 - vtx2)));
+            bool backface = glm::dot(normal, dir) >= 0.0f;
+            if (!backface) {
+                distance = glm::max(bias, distance - bias);
+            }
+
+            // 选择最优距离
+            if (distance < best_distance) {
+                hit = backface ? RAY_BACK : RAY_FRONT;
+                best_distance = distance;
+                isect.hit = true;
+                isect.hit_dist = distance;
+                isect.hit_position = from + dir * distance;
+                isect.barycentric = barycentric;
+                isect.tri_idx = tidx;
+                isect.normal = normal;
+                isect.wo = -dir;
+            }
+        }
+
+        // 最近交点在当前cell之内, 或者光线已经走到终点
+        float exit_t = walker.ExitT();
+        if ((hit != RAY_MISS && best_distance <= exit_t * cell_to_world) || walker.icell == walker.iendcell || exit_t >= walker.t_max) {
+            break;
+        }
+
+        walker.Next();
+    }
+
+    if (stats_enabled) {
+        AddCounters(cells, tests, skips, hit != RAY_MISS);
+    }
+    return hit;
+}
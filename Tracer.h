@@ -0,0 +1,71 @@
+#pragma once
+
+#include "LightMapperDefine.h"
+#include "Stats.h"
+
+#include <atomic>
+
+struct AccelerationStructures;
+
+#define RAY_MISS 0
+#define RAY_FRONT 1
+#define RAY_BACK 2
+#define RAY_ANY 3
+
+// 一个三角形会被它覆盖的所有cell引用, 每条光线记录最近测试过的三角形, 跳过重复测试
+#define MAILBOX_SIZE 8
+
+struct Interaction {
+    bool hit = false;
+    float hit_dist = 0.0f;
+    glm::vec3 hit_position = glm::vec3(0.0f);
+    uint32_t tri_idx = 0;
+    glm::vec3 wo = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    glm::vec3 barycentric = glm::vec3(0.0f);
+};
+
+// CPU端的网格遍历, 与compute shader中的TraceRay保持一致
+class Tracer {
+public:
+    Tracer(const AccelerationStructures* as, float bias);
+
+    // 最近交点查询, 对应shader中的TraceRay
+    uint32_t TraceRay(const glm::vec3& from, const glm::vec3& to, Interaction& isect) const;
+
+    // 任意交点查询, 只判断是否遮挡, 对应shader中的TraceShadowRay
+    uint32_t TraceShadowRay(const glm::vec3& from, const glm::vec3& to) const;
+
+    const AccelerationStructures* GetAccelerationStructures() const { return as; }
+
+    glm::vec3 GetBoundSize() const { return bound_size; }
+
+    float GetBias() const { return bias; }
+
+    // 开启后每条光线结束时把计数累加到全局计数器, 关闭时不产生原子操作
+    void SetStatsEnabled(bool enabled) { stats_enabled = enabled; }
+
+    TraceCounters GetCounters() const;
+
+    void ResetCounters();
+
+private:
+    template <bool any_hit>
+    uint32_t Trace(const glm::vec3& from, const glm::vec3& to, Interaction& isect) const;
+
+    void AddCounters(uint32_t cells, uint32_t tests, uint32_t skips, bool hit) const;
+
+private:
+    const AccelerationStructures* as = nullptr;
+    glm::vec3 bound_size;
+    glm::vec3 to_cell_offset;
+    glm::vec3 to_cell_size;
+    float bias = 0.0f;
+    bool stats_enabled = false;
+    // 计数器单独占用cache line, 避免与遍历时只读的成员伪共享
+    alignas(64) mutable std::atomic<uint64_t> rays{0};
+    mutable std::atomic<uint64_t> cells_visited{0};
+    mutable std::atomic<uint64_t> triangle_tests{0};
+    mutable std::atomic<uint64_t> mailbox_skips{0};
+    mutable std::atomic<uint64_t> hits{0};
+};
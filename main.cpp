@@ -2,6 +2,12 @@
 #include "Importer.h"
 #include "Model.h"
 #include "Builder.h"
+#include "CpuBaker.h"
+#include "Denoiser.h"
+#include "Dilation.h"
+#include "Rasterizer.h"
+#include "ShardBake.h"
+#include "Stats.h"
 
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3.h>
@@ -12,11 +18,14 @@
 #include <Blast/Utility/VulkanShaderCompiler.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
-#include <xatlas.h>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
 
 static std::string ProjectDir(PROJECT_DIR);
 
@@ -33,6 +42,39 @@ static std::string ReadFileData(const std::string& path) {
     return std::string((std::istreambuf_iterator<char>(*stream)), std::istreambuf_iterator<char>());
 }
 
+// 展开shader中的#include "file", 路径相对于当前文件所在目录, 同一文件只展开一次
+static std::string ReadShaderSource(const std::string& path, std::set<std::string>& included) {
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    std::istringstream stream(ReadFileData(path));
+    std::string source;
+    std::string line;
+    while (std::getline(stream, line)) {
+        size_t pos = line.find_first_not_of(" \t");
+        if (pos != std::string::npos && line.compare(pos, 8, "#include") == 0) {
+            size_t begin = line.find('"', pos);
+            size_t end = line.find('"', begin + 1);
+            if (begin == std::string::npos || end == std::string::npos) {
+                BLAST_LOGW("invalid include in %s: %s\n", path.c_str(), line.c_str());
+                continue;
+            }
+
+            std::string include_path = directory + line.substr(begin + 1, end - begin - 1);
+            if (included.insert(include_path).second) {
+                source += ReadShaderSource(include_path, included);
+            }
+            continue;
+        }
+        source += line + "\n";
+    }
+    return source;
+}
+
+static std::string ReadShaderSource(const std::string& path) {
+    std::set<std::string> included;
+    included.insert(path);
+    return ReadShaderSource(path, included);
+}
+
 static glm::vec4 RandomColor() {
     uint8_t color[3];
     for (int i = 0; i < 3; i++) {
@@ -45,6 +87,30 @@ static std::pair<blast::GfxShader*, blast::GfxShader*> CompileShaderProgram(cons
 
 static blast::GfxShader* CompileComputeShader(const std::string& cs_path);
 
+// 按文件后缀区分stage, 用于--compile-shaders预编译
+static const char* SHADER_FILES[] = {
+    "blit.vert", "blit.frag", "scene.vert", "scene.frag",
+    "clear_color.comp", "direct_light.comp", "bounce_light.comp", "jump_flood.comp", "dilate.comp", "denoise.comp", "unocclude.comp", "compact_texels.comp",
+    "compose_light_groups.comp"
+};
+
+static bool PrecompileShaders();
+
+static glm::uvec2 GetTexelGroupCount(uint32_t texel_count);
+
+// 清空光照和SH后计算当前分组的直接光照, 分组烘焙时每组都从这里开始
+static void DispatchDirectLight(blast::GfxCommandBuffer* cmd);
+
+// 把source的光照, SH和方差乘上weight后写入dest, accumulate时累加到dest上
+static void ComposeLightGroup(blast::GfxCommandBuffer* cmd, blast::GfxTexture* source_light, blast::GfxTexture* source_sh, blast::GfxTexture* source_variance,
+                              blast::GfxTexture* dest_light, blast::GfxTexture* dest_sh, blast::GfxTexture* dest_variance, const glm::vec3& weight, bool accumulate);
+
+// 各组的结果按light_group_weights合成到dest_light_tex, sh_light_map和variance_tex
+static void ComposeLightGroups(blast::GfxCommandBuffer* cmd);
+
+// 对sh_light_map降噪和扩展, 结束后所有光照纹理都处于可读状态
+static void DenoiseAndDilate(blast::GfxCommandBuffer* cmd);
+
 static void RefreshSwapchain(void* window, uint32_t width, uint32_t height);
 
 static void CursorPositionCallback(GLFWwindow* window, double pos_x, double pos_y);
@@ -53,13 +119,14 @@ static void MouseButtonCallback(GLFWwindow* window, int button, int action, int
 
 static void MouseScrollCallback(GLFWwindow* window, double offset_x, double offset_y);
 
+static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
 blast::ShaderCompiler* g_shader_compiler = nullptr;
 blast::GfxDevice* g_device = nullptr;
 blast::GfxSwapChain* g_swapchain = nullptr;
 blast::GfxTexture* position_tex = nullptr;
 blast::GfxTexture* normal_tex = nullptr;
 blast::GfxTexture* unocclude_tex = nullptr;
-blast::GfxRenderPass* raster_renderpass = nullptr;
 blast::GfxTexture* scene_color_tex = nullptr;
 blast::GfxTexture* scene_depth_tex = nullptr;
 blast::GfxTexture* resolve_tex = nullptr;
@@ -70,15 +137,15 @@ blast::GfxPipeline* blit_pipeline = nullptr;
 blast::GfxShader* scene_vert_shader = nullptr;
 blast::GfxShader* scene_frag_shader = nullptr;
 blast::GfxPipeline* scene_pipeline = nullptr;
-blast::GfxShader* raster_vert_shader = nullptr;
-blast::GfxShader* raster_frag_shader = nullptr;
-blast::GfxPipeline* raster_line_pipeline = nullptr;
-blast::GfxPipeline* raster_triangle_pipeline = nullptr;
 blast::GfxShader* clear_color_shader = nullptr;
 blast::GfxShader* unocclude_shader = nullptr;
 blast::GfxShader* direct_light_shader = nullptr;
 blast::GfxShader* bounce_light_shader = nullptr;
+blast::GfxShader* jump_flood_shader = nullptr;
 blast::GfxShader* dilate_shader = nullptr;
+blast::GfxShader* denoise_shader = nullptr;
+blast::GfxShader* compact_texels_shader = nullptr;
+blast::GfxShader* compose_light_groups_shader = nullptr;
 blast::GfxBuffer* object_ub = nullptr;
 
 // Acceleration Structures Begin
@@ -87,25 +154,54 @@ blast::GfxBuffer* triangle_buffer = nullptr;
 blast::GfxBuffer* seam_buffer = nullptr;
 blast::GfxBuffer* triangle_index_buffer = nullptr;
 blast::GfxTexture* grid_tex = nullptr;
+blast::GfxTexture* albedo_tex = nullptr;
 // Acceleration Structures End
 
 // LightMap Begin
 blast::GfxSampler* linear_sampler = nullptr;
 blast::GfxSampler* nearest_sampler = nullptr;
 blast::GfxBuffer* light_buffer = nullptr;
+blast::GfxBuffer* light_grid_buffer = nullptr;
+blast::GfxBuffer* light_index_buffer = nullptr;
+blast::GfxBuffer* triangle_material_buffer = nullptr;
+blast::GfxBuffer* emissive_light_buffer = nullptr;
+blast::GfxBuffer* environment_buffer = nullptr;
+blast::GfxBuffer* environment_cdf_buffer = nullptr;
 blast::GfxTexture* source_light_tex = nullptr;
 blast::GfxTexture* dest_light_tex = nullptr;
 blast::GfxTexture* sh_light_map = nullptr;
 blast::GfxTexture* temp_sh_light_map = nullptr;
+// 弹射的收敛信息, w为SH L0层的亮度方差, 供降噪使用
+blast::GfxTexture* variance_tex = nullptr;
+// 紧凑化后的有效纹素列表
+blast::GfxBuffer* texel_buffer = nullptr;
+blast::GfxBuffer* texel_count_buffer = nullptr;
+// 网格遍历的计数, 与trace.glsl中的TraceCounters一致, 只在开启gpu_trace_counters时累加
+blast::GfxBuffer* trace_counter_buffer = nullptr;
+// 每个灯光所属的分组, 最后一项为自发光和环境光所在的分组
+blast::GfxBuffer* light_group_buffer = nullptr;
+// 分组烘焙时每组降噪之前的光照, SH和方差
+std::vector<blast::GfxTexture*> group_light_texs;
+std::vector<blast::GfxTexture*> group_sh_light_maps;
+std::vector<blast::GfxTexture*> group_variance_texs;
 // LightMap End
 
 Model* quad_model = nullptr;
 bool bake_prepared = false;
 bool bake_completed = false;
-uint32_t current_x_regions = 0;
-uint32_t current_y_regions = 0;
+uint32_t current_regions = 0;
 uint32_t current_ray_iterations = 0;
 uint32_t current_bounces = 0;
+// 灯光分组数加上自发光和环境光所在的最后一组, 未分组时为0
+uint32_t light_group_count = 0;
+uint32_t current_light_group = 0;
+// 烘焙结束后修改分组权重时置位, 下一帧重新合成并降噪
+std::vector<glm::vec3> light_group_weights;
+bool relight_pending = false;
+std::chrono::high_resolution_clock::time_point bake_start_time;
+// GPU烘焙的统计报告只包含主机端的派发次数和光线预算的上限, 没有回读遍历计数, 不影响报告中的烘焙时间
+uint32_t bounce_dispatches = 0;
+uint64_t bounce_ray_budget = 0;
 
 blast::SampleCount g_sample_count = blast::SAMPLE_COUNT_4;
 
@@ -132,11 +228,61 @@ struct LightmapParam {
     uint32_t height;
     uint32_t ray_count_per_texel;
     uint32_t max_region_size;
-    uint32_t x_regions;
-    uint32_t y_regions;
+    uint32_t region_texel_count;
+    // 有效纹素数量, 与compact_texels.comp的判断一致, 区域和派发数量都按它计算
+    uint32_t texel_count;
+    uint32_t texel_regions;
     uint32_t ray_iterations;
+    uint32_t min_ray_iterations;
     uint32_t ray_count_per_iteration;
     uint32_t bounces;
+    // 单个cell内灯光超过该数量时按贡献重要性采样, 每纹素最多追踪这么多阴影光线
+    uint32_t max_light_samples;
+    // 每纹素对自发光三角形追踪的阴影光线数
+    uint32_t emissive_light_samples;
+    // 多次弹射时收集光线在命中点继续追踪路径, 只需要一遍弹射pass
+    bool path_continuation;
+    float adaptive_error_threshold;
+    // 弹射结束后对SH降噪, CPU和GPU后端共用
+    DenoiseParams denoise;
+    // 未覆盖纹素从最近的已覆盖纹素扩展的最大距离, 需要不小于atlas的padding才能填满chart之间的间隙
+    uint32_t dilate_radius;
+    // 渐进模式下先对整张lightmap做一次迭代再增加采样, time_budget为秒, 0表示不限时
+    bool progressive;
+    float time_budget;
+    // equirect格式的HDR环境贴图, 为空时使用environment_color作为纯色环境
+    std::string environment_map;
+    glm::vec3 environment_color;
+    float environment_intensity;
+    // 每次迭代对环境光重要性采样的光线数
+    uint32_t environment_samples;
+    bool cpu_benchmark;
+    // CPU烘焙结束后对比任意交点与最近交点查询的阴影光线吞吐量, 0表示不测试, 否则为每纹素的光线数
+    uint32_t cpu_shadow_ray_benchmark;
+    // CPU后端中间光照的存储格式, GPU后端固定使用RGBA16F
+    LightmapFormat cpu_light_format;
+    // CPU后端烘焙结果的导出路径, 为空时不导出, GPU后端的结果只在显存中, 不经过这个导出流程
+    std::string cpu_output_path;
+    // exr16, exr32, ktx2-rgba16f, ktx2-rgba32f, ktx2-bc6h, dds-rgba16f, dds-rgba32f, dds-bc6h
+    // bc6h时SH的L1层写到文件名加_l1的BC6H_SF16文件中
+    std::string cpu_output_format;
+    BC6HQuality cpu_bc6h_quality;
+    // CPU后端增量烘焙的缓存路径, 为空时每次全量烘焙, 只重新追踪受变化的模型和灯光影响的纹素
+    std::string cpu_bake_cache;
+    float cpu_cache_influence_radius;
+    // 每个灯光所属的分组, 为空时不分组, CPU和GPU后端共用. 分组后只修改灯光颜色或强度时按组加权重新合成,
+    // CPU后端调用CpuBaker::Relight, GPU后端按数字键切换对应分组的开关. 分组烘焙时不使用自适应采样
+    std::vector<uint32_t> light_groups;
+    // CPU后端的分片数, 大于1时atlas按tile分给多个worker进程烘焙后合并, 结果与单进程逐位相同
+    uint32_t cpu_shard_count;
+    uint32_t cpu_shard_tile_size;
+    // 分片烘焙中间文件所在的目录, 为空时使用系统临时目录, 烘焙结束后删除
+    std::string cpu_shard_temp_dir;
+    // 不为空时烘焙结束后写出json统计报告
+    std::string stats_report;
+    std::string cpu_stats_report;
+    // 调试用, GPU烘焙时每条光线原子累加遍历计数到trace_counter_buffer, 需要用抓帧工具查看, 会拖慢烘焙
+    bool gpu_trace_counters;
 } lightmap_param;
 
 struct BakeParam {
@@ -149,24 +295,64 @@ struct BakeParam {
     uint32_t ray_count_per_iteration;
     uint32_t light_count;
     uint32_t grid_size;
-    uint32_t offset_x;
-    uint32_t offset_y;
+    uint32_t texel_offset;
+    uint32_t texel_stride;
     uint32_t max_iterations;
     uint32_t current_iterations;
     uint32_t bounces;
+    uint32_t min_iterations;
+    float error_threshold;
+    uint32_t current_bounce;
+    uint32_t max_light_samples;
+    uint32_t emissive_light_count;
+    uint32_t emissive_light_samples;
+    uint32_t trace_counters;
+    // 分组烘焙时当前计算的分组, 0xffffffff表示所有灯光
+    uint32_t light_group;
 } bake_param;
 
-struct RasterParam {
-    glm::vec2 atlas_size;
-    glm::vec2 uv_offset;
-} raster_param;
-
 struct ClearParam {
     glm::vec4 clear_color;
 } clear_param;
 
-int main() {
-    g_shader_compiler = new blast::VulkanShaderCompiler();
+struct CompactParam {
+    glm::ivec2 atlas_size;
+} compact_param;
+
+struct DenoiseParam {
+    glm::ivec2 atlas_size;
+    int32_t step;
+    float sigma_plane;
+    float normal_power;
+    float sigma_luminance;
+} denoise_param;
+
+struct JumpFloodParam {
+    glm::ivec2 atlas_size;
+    int32_t step;
+    int32_t radius;
+} jump_flood_param;
+
+struct ComposeParam {
+    glm::vec4 weight;
+    glm::ivec2 atlas_size;
+    uint32_t accumulate;
+    uint32_t padding;
+} compose_param;
+
+int main(int argc, char** argv) {
+    // 只编译shader到SPIR-V缓存, 供构建步骤调用
+    if (argc > 1 && strcmp(argv[1], "--compile-shaders") == 0) {
+        bool success = PrecompileShaders();
+        SAFE_DELETE(g_shader_compiler);
+        return success ? 0 : 1;
+    }
+
+    // 分片烘焙的worker进程, 只使用CPU后端, 不创建窗口和GPU设备
+    // 参数: --bake-shard <scene> <state> <pass> <shard index> <threads> <output>
+    if (argc > 7 && strcmp(argv[1], "--bake-shard") == 0) {
+        return RunShardWorker(argv[2], argv[3], (uint32_t)atoi(argv[4]), (uint32_t)atoi(argv[5]), (uint32_t)atoi(argv[6]), argv[7]);
+    }
 
     g_device = new blast::VulkanDevice();
 
@@ -181,11 +367,6 @@ int main() {
         scene_vert_shader = shaders.first;
         scene_frag_shader = shaders.second;
     }
-    {
-        auto shaders = CompileShaderProgram(ProjectDir + "/Resources/Shaders/raster.vert", ProjectDir + "/Resources/Shaders/raster.frag");
-        raster_vert_shader = shaders.first;
-        raster_frag_shader = shaders.second;
-    }
     {
         clear_color_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/clear_color.comp");
     }
@@ -195,23 +376,36 @@ int main() {
     {
         bounce_light_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/bounce_light.comp");
     }
+    {
+        jump_flood_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/jump_flood.comp");
+    }
     {
         dilate_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/dilate.comp");
     }
+    {
+        denoise_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/denoise.comp");
+    }
     {
         unocclude_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/unocclude.comp");
     }
+    {
+        compact_texels_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/compact_texels.comp");
+    }
+    {
+        compose_light_groups_shader = CompileComputeShader(ProjectDir + "/Resources/Shaders/compose_light_groups.comp");
+    }
 
     // 设置灯光
+    // 增量烘焙按字节比较灯光参数, 未使用的字段也需要初始化
     std::vector<Light> lights;
-    Light dir_lit;
+    Light dir_lit = {};
     dir_lit.position = glm::vec3(0.0f, 100.0f, 0.0f);
     dir_lit.type = LIGHT_TYPE_DIRECTIONAL;
     dir_lit.direction_energy = glm::vec4(-0.0f, 0.0f, -1.0f, 2.0f);
     dir_lit.color = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
     lights.push_back(dir_lit);
 
-    Light point_lit;
+    Light point_lit = {};
     point_lit.position = glm::vec3(0.5f, 1.0f, -0.2f);
     point_lit.type = LIGHT_TYPE_OMNI;
     point_lit.direction_energy = glm::vec4(0.0f, -1.0f, 0.5f, 1.5f);
@@ -244,113 +438,62 @@ int main() {
     std::vector<Model*> display_scene = ImportScene(ProjectDir + "/Resources/Scenes/CornellBox.gltf");
 
     // 生成atlas并为场景模型分配atlas uv
-    xatlas::Atlas* atlas = xatlas::Create();
-    for (uint32_t i = 0; i < display_scene.size(); ++i) {
-        xatlas::MeshDecl mesh_decl;
-        mesh_decl.vertexCount = display_scene[i]->GetVertexCount();
-        mesh_decl.vertexPositionData = display_scene[i]->GetPositionData();
-        mesh_decl.vertexPositionStride = sizeof(glm::vec3);
-        mesh_decl.vertexNormalData = display_scene[i]->GetNormalData();
-        mesh_decl.vertexNormalStride = sizeof(glm::vec3);
-        mesh_decl.vertexUvData = display_scene[i]->GetUV0Data();
-        mesh_decl.vertexUvStride = sizeof(glm::vec2);
-        mesh_decl.indexData = display_scene[i]->GetIndexData();
-        mesh_decl.indexCount = display_scene[i]->GetIndexCount();
-        mesh_decl.indexFormat = display_scene[i]->GetIndexType() == blast::INDEX_TYPE_UINT16 ? xatlas::IndexFormat::UInt16 : xatlas::IndexFormat::UInt32;
-        xatlas::AddMeshError ret = xatlas::AddMesh(atlas, mesh_decl);
-    }
-    xatlas::ChartOptions chartOptions;
-    xatlas::PackOptions packOptions;
-    packOptions.bilinear = true;
-    packOptions.padding = 4;
-    packOptions.texelsPerUnit = 64;
-    packOptions.resolution = 512;
-    xatlas::Generate(atlas, chartOptions, packOptions);
-
-    // Recreate VertexData IndexData
-    for (uint32_t i = 0; i < atlas->meshCount; ++i) {
-        xatlas::Mesh& atlas_mesh = atlas->meshes[i];
-        glm::vec3* old_position_data = (glm::vec3*)display_scene[i]->GetPositionData();
-        glm::vec3* old_normal_data = (glm::vec3*)display_scene[i]->GetNormalData();
-        glm::vec2* old_uv0_data = (glm::vec2*)display_scene[i]->GetUV0Data();
-
-        float* position_data = new float[3 * atlas_mesh.vertexCount];
-        float* normal_data = new float[3 * atlas_mesh.vertexCount];
-        float* uv0_data = new float[2 * atlas_mesh.vertexCount];
-        float* uv1_data = new float[2 * atlas_mesh.vertexCount];
-        for (uint32_t j = 0; j < atlas_mesh.vertexCount; ++j) {
-            uint32_t xref = atlas_mesh.vertexArray[j].xref;
-
-            position_data[j * 3] = old_position_data[xref].x;
-            position_data[j * 3 + 1] = old_position_data[xref].y;
-            position_data[j * 3 + 2] = old_position_data[xref].z;
-
-            normal_data[j * 3] = old_normal_data[xref].x;
-            normal_data[j * 3 + 1] = old_normal_data[xref].y;
-            normal_data[j * 3 + 2] = old_normal_data[xref].z;
-
-            uv0_data[j * 2] = old_uv0_data[xref].x;
-            uv0_data[j * 2 + 1] = old_uv0_data[xref].y;
-
-            uv1_data[j * 2] = atlas_mesh.vertexArray[j].uv[0] / atlas->width;
-            uv1_data[j * 2 + 1] = atlas_mesh.vertexArray[j].uv[1] / atlas->height;
-        }
-
-        uint32_t* index_data = new uint32_t [atlas_mesh.indexCount];
-        for (uint32_t j = 0; j < atlas_mesh.indexCount; ++j) {
-            index_data[j] = atlas_mesh.indexArray[j];
-        }
-
-        display_scene[i]->SetVertexCount(atlas_mesh.vertexCount);
-        display_scene[i]->ResetPositionData((uint8_t*)position_data);
-        display_scene[i]->ResetNormalData((uint8_t*)normal_data);
-        display_scene[i]->ResetUV0Data((uint8_t*)uv0_data);
-        display_scene[i]->ResetUV1Data((uint8_t*)uv1_data);
-        display_scene[i]->ResetIndexData((uint8_t*)index_data);
-        display_scene[i]->SetIndexCount(atlas_mesh.indexCount);
-        display_scene[i]->SetIndexType(blast::INDEX_TYPE_UINT32);
+    glm::uvec2 atlas_size = GenerateLightmapUV(display_scene, 512, 64.0f, 2);
+    if (atlas_size.x == 0 || atlas_size.y == 0) {
+        printf("generate lightmap uv failed\n");
+        return 1;
     }
 
     // 设置光照贴图参数
     {
-        lightmap_param.width = atlas->width;
-        lightmap_param.height = atlas->height;
+        lightmap_param.width = atlas_size.x;
+        lightmap_param.height = atlas_size.y;
         // 每纹素追踪的光线数量
         lightmap_param.ray_count_per_texel = 512;
         lightmap_param.max_region_size = 128;
-        lightmap_param.x_regions = (atlas->width - 1) / lightmap_param.max_region_size + 1;
-        lightmap_param.y_regions = (atlas->height - 1) / lightmap_param.max_region_size + 1;
+        // 区域按紧凑化后的纹素列表划分, 区域数量在光栅化G-buffer之后计算
+        lightmap_param.region_texel_count = lightmap_param.max_region_size * lightmap_param.max_region_size;
+        // 光线分多次迭代追踪, 开启自适应采样时纹素收敛后提前停止, 此时需要更多的迭代次数(例如8)
         lightmap_param.ray_iterations = 2;
+        lightmap_param.min_ray_iterations = 2;
         lightmap_param.ray_count_per_iteration = lightmap_param.ray_count_per_texel / lightmap_param.ray_iterations;
         lightmap_param.bounces = 1;
+        lightmap_param.path_continuation = false;
+        lightmap_param.max_light_samples = 16;
+        lightmap_param.emissive_light_samples = 8;
+        // 亮度均值的相对标准误差阈值, 0表示关闭自适应采样, 0.2可以省下约三分之一的弹射光线
+        lightmap_param.adaptive_error_threshold = 0.0f;
+        // 降噪的迭代次数, 0表示关闭, 开启后每纹素128条光线就能得到与512条接近的结果
+        lightmap_param.denoise.iterations = 0;
+        lightmap_param.dilate_radius = 8;
+        lightmap_param.progressive = false;
+        lightmap_param.time_budget = 30.0f;
+        lightmap_param.environment_map = "";
+        lightmap_param.environment_color = glm::vec3(0.0f);
+        lightmap_param.environment_intensity = 1.0f;
+        lightmap_param.environment_samples = 8;
+        lightmap_param.cpu_benchmark = false;
+        lightmap_param.cpu_shadow_ray_benchmark = 0;
+        lightmap_param.cpu_light_format = LIGHTMAP_FORMAT_RGBA16F;
+        lightmap_param.cpu_output_path = "";
+        lightmap_param.cpu_output_format = "exr16";
+        lightmap_param.cpu_bc6h_quality = BC6H_QUALITY_NORMAL;
+        lightmap_param.cpu_bake_cache = "";
+        lightmap_param.cpu_cache_influence_radius = 0.5f;
+        lightmap_param.light_groups.clear();
+        lightmap_param.cpu_shard_count = 1;
+        lightmap_param.cpu_shard_tile_size = 64;
+        lightmap_param.cpu_shard_temp_dir = "";
+        lightmap_param.stats_report = "";
+        lightmap_param.cpu_stats_report = "";
+        lightmap_param.gpu_trace_counters = false;
     }
 
-    xatlas::Destroy(atlas);
-
     for (uint32_t i = 0; i < display_scene.size(); ++i) {
         display_scene[i]->GenerateGPUResource(g_device);
         object_storages.push_back({});
     }
 
-    // 创建光栅化RenderPass
-    {
-        blast::GfxTextureDesc texture_desc;
-        texture_desc.width = lightmap_param.width;
-        texture_desc.height = lightmap_param.height;
-        texture_desc.format = blast::FORMAT_R32G32B32A32_FLOAT;
-        texture_desc.res_usage = blast::RESOURCE_USAGE_SHADER_RESOURCE | blast::RESOURCE_USAGE_RENDER_TARGET | blast::RESOURCE_USAGE_UNORDERED_ACCESS;
-        texture_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
-        position_tex = g_device->CreateTexture(texture_desc);
-        normal_tex = g_device->CreateTexture(texture_desc);
-        unocclude_tex = g_device->CreateTexture(texture_desc);
-
-        blast::GfxRenderPassDesc renderpass_desc = {};
-        renderpass_desc.attachments.push_back(blast::RenderPassAttachment::RenderTarget(position_tex, -1, blast::LOAD_CLEAR));
-        renderpass_desc.attachments.push_back(blast::RenderPassAttachment::RenderTarget(normal_tex, -1, blast::LOAD_CLEAR));
-        renderpass_desc.attachments.push_back(blast::RenderPassAttachment::RenderTarget(unocclude_tex, -1, blast::LOAD_CLEAR));
-        raster_renderpass = g_device->CreateRenderPass(renderpass_desc);
-    }
-
     // 加载GPU Buffer
     {
         blast::GfxBufferDesc buffer_desc = {};
@@ -363,9 +506,49 @@ int main() {
     // Acceleration Structures
     blast::GfxCommandBuffer* copy_cmd = g_device->RequestCommandBuffer(blast::QUEUE_COPY);
     AccelerationStructures* as = BuildAccelerationStructures(display_scene);
+    BuildLightGrid(as, lights);
+    BuildAlbedoAtlas(as, display_scene, lightmap_param.width, lightmap_param.height);
+
+    // G-buffer在CPU上一遍保守光栅化生成, 与CPU后端共用
+    std::vector<glm::vec4> gbuffer_position;
+    std::vector<glm::vec4> gbuffer_normal;
+    std::vector<glm::vec4> gbuffer_unocclude;
+    {
+        ScopedTimer timer("bake", "raster");
+        RasterizeGBuffer(as, lightmap_param.width, lightmap_param.height, GBUFFER_DILATION, gbuffer_position, gbuffer_normal, gbuffer_unocclude);
+    }
+
+    // 紧凑化在GPU上完成, 有效纹素的数量在这里按相同的条件统计, 派发时不再遍历空的区域
+    lightmap_param.texel_count = 0;
+    for (uint32_t i = 0; i < gbuffer_position.size(); ++i) {
+        if (gbuffer_position[i].a > 0.5f && glm::length(glm::vec3(gbuffer_normal[i])) >= 0.5f) {
+            lightmap_param.texel_count++;
+        }
+    }
+    lightmap_param.texel_regions = std::max(1u, (lightmap_param.texel_count + lightmap_param.region_texel_count - 1) / lightmap_param.region_texel_count);
+
+    // 环境光, 纯色环境视为1x1的环境贴图
+    {
+        std::vector<glm::vec4> environment_pixels;
+        uint32_t environment_width = 0;
+        uint32_t environment_height = 0;
+        if (!lightmap_param.environment_map.empty()) {
+            ImportEnvironmentMap(ProjectDir + lightmap_param.environment_map, environment_pixels, environment_width, environment_height);
+        } else if (lightmap_param.environment_color != glm::vec3(0.0f)) {
+            environment_pixels.push_back(glm::vec4(lightmap_param.environment_color, 1.0f));
+            environment_width = 1;
+            environment_height = 1;
+        }
+
+        for (glm::vec4& pixel : environment_pixels) {
+            pixel *= lightmap_param.environment_intensity;
+        }
+        BuildEnvironmentMap(as, environment_pixels, environment_width, environment_height);
+        as->environment_info.sample_count = lightmap_param.environment_samples;
+    }
     {
-        blast::GfxBufferBarrier buffer_barriers[5] = {};
-        blast::GfxTextureBarrier texture_barrier = {};
+        blast::GfxBufferBarrier buffer_barriers[12] = {};
+        blast::GfxTextureBarrier texture_barriers[5] = {};
 
         blast::GfxTextureDesc texture_desc;
         texture_desc.width = MAX_GRID_SIZE;
@@ -376,12 +559,37 @@ int main() {
         texture_desc.res_usage = blast::RESOURCE_USAGE_SHADER_RESOURCE | blast::RESOURCE_USAGE_UNORDERED_ACCESS;
         grid_tex = g_device->CreateTexture(texture_desc);
 
-        texture_barrier.texture = grid_tex;
-        texture_barrier.new_state = blast::RESOURCE_STATE_COPY_DEST;
-        g_device->SetBarrier(copy_cmd, 0, nullptr, 1, &texture_barrier);
+        texture_desc.width = lightmap_param.width;
+        texture_desc.height = lightmap_param.height;
+        texture_desc.depth = 1;
+        texture_desc.format = blast::FORMAT_R32G32B32A32_FLOAT;
+        albedo_tex = g_device->CreateTexture(texture_desc);
+        position_tex = g_device->CreateTexture(texture_desc);
+        normal_tex = g_device->CreateTexture(texture_desc);
+        unocclude_tex = g_device->CreateTexture(texture_desc);
+
+        texture_barriers[0].texture = grid_tex;
+        texture_barriers[0].new_state = blast::RESOURCE_STATE_COPY_DEST;
+        texture_barriers[1].texture = albedo_tex;
+        texture_barriers[1].new_state = blast::RESOURCE_STATE_COPY_DEST;
+        texture_barriers[2].texture = position_tex;
+        texture_barriers[2].new_state = blast::RESOURCE_STATE_COPY_DEST;
+        texture_barriers[3].texture = normal_tex;
+        texture_barriers[3].new_state = blast::RESOURCE_STATE_COPY_DEST;
+        texture_barriers[4].texture = unocclude_tex;
+        texture_barriers[4].new_state = blast::RESOURCE_STATE_COPY_DEST;
+        g_device->SetBarrier(copy_cmd, 0, nullptr, 5, texture_barriers);
 
         g_device->UpdateTexture(copy_cmd, grid_tex, as->grid_indices.data());
 
+        g_device->UpdateTexture(copy_cmd, albedo_tex, as->albedo_atlas.data());
+
+        g_device->UpdateTexture(copy_cmd, position_tex, gbuffer_position.data());
+
+        g_device->UpdateTexture(copy_cmd, normal_tex, gbuffer_normal.data());
+
+        g_device->UpdateTexture(copy_cmd, unocclude_tex, gbuffer_unocclude.data());
+
         blast::GfxBufferDesc buffer_desc = {};
         buffer_desc.size = sizeof(Vertex) * as->vertices.size();
         buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
@@ -420,6 +628,76 @@ int main() {
         light_buffer = g_device->CreateBuffer(buffer_desc);
         g_device->UpdateBuffer(copy_cmd, light_buffer, lights.data(), sizeof(Light) * lights.size());
 
+        buffer_desc.size = sizeof(uint32_t) * as->light_grid.size();
+        buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+        buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+        light_grid_buffer = g_device->CreateBuffer(buffer_desc);
+        g_device->UpdateBuffer(copy_cmd, light_grid_buffer, as->light_grid.data(), sizeof(uint32_t) * as->light_grid.size());
+
+        buffer_desc.size = sizeof(uint32_t) * as->light_indices.size();
+        buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+        buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+        light_index_buffer = g_device->CreateBuffer(buffer_desc);
+        g_device->UpdateBuffer(copy_cmd, light_index_buffer, as->light_indices.data(), sizeof(uint32_t) * as->light_indices.size());
+
+        buffer_desc.size = sizeof(TriangleMaterial) * as->triangle_materials.size();
+        buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+        buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+        triangle_material_buffer = g_device->CreateBuffer(buffer_desc);
+        g_device->UpdateBuffer(copy_cmd, triangle_material_buffer, as->triangle_materials.data(), sizeof(TriangleMaterial) * as->triangle_materials.size());
+
+        if (as->emissive_lights.size() != 0) {
+            buffer_desc.size = sizeof(EmissiveLight) * as->emissive_lights.size();
+            buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+            buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+            emissive_light_buffer = g_device->CreateBuffer(buffer_desc);
+            g_device->UpdateBuffer(copy_cmd, emissive_light_buffer, as->emissive_lights.data(), sizeof(EmissiveLight) * as->emissive_lights.size());
+        } else {
+            buffer_desc.size = sizeof(EmissiveLight);
+            buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+            buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+            emissive_light_buffer = g_device->CreateBuffer(buffer_desc);
+        }
+
+        // 头部占用第一个元素
+        std::vector<glm::vec4> environment_data(as->environment_map.size() + 1);
+        memcpy(&environment_data[0], &as->environment_info, sizeof(EnvironmentInfo));
+        std::copy(as->environment_map.begin(), as->environment_map.end(), environment_data.begin() + 1);
+        buffer_desc.size = sizeof(glm::vec4) * environment_data.size();
+        buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+        buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+        environment_buffer = g_device->CreateBuffer(buffer_desc);
+        g_device->UpdateBuffer(copy_cmd, environment_buffer, environment_data.data(), sizeof(glm::vec4) * environment_data.size());
+
+        if (as->environment_cdf.size() != 0) {
+            buffer_desc.size = sizeof(float) * as->environment_cdf.size();
+            buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+            buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+            environment_cdf_buffer = g_device->CreateBuffer(buffer_desc);
+            g_device->UpdateBuffer(copy_cmd, environment_cdf_buffer, as->environment_cdf.data(), sizeof(float) * as->environment_cdf.size());
+        } else {
+            buffer_desc.size = sizeof(float);
+            buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+            buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+            environment_cdf_buffer = g_device->CreateBuffer(buffer_desc);
+        }
+
+        if (!lightmap_param.light_groups.empty() && lightmap_param.light_groups.size() != lights.size()) {
+            printf("light groups ignored, expected %u entries but got %u\n", (uint32_t)lights.size(), (uint32_t)lightmap_param.light_groups.size());
+            lightmap_param.light_groups.clear();
+        }
+        std::vector<uint32_t> light_group_data(lights.size() + 1, 0);
+        if (!lightmap_param.light_groups.empty()) {
+            light_group_count = *std::max_element(lightmap_param.light_groups.begin(), lightmap_param.light_groups.end()) + 2;
+            std::copy(lightmap_param.light_groups.begin(), lightmap_param.light_groups.end(), light_group_data.begin());
+            light_group_data.back() = light_group_count - 1;
+        }
+        buffer_desc.size = sizeof(uint32_t) * light_group_data.size();
+        buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+        buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+        light_group_buffer = g_device->CreateBuffer(buffer_desc);
+        g_device->UpdateBuffer(copy_cmd, light_group_buffer, light_group_data.data(), sizeof(uint32_t) * light_group_data.size());
+
         buffer_barriers[0].buffer = vertex_buffer;
         buffer_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
         buffer_barriers[1].buffer = triangle_buffer;
@@ -430,10 +708,32 @@ int main() {
         buffer_barriers[3].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
         buffer_barriers[4].buffer = light_buffer;
         buffer_barriers[4].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
-        texture_barrier.texture = grid_tex;
-        texture_barrier.new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-
-        g_device->SetBarrier(copy_cmd, 4, buffer_barriers, 1, &texture_barrier);
+        buffer_barriers[5].buffer = light_grid_buffer;
+        buffer_barriers[5].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        buffer_barriers[6].buffer = light_index_buffer;
+        buffer_barriers[6].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        buffer_barriers[7].buffer = triangle_material_buffer;
+        buffer_barriers[7].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        buffer_barriers[8].buffer = emissive_light_buffer;
+        buffer_barriers[8].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        buffer_barriers[9].buffer = environment_buffer;
+        buffer_barriers[9].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        buffer_barriers[10].buffer = environment_cdf_buffer;
+        buffer_barriers[10].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        buffer_barriers[11].buffer = light_group_buffer;
+        buffer_barriers[11].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE | blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        texture_barriers[0].texture = grid_tex;
+        texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[1].texture = albedo_tex;
+        texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[2].texture = position_tex;
+        texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[3].texture = normal_tex;
+        texture_barriers[3].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[4].texture = unocclude_tex;
+        texture_barriers[4].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+
+        g_device->SetBarrier(copy_cmd, 12, buffer_barriers, 5, texture_barriers);
     }
 
     // LightMap
@@ -441,20 +741,91 @@ int main() {
         blast::GfxTextureDesc texture_desc;
         texture_desc.width = lightmap_param.width;
         texture_desc.height = lightmap_param.height;
-        texture_desc.format = blast::FORMAT_R32G32B32A32_FLOAT;
         texture_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
         texture_desc.res_usage = blast::RESOURCE_USAGE_SHADER_RESOURCE | blast::RESOURCE_USAGE_UNORDERED_ACCESS;
+        // 每次弹射只写入一次的光照结果用半精度存储, 需要和shader中的rgba16f一致
+        // RGB9E5和R11G11B10作为storage image的支持不可靠, 只在CPU后端提供
+        texture_desc.format = blast::FORMAT_R16G16B16A16_FLOAT;
         source_light_tex = g_device->CreateTexture(texture_desc);
         dest_light_tex = g_device->CreateTexture(texture_desc);
+        // 降噪需要完整的G-buffer, 收敛信息不再复用position_tex
+        texture_desc.format = blast::FORMAT_R32G32B32A32_FLOAT;
+        variance_tex = g_device->CreateTexture(texture_desc);
+        // SH是跨弹射的running sum, 保持全精度
+        texture_desc.format = blast::FORMAT_R32G32B32A32_FLOAT;
         texture_desc.num_layers = 4;
         sh_light_map = g_device->CreateTexture(texture_desc);
         temp_sh_light_map = g_device->CreateTexture(texture_desc);
+        // 分组烘焙时每组保存一份降噪之前的结果, 格式与合成的目标一致
+        for (uint32_t i = 0; i < light_group_count; ++i) {
+            texture_desc.num_layers = 4;
+            group_sh_light_maps.push_back(g_device->CreateTexture(texture_desc));
+            texture_desc.num_layers = 1;
+            group_variance_texs.push_back(g_device->CreateTexture(texture_desc));
+            texture_desc.format = blast::FORMAT_R16G16B16A16_FLOAT;
+            group_light_texs.push_back(g_device->CreateTexture(texture_desc));
+            texture_desc.format = blast::FORMAT_R32G32B32A32_FLOAT;
+        }
+        light_group_weights.assign(light_group_count, glm::vec3(1.0f));
 
         blast::GfxSamplerDesc sampler_desc = {};
         linear_sampler = g_device->CreateSampler(sampler_desc);
         sampler_desc.min_filter = blast::FILTER_NEAREST;
         sampler_desc.mag_filter = blast::FILTER_NEAREST;
         nearest_sampler = g_device->CreateSampler(sampler_desc);
+
+        blast::GfxBufferDesc buffer_desc = {};
+        buffer_desc.size = sizeof(TexelData) * lightmap_param.width * lightmap_param.height;
+        buffer_desc.mem_usage = blast::MEMORY_USAGE_GPU_ONLY;
+        buffer_desc.res_usage = blast::RESOURCE_USAGE_RW_BUFFER;
+        texel_buffer = g_device->CreateBuffer(buffer_desc);
+
+        buffer_desc.size = sizeof(uint32_t);
+        texel_count_buffer = g_device->CreateBuffer(buffer_desc);
+
+        buffer_desc.size = sizeof(uint32_t) * 10;
+        trace_counter_buffer = g_device->CreateBuffer(buffer_desc);
+    }
+
+    // CPU后端, 仅用于与GPU版本做性能对比
+    if (lightmap_param.cpu_benchmark) {
+        CpuBakeParams cpu_bake_params;
+        cpu_bake_params.width = lightmap_param.width;
+        cpu_bake_params.height = lightmap_param.height;
+        cpu_bake_params.ray_count = lightmap_param.ray_count_per_texel;
+        cpu_bake_params.bounces = lightmap_param.bounces;
+        cpu_bake_params.path_continuation = lightmap_param.path_continuation;
+        cpu_bake_params.max_light_samples = lightmap_param.max_light_samples;
+        cpu_bake_params.emissive_light_samples = lightmap_param.emissive_light_samples;
+        cpu_bake_params.ray_iterations = lightmap_param.ray_iterations;
+        cpu_bake_params.min_iterations = lightmap_param.min_ray_iterations;
+        cpu_bake_params.error_threshold = lightmap_param.adaptive_error_threshold;
+        cpu_bake_params.bias = 0.02f;
+        cpu_bake_params.light_format = lightmap_param.cpu_light_format;
+        cpu_bake_params.denoise = lightmap_param.denoise;
+        cpu_bake_params.dilate_radius = lightmap_param.dilate_radius;
+        cpu_bake_params.cache_path = lightmap_param.cpu_bake_cache;
+        cpu_bake_params.cache_influence_radius = lightmap_param.cpu_cache_influence_radius;
+        cpu_bake_params.light_groups = lightmap_param.light_groups;
+        cpu_bake_params.shard_count = lightmap_param.cpu_shard_count;
+        cpu_bake_params.shard_tile_size = lightmap_param.cpu_shard_tile_size;
+        cpu_bake_params.stats_report = lightmap_param.cpu_stats_report;
+        cpu_bake_params.output_path = lightmap_param.cpu_output_path;
+        if (!ParseLightmapExport(lightmap_param.cpu_output_format, cpu_bake_params.output_desc)) {
+            printf("unknown lightmap export format %s\n", lightmap_param.cpu_output_format.c_str());
+            cpu_bake_params.output_path = "";
+        }
+        cpu_bake_params.output_desc.bc6h_quality = lightmap_param.cpu_bc6h_quality;
+        cpu_bake_params.output_desc.mesh_rects = ComputeMeshLightmapRects(display_scene);
+        if (cpu_bake_params.shard_count > 1) {
+            RunShardedBake(argv[0], GetShardFilePrefix(lightmap_param.cpu_shard_temp_dir), as, lights, cpu_bake_params);
+        } else {
+            CpuBaker cpu_baker(as, lights, cpu_bake_params);
+            cpu_baker.Bake();
+            if (lightmap_param.cpu_shadow_ray_benchmark > 0) {
+                cpu_baker.BenchmarkShadowRays(lightmap_param.cpu_shadow_ray_benchmark);
+            }
+        }
     }
 
     glfwInit();
@@ -463,6 +834,7 @@ int main() {
     glfwSetCursorPosCallback(window, CursorPositionCallback);
     glfwSetMouseButtonCallback(window, MouseButtonCallback);
     glfwSetScrollCallback(window, MouseScrollCallback);
+    glfwSetKeyCallback(window, KeyCallback);
 
     for (uint32_t i = 0; i < display_scene.size(); ++i) {
         object_storages[i + 1].color[0] = RandomColor();
@@ -489,171 +861,70 @@ int main() {
         // 烘培
         if (!bake_prepared) {
             bake_prepared = true;
+            bake_start_time = std::chrono::high_resolution_clock::now();
 
-            float uv_offsets[5 * 5 * 2] =
-                    {
-                            -2, -2,
-                            2, -2,
-                            -2, 2,
-                            2, 2,
-
-                            -1, -2,
-                            1, -2,
-                            -2, -1,
-                            2, -1,
-                            -2, 1,
-                            2, 1,
-                            -1, 2,
-                            1, 2,
-
-                            -2, 0,
-                            2, 0,
-                            0, -2,
-                            0, 2,
-
-                            -1, -1,
-                            1, -1,
-                            -1, 0,
-                            1, 0,
-                            -1, 1,
-                            1, 1,
-                            0, -1,
-                            0, 1,
-
-                            0, 0
-                    };
-
-            // raster
             blast::GfxTextureBarrier texture_barriers[4];
-            texture_barriers[0].texture = position_tex;
-            texture_barriers[0].new_state = blast::RESOURCE_STATE_RENDERTARGET;
-            texture_barriers[1].texture = normal_tex;
-            texture_barriers[1].new_state = blast::RESOURCE_STATE_RENDERTARGET;
-            texture_barriers[2].texture = unocclude_tex;
-            texture_barriers[2].new_state = blast::RESOURCE_STATE_RENDERTARGET;
-            g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
-
-            g_device->RenderPassBegin(cmd, raster_renderpass);
-
-            blast::Viewport viewport;
-            viewport.x = 0;
-            viewport.y = 0;
-            viewport.w = lightmap_param.width;
-            viewport.h = lightmap_param.height;
-            g_device->BindViewports(cmd, 1, &viewport);
-
-            blast::Rect rect;
-            rect.left = 0;
-            rect.top = 0;
-            rect.right = lightmap_param.width;
-            rect.bottom = lightmap_param.height;
-            g_device->BindScissorRects(cmd, 1, &rect);
-
-            g_device->BindPipeline(cmd, raster_triangle_pipeline);
-
-            g_device->BindUAV(cmd, vertex_buffer, 0);
-
-            g_device->BindUAV(cmd, triangle_buffer, 1);
-
-            raster_param.atlas_size = glm::vec2(lightmap_param.width, lightmap_param.height);
-            for (int i = 0; i < 25; ++i) {
-                raster_param.uv_offset = glm::vec2(uv_offsets[i * 2], uv_offsets[i * 2 + 1]);
-                g_device->PushConstants(cmd, &raster_param, sizeof(RasterParam));
-
-                g_device->Draw(cmd, as->triangles.size() * 3, 0);
-            }
-
-//            g_device->BindPipeline(cmd, raster_line_pipeline);
-//
-//            g_device->BindUAV(cmd, vertex_buffer, 0);
-//
-//            g_device->BindUAV(cmd, triangle_buffer, 1);
-
-            //g_device->Draw(cmd, as->triangles.size() * 3, 0);
-
-            g_device->RenderPassEnd(cmd);
-
-            texture_barriers[0].texture = position_tex;
-            texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-            texture_barriers[1].texture = normal_tex;
-            texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-            texture_barriers[2].texture = unocclude_tex;
-            texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-            g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
 
             // ray trace
             bake_param.atlas_size = glm::ivec2(lightmap_param.width, lightmap_param.height);
             bake_param.grid_size = MAX_GRID_SIZE;
             bake_param.bias = 0.02f;
             bake_param.light_count = lights.size();
+            bake_param.max_light_samples = lightmap_param.max_light_samples;
+            bake_param.emissive_light_count = as->emissive_lights.size();
+            bake_param.emissive_light_samples = lightmap_param.emissive_light_samples;
+            bake_param.trace_counters = lightmap_param.gpu_trace_counters ? 1 : 0;
             bake_param.bound_size = glm::vec4(as->bounds.GetSize(), 0.0f);
             bake_param.to_cell_offset = glm::vec4(as->bounds.min, 0.0f);
             bake_param.to_cell_size.x = (1.0f / as->bounds.GetSize().x) * float(MAX_GRID_SIZE);
             bake_param.to_cell_size.y = (1.0f / as->bounds.GetSize().y) * float(MAX_GRID_SIZE);
             bake_param.to_cell_size.z = (1.0f / as->bounds.GetSize().z) * float(MAX_GRID_SIZE);
 
-            clear_param.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
-
-            // clear step
-            texture_barriers[0].texture = source_light_tex;
-            texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            texture_barriers[1].texture = dest_light_tex;
-            texture_barriers[1].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            texture_barriers[2].texture = sh_light_map;
-            texture_barriers[2].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            texture_barriers[3].texture = temp_sh_light_map;
-            texture_barriers[3].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            g_device->SetBarrier(cmd, 0, nullptr, 4, texture_barriers);
-
-            g_device->BindComputeShader(cmd, clear_color_shader);
+            // compact step
+            uint32_t zero = 0;
+            g_device->UpdateBuffer(cmd, texel_count_buffer, &zero, sizeof(uint32_t));
 
-            g_device->PushConstants(cmd, &clear_param, sizeof(ClearParam));
+            uint32_t zero_counters[10] = {};
+            g_device->UpdateBuffer(cmd, trace_counter_buffer, zero_counters, sizeof(zero_counters));
 
-            g_device->BindUAV(cmd, source_light_tex, 0);
+            blast::GfxBufferBarrier buffer_barriers[3];
+            buffer_barriers[0].buffer = texel_buffer;
+            buffer_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+            buffer_barriers[1].buffer = texel_count_buffer;
+            buffer_barriers[1].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+            buffer_barriers[2].buffer = trace_counter_buffer;
+            buffer_barriers[2].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+            g_device->SetBarrier(cmd, 3, buffer_barriers, 0, nullptr);
 
-            g_device->BindUAV(cmd, dest_light_tex, 1);
+            g_device->BindComputeShader(cmd, compact_texels_shader);
 
-            g_device->BindUAV(cmd, sh_light_map, 2);
+            g_device->BindUAV(cmd, texel_buffer, 0);
 
-            g_device->Dispatch(cmd, std::max(1u, (uint32_t)(lightmap_param.width) / 16), std::max(1u, (uint32_t)(lightmap_param.height) / 16), 1);
+            g_device->BindUAV(cmd, texel_count_buffer, 1);
 
-            // unocclude step
-            texture_barriers[0].texture = unocclude_tex;
-            texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            texture_barriers[1].texture = position_tex;
-            texture_barriers[1].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            g_device->SetBarrier(cmd, 0, nullptr, 2, texture_barriers);
-
-            g_device->BindComputeShader(cmd, unocclude_shader);
-
-            g_device->BindUAV(cmd, vertex_buffer, 0);
-
-            g_device->BindUAV(cmd, triangle_buffer, 1);
-
-            g_device->BindUAV(cmd, triangle_index_buffer, 2);
-
-            g_device->BindUAV(cmd, position_tex, 3);
+            g_device->BindResource(cmd, position_tex, 0);
 
-            g_device->BindUAV(cmd, unocclude_tex, 4);
+            g_device->BindResource(cmd, normal_tex, 1);
 
             g_device->BindSampler(cmd, nearest_sampler, 0);
 
-            g_device->BindResource(cmd, grid_tex, 0);
+            compact_param.atlas_size = glm::ivec2(lightmap_param.width, lightmap_param.height);
+            g_device->PushConstants(cmd, &compact_param, sizeof(CompactParam));
 
-            g_device->PushConstants(cmd, &bake_param, sizeof(BakeParam));
+            g_device->Dispatch(cmd, (lightmap_param.width + 15) / 16, (lightmap_param.height + 15) / 16, 1);
 
-            g_device->Dispatch(cmd, std::max(1u, (uint32_t)(lightmap_param.width) / 16), std::max(1u, (uint32_t)(lightmap_param.height) / 16), 1);
+            g_device->SetBarrier(cmd, 3, buffer_barriers, 0, nullptr);
 
-            texture_barriers[0].texture = position_tex;
-            texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-            g_device->SetBarrier(cmd, 0, nullptr, 1, texture_barriers);
+            glm::uvec2 texel_group_count = GetTexelGroupCount(lightmap_param.texel_count);
+            bake_param.texel_offset = 0;
+            bake_param.texel_stride = texel_group_count.x * 64;
 
-            // direct step
-            texture_barriers[0].texture = source_light_tex;
+            // unocclude step
+            texture_barriers[0].texture = unocclude_tex;
             texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
             g_device->SetBarrier(cmd, 0, nullptr, 1, texture_barriers);
 
-            g_device->BindComputeShader(cmd, direct_light_shader);
+            g_device->BindComputeShader(cmd, unocclude_shader);
 
             g_device->BindUAV(cmd, vertex_buffer, 0);
 
@@ -661,50 +932,55 @@ int main() {
 
             g_device->BindUAV(cmd, triangle_index_buffer, 2);
 
-            g_device->BindUAV(cmd, light_buffer, 3);
-
-            g_device->BindUAV(cmd, source_light_tex, 4);
-
-            g_device->BindUAV(cmd, sh_light_map, 5);
+            g_device->BindUAV(cmd, texel_buffer, 3);
 
-            g_device->BindSampler(cmd, linear_sampler, 0);
+            g_device->BindUAV(cmd, texel_count_buffer, 4);
 
-            g_device->BindSampler(cmd, nearest_sampler, 1);
+            g_device->BindUAV(cmd, unocclude_tex, 5);
 
-            g_device->BindResource(cmd, position_tex, 0);
+            g_device->BindUAV(cmd, trace_counter_buffer, 15);
 
-            g_device->BindResource(cmd, normal_tex, 1);
+            g_device->BindSampler(cmd, nearest_sampler, 0);
 
-            g_device->BindResource(cmd, grid_tex, 2);
+            g_device->BindResource(cmd, grid_tex, 0);
 
             g_device->PushConstants(cmd, &bake_param, sizeof(BakeParam));
 
-            g_device->Dispatch(cmd, std::max(1u, (uint32_t)(lightmap_param.width) / 16), std::max(1u, (uint32_t)(lightmap_param.height) / 16), 1);
+            g_device->Dispatch(cmd, texel_group_count.x, texel_group_count.y, 1);
 
-            texture_barriers[0].texture = source_light_tex;
-            texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-            g_device->SetBarrier(cmd, 0, nullptr, 1, texture_barriers);
+            g_device->SetBarrier(cmd, 3, buffer_barriers, 0, nullptr);
+
+            // 分组烘焙时从第0组开始, 每组的弹射结束后在下面的烘焙循环中切换到下一组
+            current_light_group = 0;
+            bake_param.light_group = light_group_count > 0 ? 0 : 0xffffffff;
+            DispatchDirectLight(cmd);
         }
 
         if (bake_prepared && !bake_completed) {
             blast::GfxTextureBarrier texture_barriers[4];
 
-            uint32_t x = current_x_regions * lightmap_param.max_region_size;
-            uint32_t y = current_y_regions * lightmap_param.max_region_size;
-            uint32_t w = glm::min((current_x_regions + 1) * lightmap_param.max_region_size, lightmap_param.width) - x;
-            uint32_t h = glm::min((current_y_regions + 1) * lightmap_param.max_region_size, lightmap_param.height) - y;
-            glm::ivec3 group_size = glm::ivec3(std::max(1u, (uint32_t)(lightmap_param.max_region_size) / 16), std::max(1u, (uint32_t)(lightmap_param.max_region_size) / 16), 1);
+            // 最后一个区域只派发剩余的纹素
+            uint32_t region_offset = current_regions * lightmap_param.region_texel_count;
+            glm::uvec2 group_size = GetTexelGroupCount(std::min(lightmap_param.region_texel_count, lightmap_param.texel_count - region_offset));
 
-            bake_param.offset_x = x;
-            bake_param.offset_y = y;
+            bake_param.texel_offset = region_offset;
+            bake_param.texel_stride = group_size.x * 64;
             bake_param.max_iterations = lightmap_param.ray_iterations;
             bake_param.current_iterations = current_ray_iterations;
             bake_param.ray_count = lightmap_param.ray_count_per_texel;
             bake_param.ray_count_per_iteration = lightmap_param.ray_count_per_iteration;
+            bake_param.min_iterations = lightmap_param.min_ray_iterations;
+            // 各组的提前终止不同会使合并后的结果与不分组时不一致, 分组烘焙时每组都迭代到ray_iterations
+            bake_param.error_threshold = light_group_count > 0 ? 0.0f : lightmap_param.adaptive_error_threshold;
+            // 路径延续模式下由shader完成所有弹射, 否则每遍pass只收集一次
+            bake_param.bounces = lightmap_param.path_continuation ? lightmap_param.bounces : 1;
+            bake_param.current_bounce = current_bounces;
             BakeParam temp_bake_param = bake_param;
 
-            // 交换rt
-            if (current_bounces > 0) {
+            uint32_t bounce_passes = lightmap_param.path_continuation ? 1 : lightmap_param.bounces;
+
+            // 每次弹射开始时交换rt
+            if (current_bounces > 0 && current_regions == 0 && current_ray_iterations == 0) {
                 blast::GfxTexture* temp = source_light_tex;
                 source_light_tex = dest_light_tex;
                 dest_light_tex = temp;
@@ -715,7 +991,9 @@ int main() {
             texture_barriers[1].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
             texture_barriers[2].texture = sh_light_map;
             texture_barriers[2].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-            g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
+            texture_barriers[3].texture = variance_tex;
+            texture_barriers[3].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+            g_device->SetBarrier(cmd, 0, nullptr, 4, texture_barriers);
 
             g_device->BindComputeShader(cmd, bounce_light_shader);
 
@@ -727,77 +1005,115 @@ int main() {
 
             g_device->BindUAV(cmd, light_buffer, 3);
 
-            g_device->BindUAV(cmd, dest_light_tex, 4);
+            g_device->BindUAV(cmd, texel_buffer, 4);
+
+            g_device->BindUAV(cmd, texel_count_buffer, 5);
 
-            g_device->BindUAV(cmd, sh_light_map, 5);
+            g_device->BindUAV(cmd, dest_light_tex, 6);
+
+            g_device->BindUAV(cmd, sh_light_map, 7);
 
             // 因为unocclude_tex已经没有用处了,所以拿来做暂存资源
-            g_device->BindUAV(cmd, unocclude_tex, 6);
+            g_device->BindUAV(cmd, unocclude_tex, 8);
 
-            g_device->BindSampler(cmd, linear_sampler, 0);
+            // temp_sh_light_map在dilate之前没有用处, 用来累加SH
+            g_device->BindUAV(cmd, temp_sh_light_map, 9);
 
-            g_device->BindSampler(cmd, nearest_sampler, 1);
+            g_device->BindUAV(cmd, variance_tex, 10);
 
-            g_device->BindResource(cmd, position_tex, 0);
+            g_device->BindUAV(cmd, environment_buffer, 11);
 
-            g_device->BindResource(cmd, normal_tex, 1);
+            g_device->BindUAV(cmd, environment_cdf_buffer, 12);
 
-            g_device->BindResource(cmd, grid_tex, 2);
+            g_device->BindUAV(cmd, light_group_buffer, 13);
 
-            g_device->BindResource(cmd, source_light_tex, 3);
+            g_device->BindUAV(cmd, trace_counter_buffer, 15);
 
-            g_device->PushConstants(cmd, &temp_bake_param, sizeof(BakeParam));
+            g_device->BindSampler(cmd, linear_sampler, 0);
 
-            g_device->Dispatch(cmd, group_size.x, group_size.y, group_size.z);
+            g_device->BindSampler(cmd, nearest_sampler, 1);
 
-            printf("current process %d    %d    %d   %d\n", current_bounces, current_x_regions, current_y_regions, current_ray_iterations);
+            g_device->BindResource(cmd, grid_tex, 0);
 
-            current_ray_iterations++;
-            if (current_ray_iterations == lightmap_param.ray_iterations) {
-                current_ray_iterations = 0;
+            g_device->BindResource(cmd, source_light_tex, 1);
 
-                current_x_regions++;
-                if (current_x_regions >= lightmap_param.x_regions) {
-                    current_x_regions = 0;
-                    current_y_regions++;
-                }
+            g_device->BindResource(cmd, albedo_tex, 2);
 
-                if (current_y_regions >= lightmap_param.y_regions) {
-                    current_x_regions = 0;
-                    current_y_regions = 0;
-                    current_bounces++;
-                }
-            }
-            if (current_bounces == lightmap_param.bounces) {
-                // dilate step
-                blast::GfxTexture* temp = sh_light_map;
-                sh_light_map = temp_sh_light_map;
-                temp_sh_light_map = temp;
-                texture_barriers[0].texture = sh_light_map;
-                texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
-                texture_barriers[1].texture = temp_sh_light_map;
-                texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-                g_device->SetBarrier(cmd, 0, nullptr, 2, texture_barriers);
+            g_device->PushConstants(cmd, &temp_bake_param, sizeof(BakeParam));
 
-                g_device->BindComputeShader(cmd, dilate_shader);
+            g_device->Dispatch(cmd, group_size.x, group_size.y, 1);
 
-                g_device->BindResource(cmd, temp_sh_light_map, 0);
+            // 超出纹素数量或已收敛的线程不会追踪光线, 因此只是上限
+            bounce_dispatches++;
+            bounce_ray_budget += uint64_t(group_size.x) * group_size.y * 64 * lightmap_param.ray_count_per_iteration;
 
-                g_device->BindUAV(cmd, sh_light_map, 0);
+            printf("current process %d    %d   %d\n", current_bounces, current_regions, current_ray_iterations);
 
-                g_device->BindSampler(cmd, linear_sampler, 0);
+            if (lightmap_param.progressive) {
+                current_regions++;
+                if (current_regions >= lightmap_param.texel_regions) {
+                    current_regions = 0;
+                    current_ray_iterations++;
+                }
 
-                g_device->Dispatch(cmd, std::max(1u, (uint32_t)(lightmap_param.width) / 16), std::max(1u, (uint32_t)(lightmap_param.height) / 16), 1);
+                // 每组的每次弹射平分时间预算, 超时的弹射结果已经归一化, 直接进入下一次弹射
+                // 至少完成一遍完整的迭代, 保证每个纹素都有结果
+                bool out_of_time = false;
+                if (lightmap_param.time_budget > 0.0f && current_ray_iterations > 0) {
+                    std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - bake_start_time;
+                    uint32_t total_passes = std::max(1u, light_group_count) * bounce_passes;
+                    out_of_time = elapsed.count() >= lightmap_param.time_budget * (current_light_group * bounce_passes + current_bounces + 1) / total_passes;
+                }
 
-                texture_barriers[0].texture = dest_light_tex;
-                texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-                texture_barriers[1].texture = sh_light_map;
-                texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-                texture_barriers[2].texture = temp_sh_light_map;
-                texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
-                g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
+                if (current_ray_iterations == lightmap_param.ray_iterations || out_of_time) {
+                    if (out_of_time) {
+                        printf("bounce %d stopped by time budget after %d iterations\n", current_bounces, current_ray_iterations);
+                    }
+                    current_ray_iterations = 0;
+                    current_regions = 0;
+                    current_bounces++;
+                }
+            } else {
+                current_ray_iterations++;
+                if (current_ray_iterations == lightmap_param.ray_iterations) {
+                    current_ray_iterations = 0;
+
+                    current_regions++;
+                    if (current_regions >= lightmap_param.texel_regions) {
+                        current_regions = 0;
+                        current_bounces++;
+                    }
+                }
+            }
+            if (current_bounces == bounce_passes && light_group_count > 0) {
+                // 保存这一组降噪之前的结果, 还有下一组时从直接光照重新开始
+                ComposeLightGroup(cmd, dest_light_tex, sh_light_map, variance_tex, group_light_texs[current_light_group], group_sh_light_maps[current_light_group],
+                                  group_variance_texs[current_light_group], glm::vec3(1.0f), false);
+                current_light_group++;
+                if (current_light_group < light_group_count) {
+                    printf("light group %d finished\n", current_light_group - 1);
+                    current_bounces = 0;
+                    bake_param.light_group = current_light_group;
+                    DispatchDirectLight(cmd);
+                } else {
+                    ComposeLightGroups(cmd);
+                }
+            }
+            if (current_bounces == bounce_passes) {
+                DenoiseAndDilate(cmd);
 
                 bake_completed = true;
+
+                if (!lightmap_param.stats_report.empty()) {
+                    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - bake_start_time;
+                    BakeStats stats;
+                    stats.AddTiming("total", elapsed.count() * 1000.0);
+                    stats.AddCounter("atlas_texels", uint64_t(lightmap_param.width) * lightmap_param.height);
+                    stats.AddCounter("bounce_dispatches", bounce_dispatches);
+                    stats.AddCounter("bounce_ray_budget", bounce_ray_budget);
+                    stats.AddValue("bounce_ray_budget_upper_bound_per_second", bounce_ray_budget / elapsed.count());
+                    stats.WriteJson(lightmap_param.stats_report);
+                }
             } else {
                 texture_barriers[0].texture = dest_light_tex;
                 texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
@@ -807,6 +1123,13 @@ int main() {
             }
         }
 
+        // 烘焙结束后修改了分组权重, 重新合成并降噪扩展
+        if (bake_completed && relight_pending) {
+            relight_pending = false;
+            ComposeLightGroups(cmd);
+            DenoiseAndDilate(cmd);
+        }
+
         // 更新Object Uniform
         object_storages[0].model_matrix = glm::toMat4(glm::quat(glm::vec3(glm::radians(-90.0f), 0.0f, 0.0f)));
         object_storages[0].view_matrix = glm::mat4(1.0f);
@@ -970,19 +1293,20 @@ int main() {
     g_device->DestroyShader(blit_frag_shader);
     g_device->DestroyShader(scene_vert_shader);
     g_device->DestroyShader(scene_frag_shader);
-    g_device->DestroyShader(raster_vert_shader);
-    g_device->DestroyShader(raster_frag_shader);
     g_device->DestroyShader(clear_color_shader);
     g_device->DestroyShader(direct_light_shader);
     g_device->DestroyShader(bounce_light_shader);
+    g_device->DestroyShader(jump_flood_shader);
     g_device->DestroyShader(dilate_shader);
+    g_device->DestroyShader(denoise_shader);
     g_device->DestroyShader(unocclude_shader);
+    g_device->DestroyShader(compact_texels_shader);
+    g_device->DestroyShader(compose_light_groups_shader);
 
-    // 清除光栅化RenderPass资源
+    // 清除G-buffer资源
     g_device->DestroyTexture(position_tex);
     g_device->DestroyTexture(normal_tex);
     g_device->DestroyTexture(unocclude_tex);
-    g_device->DestroyRenderPass(raster_renderpass);
 
     // 销毁GPU Buffer
     g_device->DestroyBuffer(object_ub);
@@ -994,15 +1318,32 @@ int main() {
     g_device->DestroyBuffer(triangle_buffer);
     g_device->DestroyBuffer(triangle_index_buffer);
     g_device->DestroyTexture(grid_tex);
+    g_device->DestroyTexture(albedo_tex);
 
     // LightMap
     g_device->DestroySampler(linear_sampler);
     g_device->DestroySampler(nearest_sampler);
     g_device->DestroyBuffer(light_buffer);
+    g_device->DestroyBuffer(light_grid_buffer);
+    g_device->DestroyBuffer(light_index_buffer);
+    g_device->DestroyBuffer(triangle_material_buffer);
+    g_device->DestroyBuffer(emissive_light_buffer);
+    g_device->DestroyBuffer(environment_buffer);
+    g_device->DestroyBuffer(environment_cdf_buffer);
     g_device->DestroyTexture(source_light_tex);
     g_device->DestroyTexture(dest_light_tex);
     g_device->DestroyTexture(sh_light_map);
     g_device->DestroyTexture(temp_sh_light_map);
+    g_device->DestroyTexture(variance_tex);
+    g_device->DestroyBuffer(texel_buffer);
+    g_device->DestroyBuffer(texel_count_buffer);
+    g_device->DestroyBuffer(trace_counter_buffer);
+    g_device->DestroyBuffer(light_group_buffer);
+    for (uint32_t i = 0; i < light_group_count; ++i) {
+        g_device->DestroyTexture(group_light_texs[i]);
+        g_device->DestroyTexture(group_sh_light_maps[i]);
+        g_device->DestroyTexture(group_variance_texs[i]);
+    }
 
     if (scene_renderpass) {
         g_device->DestroyTexture(scene_color_tex);
@@ -1021,14 +1362,6 @@ int main() {
     if (scene_pipeline) {
         g_device->DestroyPipeline(scene_pipeline);
     }
-    if (raster_line_pipeline) {
-        g_device->DestroyPipeline(raster_line_pipeline);
-    }
-
-    if (raster_triangle_pipeline) {
-        g_device->DestroyPipeline(raster_triangle_pipeline);
-    }
-
     g_device->DestroySwapChain(g_swapchain);
 
     SAFE_DELETE(g_device);
@@ -1174,34 +1507,92 @@ void RefreshSwapchain(void* window, uint32_t width, uint32_t height) {
         pipeline_desc.sample_count = g_sample_count;
         scene_pipeline = g_device->CreatePipeline(pipeline_desc);
     }
+}
 
-    // raster pipeline
-    {
-        if (raster_line_pipeline) {
-            g_device->DestroyPipeline(raster_line_pipeline);
-        }
+// 编译器或缓存格式变化时递增, 使旧的缓存失效
+static const uint32_t SHADER_CACHE_VERSION = 1;
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// 缓存key由展开后的源码和stage计算, 变体宏写在源码中, 因此也包含在内
+static uint64_t HashShaderSource(const std::string& source, uint32_t stage) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint8_t byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for (char c : source) {
+        mix((uint8_t)c);
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+        mix((uint8_t)(stage >> (i * 8)));
+        mix((uint8_t)(SHADER_CACHE_VERSION >> (i * 8)));
+    }
+    return hash;
+}
 
-        if (raster_triangle_pipeline) {
-            g_device->DestroyPipeline(raster_triangle_pipeline);
+// 优先读取SPIR-V缓存, 没有命中时才创建编译器编译并写入缓存
+static std::vector<uint32_t> LoadShaderBytecode(const std::string& path, blast::ShaderCompileDesc& compile_desc) {
+    compile_desc.code = ReadShaderSource(path);
+    char hash_str[17];
+    sprintf(hash_str, "%016llx", (unsigned long long)HashShaderSource(compile_desc.code, (uint32_t)compile_desc.stage));
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    std::string cache_path = ProjectDir + "/Resources/ShaderCache/" + name + "." + hash_str + ".spv";
+
+    // 写入中断的缓存长度不是4的倍数或缺少SPIR-V magic, 这种情况下重新编译并覆盖
+    std::vector<uint32_t> bytecode;
+    std::ifstream cache_file(cache_path, std::ios_base::binary);
+    if (cache_file) {
+        std::string data((std::istreambuf_iterator<char>(cache_file)), std::istreambuf_iterator<char>());
+        if (!data.empty() && data.size() % sizeof(uint32_t) == 0) {
+            bytecode.resize(data.size() / sizeof(uint32_t));
+            memcpy(bytecode.data(), data.data(), data.size());
+            if (bytecode[0] == SPIRV_MAGIC) {
+                return bytecode;
+            }
         }
+        BLAST_LOGW("ignore invalid shader cache %s \n", cache_path.c_str());
+        bytecode.clear();
+    }
 
-        blast::GfxInputLayout null_input_layout = {};
-        blast::GfxPipelineDesc pipeline_desc;
-        pipeline_desc.rp = raster_renderpass;
-        pipeline_desc.vs = raster_vert_shader;
-        pipeline_desc.fs = raster_frag_shader;
-        pipeline_desc.il = &null_input_layout;
-        pipeline_desc.bs = &blend_state;
-        pipeline_desc.rs = &rasterizer_state;
-        pipeline_desc.dss = &depth_stencil_state;
-        pipeline_desc.primitive_topo = blast::PRIMITIVE_TOPO_TRI_LIST;
-        raster_triangle_pipeline = g_device->CreatePipeline(pipeline_desc);
+    if (!g_shader_compiler) {
+        g_shader_compiler = new blast::VulkanShaderCompiler();
+    }
+    blast::ShaderCompileResult compile_result = g_shader_compiler->Compile(compile_desc);
+    bytecode.assign(compile_result.bytes.begin(), compile_result.bytes.end());
+    if (bytecode.empty()) {
+        BLAST_LOGW("failed to compile shader %s \n", path.c_str());
+        return bytecode;
+    }
 
-        blast::GfxRasterizerState wireframe_rasterizer_state = rasterizer_state;
-        wireframe_rasterizer_state.fill_mode = blast::FILL_WIREFRAME;
-        pipeline_desc.rs = &wireframe_rasterizer_state;
-        raster_line_pipeline = g_device->CreatePipeline(pipeline_desc);
+    std::ofstream out_file(cache_path, std::ios_base::binary);
+    if (out_file) {
+        out_file.write((const char*)bytecode.data(), bytecode.size() * sizeof(uint32_t));
+    } else {
+        BLAST_LOGW("cannot write shader cache %s \n", cache_path.c_str());
     }
+    return bytecode;
+}
+
+static bool PrecompileShaders() {
+    bool success = true;
+    for (const char* file : SHADER_FILES) {
+        std::string path = ProjectDir + "/Resources/Shaders/" + file;
+        std::string ext = path.substr(path.find_last_of('.') + 1);
+        blast::ShaderCompileDesc compile_desc;
+        if (ext == "vert") {
+            compile_desc.stage = blast::SHADER_STAGE_VERT;
+        } else if (ext == "frag") {
+            compile_desc.stage = blast::SHADER_STAGE_FRAG;
+        } else {
+            compile_desc.stage = blast::SHADER_STAGE_COMP;
+        }
+
+        if (LoadShaderBytecode(path, compile_desc).empty()) {
+            success = false;
+        }
+    }
+    return success;
 }
 
 static std::pair<blast::GfxShader*, blast::GfxShader*> CompileShaderProgram(const std::string& vs_path, const std::string& fs_path) {
@@ -1209,25 +1600,23 @@ static std::pair<blast::GfxShader*, blast::GfxShader*> CompileShaderProgram(cons
     blast::GfxShader* frag_shader = nullptr;
     {
         blast::ShaderCompileDesc compile_desc;
-        compile_desc.code = ReadFileData(vs_path);
         compile_desc.stage = blast::SHADER_STAGE_VERT;
-        blast::ShaderCompileResult compile_result = g_shader_compiler->Compile(compile_desc);
+        std::vector<uint32_t> bytecode = LoadShaderBytecode(vs_path, compile_desc);
         blast::GfxShaderDesc shader_desc;
         shader_desc.stage = blast::SHADER_STAGE_VERT;
-        shader_desc.bytecode = compile_result.bytes.data();
-        shader_desc.bytecode_length = compile_result.bytes.size() * sizeof(uint32_t);
+        shader_desc.bytecode = bytecode.data();
+        shader_desc.bytecode_length = bytecode.size() * sizeof(uint32_t);
         vert_shader = g_device->CreateShader(shader_desc);
     }
 
     {
         blast::ShaderCompileDesc compile_desc;
-        compile_desc.code = ReadFileData(fs_path);
         compile_desc.stage = blast::SHADER_STAGE_FRAG;
-        blast::ShaderCompileResult compile_result = g_shader_compiler->Compile(compile_desc);
+        std::vector<uint32_t> bytecode = LoadShaderBytecode(fs_path, compile_desc);
         blast::GfxShaderDesc shader_desc;
         shader_desc.stage = blast::SHADER_STAGE_FRAG;
-        shader_desc.bytecode = compile_result.bytes.data();
-        shader_desc.bytecode_length = compile_result.bytes.size() * sizeof(uint32_t);
+        shader_desc.bytecode = bytecode.data();
+        shader_desc.bytecode_length = bytecode.size() * sizeof(uint32_t);
         frag_shader = g_device->CreateShader(shader_desc);
     }
 
@@ -1237,17 +1626,281 @@ static std::pair<blast::GfxShader*, blast::GfxShader*> CompileShaderProgram(cons
 static blast::GfxShader* CompileComputeShader(const std::string& cs_path) {
     blast::GfxShader* comp_shader = nullptr;
     blast::ShaderCompileDesc compile_desc;
-    compile_desc.code = ReadFileData(cs_path);
     compile_desc.stage = blast::SHADER_STAGE_COMP;
-    blast::ShaderCompileResult compile_result = g_shader_compiler->Compile(compile_desc);
+    std::vector<uint32_t> bytecode = LoadShaderBytecode(cs_path, compile_desc);
     blast::GfxShaderDesc shader_desc;
     shader_desc.stage = blast::SHADER_STAGE_COMP;
-    shader_desc.bytecode = compile_result.bytes.data();
-    shader_desc.bytecode_length = compile_result.bytes.size() * sizeof(uint32_t);
+    shader_desc.bytecode = bytecode.data();
+    shader_desc.bytecode_length = bytecode.size() * sizeof(uint32_t);
     comp_shader = g_device->CreateShader(shader_desc);
     return comp_shader;
 }
 
+static glm::uvec2 GetTexelGroupCount(uint32_t texel_count) {
+    // 纹素列表按一维处理, 工作组数量超出单维限制时折叠到y方向
+    uint32_t group_count = std::max(1u, (texel_count + 63) / 64);
+    uint32_t group_x = std::min(group_count, 4096u);
+    uint32_t group_y = (group_count + group_x - 1) / group_x;
+    return glm::uvec2(group_x, group_y);
+}
+
+static void DispatchDirectLight(blast::GfxCommandBuffer* cmd) {
+    blast::GfxTextureBarrier texture_barriers[4];
+
+    clear_param.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // clear step
+    texture_barriers[0].texture = source_light_tex;
+    texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    texture_barriers[1].texture = dest_light_tex;
+    texture_barriers[1].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    texture_barriers[2].texture = sh_light_map;
+    texture_barriers[2].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    texture_barriers[3].texture = temp_sh_light_map;
+    texture_barriers[3].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    g_device->SetBarrier(cmd, 0, nullptr, 4, texture_barriers);
+
+    g_device->BindComputeShader(cmd, clear_color_shader);
+
+    g_device->PushConstants(cmd, &clear_param, sizeof(ClearParam));
+
+    g_device->BindUAV(cmd, source_light_tex, 0);
+
+    g_device->BindUAV(cmd, dest_light_tex, 1);
+
+    g_device->BindUAV(cmd, sh_light_map, 2);
+
+    g_device->Dispatch(cmd, std::max(1u, (uint32_t)(lightmap_param.width) / 16), std::max(1u, (uint32_t)(lightmap_param.height) / 16), 1);
+
+    glm::uvec2 texel_group_count = GetTexelGroupCount(lightmap_param.texel_count);
+    bake_param.texel_offset = 0;
+    bake_param.texel_stride = texel_group_count.x * 64;
+
+    // direct step
+    texture_barriers[0].texture = source_light_tex;
+    texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    g_device->SetBarrier(cmd, 0, nullptr, 1, texture_barriers);
+
+    g_device->BindComputeShader(cmd, direct_light_shader);
+
+    g_device->BindUAV(cmd, vertex_buffer, 0);
+
+    g_device->BindUAV(cmd, triangle_buffer, 1);
+
+    g_device->BindUAV(cmd, triangle_index_buffer, 2);
+
+    g_device->BindUAV(cmd, light_buffer, 3);
+
+    g_device->BindUAV(cmd, texel_buffer, 4);
+
+    g_device->BindUAV(cmd, texel_count_buffer, 5);
+
+    g_device->BindUAV(cmd, source_light_tex, 6);
+
+    g_device->BindUAV(cmd, sh_light_map, 7);
+
+    g_device->BindUAV(cmd, light_grid_buffer, 8);
+
+    g_device->BindUAV(cmd, light_index_buffer, 9);
+
+    g_device->BindUAV(cmd, triangle_material_buffer, 10);
+
+    g_device->BindUAV(cmd, emissive_light_buffer, 11);
+
+    g_device->BindUAV(cmd, light_group_buffer, 13);
+
+    g_device->BindUAV(cmd, trace_counter_buffer, 15);
+
+    g_device->BindSampler(cmd, linear_sampler, 0);
+
+    g_device->BindSampler(cmd, nearest_sampler, 1);
+
+    g_device->BindResource(cmd, grid_tex, 0);
+
+    g_device->BindResource(cmd, normal_tex, 1);
+
+    g_device->BindResource(cmd, albedo_tex, 2);
+
+    g_device->PushConstants(cmd, &bake_param, sizeof(BakeParam));
+
+    g_device->Dispatch(cmd, texel_group_count.x, texel_group_count.y, 1);
+
+    texture_barriers[0].texture = source_light_tex;
+    texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    g_device->SetBarrier(cmd, 0, nullptr, 1, texture_barriers);
+}
+
+static void ComposeLightGroup(blast::GfxCommandBuffer* cmd, blast::GfxTexture* source_light, blast::GfxTexture* source_sh, blast::GfxTexture* source_variance,
+                              blast::GfxTexture* dest_light, blast::GfxTexture* dest_sh, blast::GfxTexture* dest_variance, const glm::vec3& weight, bool accumulate) {
+    blast::GfxTextureBarrier texture_barriers[6];
+    texture_barriers[0].texture = source_light;
+    texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    texture_barriers[1].texture = source_sh;
+    texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    texture_barriers[2].texture = source_variance;
+    texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    texture_barriers[3].texture = dest_light;
+    texture_barriers[3].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    texture_barriers[4].texture = dest_sh;
+    texture_barriers[4].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    texture_barriers[5].texture = dest_variance;
+    texture_barriers[5].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    g_device->SetBarrier(cmd, 0, nullptr, 6, texture_barriers);
+
+    g_device->BindComputeShader(cmd, compose_light_groups_shader);
+
+    g_device->BindResource(cmd, source_light, 0);
+
+    g_device->BindResource(cmd, source_sh, 1);
+
+    g_device->BindResource(cmd, source_variance, 2);
+
+    g_device->BindUAV(cmd, dest_light, 0);
+
+    g_device->BindUAV(cmd, dest_sh, 1);
+
+    g_device->BindUAV(cmd, dest_variance, 2);
+
+    g_device->BindSampler(cmd, nearest_sampler, 0);
+
+    compose_param.weight = glm::vec4(weight, 0.0f);
+    compose_param.atlas_size = glm::ivec2(lightmap_param.width, lightmap_param.height);
+    compose_param.accumulate = accumulate ? 1 : 0;
+    g_device->PushConstants(cmd, &compose_param, sizeof(ComposeParam));
+
+    g_device->Dispatch(cmd, (lightmap_param.width + 15) / 16, (lightmap_param.height + 15) / 16, 1);
+}
+
+static void ComposeLightGroups(blast::GfxCommandBuffer* cmd) {
+    // 与CpuBaker::Relight一致, 降噪和扩展不是线性的, 合成之后再执行
+    for (uint32_t i = 0; i < light_group_count; ++i) {
+        ComposeLightGroup(cmd, group_light_texs[i], group_sh_light_maps[i], group_variance_texs[i], dest_light_tex, sh_light_map, variance_tex, light_group_weights[i], i > 0);
+    }
+}
+
+static void DenoiseAndDilate(blast::GfxCommandBuffer* cmd) {
+    blast::GfxTextureBarrier texture_barriers[4];
+
+    // denoise step, SH和方差各自在两张纹理间交替, 结束后结果在sh_light_map中
+    // unocclude_tex在弹射结束后没有用处了, 用来交替存放方差
+    blast::GfxTexture* source_variance = variance_tex;
+    blast::GfxTexture* dest_variance = unocclude_tex;
+    for (uint32_t i = 0; i < lightmap_param.denoise.iterations; ++i) {
+        blast::GfxTexture* temp = sh_light_map;
+        sh_light_map = temp_sh_light_map;
+        temp_sh_light_map = temp;
+        texture_barriers[0].texture = sh_light_map;
+        texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        texture_barriers[1].texture = temp_sh_light_map;
+        texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[2].texture = source_variance;
+        texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[3].texture = dest_variance;
+        texture_barriers[3].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        g_device->SetBarrier(cmd, 0, nullptr, 4, texture_barriers);
+
+        g_device->BindComputeShader(cmd, denoise_shader);
+
+        g_device->BindResource(cmd, temp_sh_light_map, 0);
+
+        g_device->BindResource(cmd, position_tex, 1);
+
+        g_device->BindResource(cmd, normal_tex, 2);
+
+        g_device->BindResource(cmd, source_variance, 3);
+
+        g_device->BindUAV(cmd, sh_light_map, 0);
+
+        g_device->BindUAV(cmd, triangle_buffer, 1);
+
+        g_device->BindUAV(cmd, dest_variance, 2);
+
+        g_device->BindSampler(cmd, linear_sampler, 0);
+
+        denoise_param.atlas_size = glm::ivec2(lightmap_param.width, lightmap_param.height);
+        denoise_param.step = 1 << i;
+        denoise_param.sigma_plane = lightmap_param.denoise.sigma_plane;
+        denoise_param.normal_power = lightmap_param.denoise.normal_power;
+        denoise_param.sigma_luminance = lightmap_param.denoise.sigma_luminance;
+        g_device->PushConstants(cmd, &denoise_param, sizeof(DenoiseParam));
+
+        g_device->Dispatch(cmd, (lightmap_param.width + 15) / 16, (lightmap_param.height + 15) / 16, 1);
+
+        temp = source_variance;
+        source_variance = dest_variance;
+        dest_variance = temp;
+    }
+
+    // dilate step, 先用jump flood找到每个纹素最近的已覆盖纹素, 第一遍根据SH初始化
+    // 降噪结束后unocclude_tex和variance_tex都没有用处了, 用来交替存放jump flood的结果
+    std::vector<uint32_t> jump_flood_steps = GetJumpFloodSteps(lightmap_param.dilate_radius);
+    blast::GfxTexture* source_seed = unocclude_tex;
+    blast::GfxTexture* dest_seed = variance_tex;
+    jump_flood_param.atlas_size = glm::ivec2(lightmap_param.width, lightmap_param.height);
+    jump_flood_param.radius = lightmap_param.dilate_radius;
+    for (uint32_t i = 0; i <= jump_flood_steps.size(); ++i) {
+        texture_barriers[0].texture = sh_light_map;
+        texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[1].texture = source_seed;
+        texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+        texture_barriers[2].texture = dest_seed;
+        texture_barriers[2].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+        g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
+
+        g_device->BindComputeShader(cmd, jump_flood_shader);
+
+        g_device->BindResource(cmd, sh_light_map, 0);
+
+        g_device->BindResource(cmd, source_seed, 1);
+
+        g_device->BindUAV(cmd, dest_seed, 0);
+
+        g_device->BindSampler(cmd, linear_sampler, 0);
+
+        jump_flood_param.step = i == 0 ? 0 : jump_flood_steps[i - 1];
+        g_device->PushConstants(cmd, &jump_flood_param, sizeof(JumpFloodParam));
+
+        g_device->Dispatch(cmd, (lightmap_param.width + 15) / 16, (lightmap_param.height + 15) / 16, 1);
+
+        blast::GfxTexture* temp = source_seed;
+        source_seed = dest_seed;
+        dest_seed = temp;
+    }
+
+    blast::GfxTexture* temp = sh_light_map;
+    sh_light_map = temp_sh_light_map;
+    temp_sh_light_map = temp;
+    texture_barriers[0].texture = sh_light_map;
+    texture_barriers[0].new_state = blast::RESOURCE_STATE_UNORDERED_ACCESS;
+    texture_barriers[1].texture = temp_sh_light_map;
+    texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    texture_barriers[2].texture = source_seed;
+    texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
+
+    g_device->BindComputeShader(cmd, dilate_shader);
+
+    g_device->BindResource(cmd, temp_sh_light_map, 0);
+
+    g_device->BindResource(cmd, source_seed, 1);
+
+    g_device->BindUAV(cmd, sh_light_map, 0);
+
+    g_device->BindSampler(cmd, linear_sampler, 0);
+
+    g_device->PushConstants(cmd, &jump_flood_param, sizeof(JumpFloodParam));
+
+    g_device->Dispatch(cmd, (lightmap_param.width + 15) / 16, (lightmap_param.height + 15) / 16, 1);
+
+    texture_barriers[0].texture = dest_light_tex;
+    texture_barriers[0].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    texture_barriers[1].texture = sh_light_map;
+    texture_barriers[1].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    texture_barriers[2].texture = temp_sh_light_map;
+    texture_barriers[2].new_state = blast::RESOURCE_STATE_SHADER_RESOURCE;
+    g_device->SetBarrier(cmd, 0, nullptr, 3, texture_barriers);
+}
+
 static void CursorPositionCallback(GLFWwindow* window, double pos_x, double pos_y) {
     if (!camera.grabbing) {
         return;
@@ -1291,4 +1944,18 @@ static void MouseButtonCallback(GLFWwindow* window, int button, int action, int
 
 static void MouseScrollCallback(GLFWwindow* window, double offset_x, double offset_y) {
     camera.position += camera.front * (float)offset_y * 0.1f;
+}
+
+static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    // Key Down, 数字键切换对应灯光分组的开关, 烘焙结束后才能重新合成
+    if (action != 1 || !bake_completed || key < GLFW_KEY_1 || key > GLFW_KEY_9) {
+        return;
+    }
+
+    uint32_t group = key - GLFW_KEY_1;
+    if (group < light_group_count) {
+        light_group_weights[group] = light_group_weights[group] == glm::vec3(0.0f) ? glm::vec3(1.0f) : glm::vec3(0.0f);
+        relight_pending = true;
+        printf("light group %d %s\n", group, light_group_weights[group] == glm::vec3(0.0f) ? "off" : "on");
+    }
 }
\ No newline at end of file